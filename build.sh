@@ -1,2 +1,3 @@
- gcc smartpole_privacy_protector.c -o smartpole_privacy_protector `pkg-config --cflags --libs gstreamer-video-1.0 gtk+-3.0 gstreamer-1.0`
-
+ g++ -O2 -c smartpole_detector.cpp -o smartpole_detector.o `pkg-config --cflags opencv4 gstreamer-video-1.0`
+ gcc -O2 smartpole_privacy_protector.c smartpole_camera.c smartpole_roi.c smartpole_kernels.c smartpole_tracker.c smartpole_motion.c smartpole_bands.c smartpole_tasks.c smartpole_pool.c smartpole_pyramid.c smartpole_plates.c smartpole_restream.c smartpole_stats.c smartpole_metrics.c smartpole_stamp.c smartpole_batch.c gstprivacyredact.c smartpole_detector.o -o smartpole_privacy_protector -lm -lstdc++ `pkg-config --cflags --libs gstreamer-rtsp-server-1.0 gstreamer-rtp-1.0 gstreamer-app-1.0 gio-unix-2.0 gstreamer-video-1.0 gtk+-3.0 gstreamer-1.0 opencv4`
+ gcc -O2 smartpole_bench.c smartpole_stamp.c smartpole_bands.c smartpole_tasks.c smartpole_pool.c smartpole_kernels.c smartpole_pyramid.c smartpole_plates.c smartpole_detector.o -o smartpole_bench -lm -lstdc++ `pkg-config --cflags --libs gstreamer-rtsp-server-1.0 gstreamer-app-1.0 gio-unix-2.0 gstreamer-video-1.0 gstreamer-1.0 opencv4`
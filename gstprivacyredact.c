@@ -0,0 +1,1023 @@
+/**
+ * SECTION:element-privacyredact
+ *
+ * Runs a face cascade once per frame, attaches a GstVideoRegionOfInterestMeta of type
+ * "face" for every hit and pixelates every face region of the frame in place. On planar
+ * YUV the cascade reads the luma plane directly and every plane is redacted at its own
+ * resolution, so no color conversion is needed around the element. redact-mode picks
+ * pixelation, a box blur or a solid mask instead. The integral-blur mode costs the same
+ * per pixel whatever its radius, which blur-scale ties to the size of each region. Regions
+ * attached upstream are redacted as well, so a detector earlier in the pipeline does not
+ * have to be run again. With detect-interval above 1 the cascade only runs on keyframes
+ * and every Nth frame, a block matching tracker moves the boxes in between. With
+ * motion-gate the cascade only scans the tiles whose luma changed since the previous
+ * detection pass and keeps the faces found elsewhere, a full pass runs every
+ * refresh-interval frames to pick up faces that stood still. size-bands limits the face
+ * sizes searched for in each horizontal band of the frame to the ones the perspective of
+ * the camera allows there. With parallel the detection of a frame is split into tiles and
+ * face size ranges that run on a thread pool shared by every privacyredact of the
+ * process. With detect-plates a number plate detector runs on every frame as well and
+ * attaches regions of type "license-plate", which blur-plates pixelates. Both detectors
+ * share the downscaled copies of the luma plane they ask for.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 videotestsrc ! video/x-raw,format=I420 ! privacyredact display=1 ! videoconvert ! ximagesink
+ * ]|
+ * </refsect2>
+ */
+
+#include <string.h>
+
+#include "gstprivacyredact.h"
+#include "smartpole_bands.h"
+#include "smartpole_kernels.h"
+#include "smartpole_plates.h"
+#include "smartpole_tasks.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_privacy_redact_debug);
+#define GST_CAT_DEFAULT gst_privacy_redact_debug
+
+#ifndef HAAR_CASCADES_DIR
+#define HAAR_CASCADES_DIR "/usr/share/opencv4/haarcascades"
+#endif
+
+#define DEFAULT_PROFILE HAAR_CASCADES_DIR "/haarcascade_frontalface_default.xml"
+#define DEFAULT_BLUR_FACES TRUE
+#define DEFAULT_DISPLAY FALSE
+#define DEFAULT_POST_MESSAGES FALSE
+#define DEFAULT_SCALE_FACTOR 1.25
+#define DEFAULT_MIN_NEIGHBORS 3
+#define DEFAULT_MIN_SIZE_WIDTH 30
+#define DEFAULT_MIN_SIZE_HEIGHT 30
+#define DEFAULT_BLOCK_SIZE 16
+#define DEFAULT_REDACT_MODE REDACT_PIXELATE
+#define DEFAULT_BLUR_RADIUS 12
+#define DEFAULT_BLUR_SCALE 0.0
+#define DEFAULT_DETECT_SCALE 1
+#define DEFAULT_ROI_PADDING 0.1
+#define DEFAULT_DETECT_INTERVAL 1
+#define DEFAULT_MOTION_GATE FALSE
+#define DEFAULT_MOTION_THRESHOLD 6
+#define DEFAULT_REFRESH_INTERVAL 50
+#define DEFAULT_PARALLEL FALSE
+#define DEFAULT_TILE_SIZE 512
+#define DEFAULT_DETECT_PLATES FALSE
+#define DEFAULT_BLUR_PLATES FALSE
+#define DEFAULT_PLATE_THRESHOLD 3.0
+#define DEFAULT_PLATE_SCALE 2
+#define DEFAULT_PLATE_MIN_HEIGHT 16
+
+#define OUTLINE_THICKNESS 2
+/* Fraction of a box covered by a larger one above which the two are merged */
+#define MERGE_OVERLAP 0.5
+
+enum
+{
+  PROP_0,
+  PROP_BLUR_FACES,
+  PROP_DISPLAY,
+  PROP_POST_MESSAGES,
+  PROP_PROFILE,
+  PROP_SCALE_FACTOR,
+  PROP_MIN_NEIGHBORS,
+  PROP_MIN_SIZE_WIDTH,
+  PROP_MIN_SIZE_HEIGHT,
+  PROP_BLOCK_SIZE,
+  PROP_REDACT_MODE,
+  PROP_BLUR_RADIUS,
+  PROP_BLUR_SCALE,
+  PROP_DETECT_SCALE,
+  PROP_ROI_PADDING,
+  PROP_DETECT_INTERVAL,
+  PROP_MOTION_GATE,
+  PROP_MOTION_THRESHOLD,
+  PROP_REFRESH_INTERVAL,
+  PROP_SIZE_BANDS,
+  PROP_PARALLEL,
+  PROP_TILE_SIZE,
+  PROP_DETECT_PLATES,
+  PROP_BLUR_PLATES,
+  PROP_PLATE_THRESHOLD,
+  PROP_PLATE_SCALE,
+  PROP_PLATE_MIN_HEIGHT
+};
+
+/* Planar YUV is detected on its luma plane and redacted plane by plane in place, RGB
+ * only costs a grayscale conversion */
+#define VIDEO_CAPS GST_VIDEO_CAPS_MAKE ("{ I420, YV12, NV12, NV21, RGB }")
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS));
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS));
+
+#define GST_TYPE_PRIVACY_REDACT_MODE (gst_privacy_redact_mode_get_type ())
+static GType
+gst_privacy_redact_mode_get_type (void)
+{
+  static gsize type = 0;
+  static const GEnumValue modes[] = {
+    {REDACT_PIXELATE, "Pixelate", "pixelate"},
+    {REDACT_BLUR, "Box blur", "blur"},
+    {REDACT_INTEGRAL_BLUR, "Box blur of any radius from a summed-area table",
+        "integral-blur"},
+    {REDACT_FILL, "Solid fill", "fill"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&type))
+    g_once_init_leave (&type, g_enum_register_static ("GstPrivacyRedactMode", modes));
+  return type;
+}
+
+#define gst_privacy_redact_parent_class parent_class
+G_DEFINE_TYPE (GstPrivacyRedact, gst_privacy_redact, GST_TYPE_VIDEO_FILTER);
+
+static void gst_privacy_redact_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_privacy_redact_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_privacy_redact_finalize (GObject * object);
+
+static gboolean gst_privacy_redact_start (GstBaseTransform * trans);
+static gboolean gst_privacy_redact_stop (GstBaseTransform * trans);
+static GstFlowReturn gst_privacy_redact_transform_frame_ip (GstVideoFilter * filter,
+    GstVideoFrame * frame);
+
+static void
+gst_privacy_redact_class_init (GstPrivacyRedactClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
+  GstVideoFilterClass *filter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  gobject_class->set_property = gst_privacy_redact_set_property;
+  gobject_class->get_property = gst_privacy_redact_get_property;
+  gobject_class->finalize = gst_privacy_redact_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_BLUR_FACES,
+      g_param_spec_boolean ("blur-faces", "Blur faces",
+          "Redact the face regions of every frame", DEFAULT_BLUR_FACES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_DISPLAY,
+      g_param_spec_boolean ("display", "Display",
+          "Outline the face regions of every frame", DEFAULT_DISPLAY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_POST_MESSAGES,
+      g_param_spec_boolean ("post-messages", "Post messages",
+          "Post a \"privacyredact\" element message with the faces of every frame",
+          DEFAULT_POST_MESSAGES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PROFILE,
+      g_param_spec_string ("profile", "Profile",
+          "Location of the face cascade classifier, read when the element starts",
+          DEFAULT_PROFILE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_SCALE_FACTOR,
+      g_param_spec_double ("scale-factor", "Scale factor",
+          "Factor by which the frame is scaled between two detection passes",
+          1.05, 10.0, DEFAULT_SCALE_FACTOR, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MIN_NEIGHBORS,
+      g_param_spec_int ("min-neighbors", "Minimum neighbors",
+          "Minimum number of overlapping hits needed to keep a face",
+          0, G_MAXINT, DEFAULT_MIN_NEIGHBORS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MIN_SIZE_WIDTH,
+      g_param_spec_int ("min-size-width", "Minimum face width",
+          "Smallest face width searched for, in pixels",
+          0, G_MAXINT, DEFAULT_MIN_SIZE_WIDTH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MIN_SIZE_HEIGHT,
+      g_param_spec_int ("min-size-height", "Minimum face height",
+          "Smallest face height searched for, in pixels",
+          0, G_MAXINT, DEFAULT_MIN_SIZE_HEIGHT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_BLOCK_SIZE,
+      g_param_spec_uint ("block-size", "Block size",
+          "Size of the pixelation blocks, in luma pixels",
+          2, 256, DEFAULT_BLOCK_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_REDACT_MODE,
+      g_param_spec_enum ("redact-mode", "Redaction mode",
+          "How the face and plate regions are made unrecognizable",
+          GST_TYPE_PRIVACY_REDACT_MODE, DEFAULT_REDACT_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_BLUR_RADIUS,
+      g_param_spec_uint ("blur-radius", "Blur radius",
+          "Radius of the box blur of the blur modes, in luma pixels. The blur mode "
+          "stops at " G_STRINGIFY (KERNEL_MAX_BLUR_RADIUS) ", integral-blur does not", 1,
+          4096, DEFAULT_BLUR_RADIUS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_BLUR_SCALE,
+      g_param_spec_double ("blur-scale", "Blur scale",
+          "Smallest blur radius of a region as a fraction of its smaller side, in the "
+          "blur modes", 0.0, 1.0, DEFAULT_BLUR_SCALE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_DETECT_SCALE,
+      g_param_spec_uint ("detect-scale", "Detection scale",
+          "Detect on a copy of the luma plane downscaled by this factor, 1 for full size",
+          1, 8, DEFAULT_DETECT_SCALE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_ROI_PADDING,
+      g_param_spec_double ("roi-padding", "ROI padding",
+          "Fraction of a box added on every side when mapping a downscaled detection "
+          "back to the full frame", 0.0, 1.0, DEFAULT_ROI_PADDING,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_DETECT_INTERVAL,
+      g_param_spec_uint ("detect-interval", "Detection interval",
+          "Run the detector on keyframes and every Nth frame, and track the faces on "
+          "the frames in between", 1, 300, DEFAULT_DETECT_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MOTION_GATE,
+      g_param_spec_boolean ("motion-gate", "Motion gate",
+          "Only detect in the parts of the frame that changed since the previous "
+          "detection pass", DEFAULT_MOTION_GATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_MOTION_THRESHOLD,
+      g_param_spec_uint ("motion-threshold", "Motion threshold",
+          "Mean absolute luma difference above which a tile counts as changed",
+          1, 255, DEFAULT_MOTION_THRESHOLD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_REFRESH_INTERVAL,
+      g_param_spec_uint ("refresh-interval", "Refresh interval",
+          "Frames between two detection passes over the whole frame in motion-gate "
+          "mode, 0 to never force one", 0, G_MAXUINT, DEFAULT_REFRESH_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_SIZE_BANDS,
+      g_param_spec_string ("size-bands", "Size bands",
+          "Face heights searched for per horizontal band of the frame, as "
+          "TOP:MIN:MAX,... with TOP a fraction of the frame height and MAX 0 for no "
+          "limit. Overrides the min-size properties, NULL to search every size "
+          "everywhere", NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PARALLEL,
+      g_param_spec_boolean ("parallel", "Parallel",
+          "Split detection into tiles and face size ranges run on the detection "
+          "thread pool shared by every element of the process, read when the element "
+          "starts", DEFAULT_PARALLEL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_TILE_SIZE,
+      g_param_spec_uint ("tile-size", "Tile size",
+          "Smallest side of a tile in parallel mode, in pixels", 64, 8192,
+          DEFAULT_TILE_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_DETECT_PLATES,
+      g_param_spec_boolean ("detect-plates", "Detect plates",
+          "Detect the number plates of every frame and attach them as regions of type "
+          "\"license-plate\"", DEFAULT_DETECT_PLATES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_BLUR_PLATES,
+      g_param_spec_boolean ("blur-plates", "Blur plates",
+          "Redact the number plate regions of every frame, detecting them when "
+          "detect-plates is not set", DEFAULT_BLUR_PLATES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PLATE_THRESHOLD,
+      g_param_spec_double ("plate-threshold", "Plate threshold",
+          "Score from 0 to 5 a candidate needs to count as a number plate, lower finds "
+          "more plates and more false ones", 0.0, 5.0, DEFAULT_PLATE_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PLATE_SCALE,
+      g_param_spec_uint ("plate-scale", "Plate scale",
+          "Detect plates on a copy of the luma plane downscaled by this factor",
+          1, PYRAMID_MAX_SCALE, DEFAULT_PLATE_SCALE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PLATE_MIN_HEIGHT,
+      g_param_spec_int ("plate-min-height", "Minimum plate height",
+          "Smallest number plate height searched for, in pixels", 4, G_MAXINT,
+          DEFAULT_PLATE_MIN_HEIGHT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_set_static_metadata (element_class,
+      "privacyredact", "Filter/Effect/Video",
+      "Detects faces and number plates once and redacts them in place",
+      "smartpole privacy protector");
+
+  gst_element_class_add_static_pad_template (element_class, &src_factory);
+  gst_element_class_add_static_pad_template (element_class, &sink_factory);
+
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_privacy_redact_start);
+  trans_class->stop = GST_DEBUG_FUNCPTR (gst_privacy_redact_stop);
+  filter_class->transform_frame_ip =
+      GST_DEBUG_FUNCPTR (gst_privacy_redact_transform_frame_ip);
+
+  GST_DEBUG_CATEGORY_INIT (gst_privacy_redact_debug, "privacyredact", 0,
+      "Face detection and redaction");
+}
+
+static void
+gst_privacy_redact_init (GstPrivacyRedact * filter)
+{
+  filter->blur_faces = DEFAULT_BLUR_FACES;
+  filter->display = DEFAULT_DISPLAY;
+  filter->post_messages = DEFAULT_POST_MESSAGES;
+  filter->profile = g_strdup (DEFAULT_PROFILE);
+  filter->params.scale_factor = DEFAULT_SCALE_FACTOR;
+  filter->params.min_neighbors = DEFAULT_MIN_NEIGHBORS;
+  filter->params.min_width = DEFAULT_MIN_SIZE_WIDTH;
+  filter->params.min_height = DEFAULT_MIN_SIZE_HEIGHT;
+  filter->params.max_width = 0;
+  filter->params.max_height = 0;
+  filter->block_size = DEFAULT_BLOCK_SIZE;
+  filter->redact_mode = DEFAULT_REDACT_MODE;
+  filter->blur_radius = DEFAULT_BLUR_RADIUS;
+  filter->blur_scale = DEFAULT_BLUR_SCALE;
+  filter->detect_scale = DEFAULT_DETECT_SCALE;
+  filter->roi_padding = DEFAULT_ROI_PADDING;
+  filter->detect_interval = DEFAULT_DETECT_INTERVAL;
+  filter->motion_gate = DEFAULT_MOTION_GATE;
+  filter->motion_threshold = DEFAULT_MOTION_THRESHOLD;
+  filter->refresh_interval = DEFAULT_REFRESH_INTERVAL;
+  filter->parallel = DEFAULT_PARALLEL;
+  filter->tile_size = DEFAULT_TILE_SIZE;
+  filter->detect_plates = DEFAULT_DETECT_PLATES;
+  filter->blur_plates = DEFAULT_BLUR_PLATES;
+  filter->plate_threshold = DEFAULT_PLATE_THRESHOLD;
+  filter->plate_scale = DEFAULT_PLATE_SCALE;
+  filter->plate_min_height = DEFAULT_PLATE_MIN_HEIGHT;
+  filter->tasks = g_array_new (FALSE, FALSE, sizeof (DetectTask));
+  filter->results = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+  filter->rects = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  filter->found = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  filter->detected = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  filter->regions = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  filter->plates = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+}
+
+static void
+gst_privacy_redact_finalize (GObject * object)
+{
+  GstPrivacyRedact *filter = GST_PRIVACY_REDACT (object);
+
+  g_free (filter->profile);
+  g_free (filter->size_bands);
+  g_clear_pointer (&filter->bands, g_array_unref);
+  g_array_free (filter->tasks, TRUE);
+  g_ptr_array_unref (filter->results);
+  g_array_free (filter->rects, TRUE);
+  g_array_free (filter->found, TRUE);
+  g_array_free (filter->detected, TRUE);
+  g_array_free (filter->regions, TRUE);
+  g_array_free (filter->plates, TRUE);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_privacy_redact_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstPrivacyRedact *filter = GST_PRIVACY_REDACT (object);
+
+  GST_OBJECT_LOCK (filter);
+  switch (prop_id) {
+    case PROP_BLUR_FACES:
+      filter->blur_faces = g_value_get_boolean (value);
+      break;
+    case PROP_DISPLAY:
+      filter->display = g_value_get_boolean (value);
+      break;
+    case PROP_POST_MESSAGES:
+      filter->post_messages = g_value_get_boolean (value);
+      break;
+    case PROP_PROFILE:
+      g_free (filter->profile);
+      filter->profile = g_value_dup_string (value);
+      break;
+    case PROP_SCALE_FACTOR:
+      filter->params.scale_factor = g_value_get_double (value);
+      break;
+    case PROP_MIN_NEIGHBORS:
+      filter->params.min_neighbors = g_value_get_int (value);
+      break;
+    case PROP_MIN_SIZE_WIDTH:
+      filter->params.min_width = g_value_get_int (value);
+      break;
+    case PROP_MIN_SIZE_HEIGHT:
+      filter->params.min_height = g_value_get_int (value);
+      break;
+    case PROP_BLOCK_SIZE:
+      filter->block_size = g_value_get_uint (value);
+      break;
+    case PROP_REDACT_MODE:
+      filter->redact_mode = g_value_get_enum (value);
+      break;
+    case PROP_BLUR_RADIUS:
+      filter->blur_radius = g_value_get_uint (value);
+      break;
+    case PROP_BLUR_SCALE:
+      filter->blur_scale = g_value_get_double (value);
+      break;
+    case PROP_DETECT_SCALE:
+      filter->detect_scale = g_value_get_uint (value);
+      break;
+    case PROP_ROI_PADDING:
+      filter->roi_padding = g_value_get_double (value);
+      break;
+    case PROP_DETECT_INTERVAL:
+      filter->detect_interval = g_value_get_uint (value);
+      break;
+    case PROP_MOTION_GATE:
+      filter->motion_gate = g_value_get_boolean (value);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      filter->motion_threshold = g_value_get_uint (value);
+      break;
+    case PROP_REFRESH_INTERVAL:
+      filter->refresh_interval = g_value_get_uint (value);
+      break;
+    case PROP_SIZE_BANDS:{
+      const gchar *spec = g_value_get_string (value);
+      GArray *bands = NULL;
+      GError *error = NULL;
+
+      if (spec && *spec && !(bands = size_bands_parse (spec, &error))) {
+        GST_WARNING_OBJECT (filter, "ignoring size-bands: %s", error->message);
+        g_clear_error (&error);
+        break;
+      }
+      g_free (filter->size_bands);
+      filter->size_bands = bands ? g_strdup (spec) : NULL;
+      g_clear_pointer (&filter->bands, g_array_unref);
+      filter->bands = bands;
+      break;
+    }
+    case PROP_PARALLEL:
+      filter->parallel = g_value_get_boolean (value);
+      break;
+    case PROP_TILE_SIZE:
+      filter->tile_size = g_value_get_uint (value);
+      break;
+    case PROP_DETECT_PLATES:
+      filter->detect_plates = g_value_get_boolean (value);
+      break;
+    case PROP_BLUR_PLATES:
+      filter->blur_plates = g_value_get_boolean (value);
+      break;
+    case PROP_PLATE_THRESHOLD:
+      filter->plate_threshold = g_value_get_double (value);
+      break;
+    case PROP_PLATE_SCALE:
+      filter->plate_scale = g_value_get_uint (value);
+      break;
+    case PROP_PLATE_MIN_HEIGHT:
+      filter->plate_min_height = g_value_get_int (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (filter);
+}
+
+static void
+gst_privacy_redact_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstPrivacyRedact *filter = GST_PRIVACY_REDACT (object);
+
+  GST_OBJECT_LOCK (filter);
+  switch (prop_id) {
+    case PROP_BLUR_FACES:
+      g_value_set_boolean (value, filter->blur_faces);
+      break;
+    case PROP_DISPLAY:
+      g_value_set_boolean (value, filter->display);
+      break;
+    case PROP_POST_MESSAGES:
+      g_value_set_boolean (value, filter->post_messages);
+      break;
+    case PROP_PROFILE:
+      g_value_set_string (value, filter->profile);
+      break;
+    case PROP_SCALE_FACTOR:
+      g_value_set_double (value, filter->params.scale_factor);
+      break;
+    case PROP_MIN_NEIGHBORS:
+      g_value_set_int (value, filter->params.min_neighbors);
+      break;
+    case PROP_MIN_SIZE_WIDTH:
+      g_value_set_int (value, filter->params.min_width);
+      break;
+    case PROP_MIN_SIZE_HEIGHT:
+      g_value_set_int (value, filter->params.min_height);
+      break;
+    case PROP_BLOCK_SIZE:
+      g_value_set_uint (value, filter->block_size);
+      break;
+    case PROP_REDACT_MODE:
+      g_value_set_enum (value, filter->redact_mode);
+      break;
+    case PROP_BLUR_RADIUS:
+      g_value_set_uint (value, filter->blur_radius);
+      break;
+    case PROP_BLUR_SCALE:
+      g_value_set_double (value, filter->blur_scale);
+      break;
+    case PROP_DETECT_SCALE:
+      g_value_set_uint (value, filter->detect_scale);
+      break;
+    case PROP_ROI_PADDING:
+      g_value_set_double (value, filter->roi_padding);
+      break;
+    case PROP_DETECT_INTERVAL:
+      g_value_set_uint (value, filter->detect_interval);
+      break;
+    case PROP_MOTION_GATE:
+      g_value_set_boolean (value, filter->motion_gate);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      g_value_set_uint (value, filter->motion_threshold);
+      break;
+    case PROP_REFRESH_INTERVAL:
+      g_value_set_uint (value, filter->refresh_interval);
+      break;
+    case PROP_SIZE_BANDS:
+      g_value_set_string (value, filter->size_bands);
+      break;
+    case PROP_PARALLEL:
+      g_value_set_boolean (value, filter->parallel);
+      break;
+    case PROP_TILE_SIZE:
+      g_value_set_uint (value, filter->tile_size);
+      break;
+    case PROP_DETECT_PLATES:
+      g_value_set_boolean (value, filter->detect_plates);
+      break;
+    case PROP_BLUR_PLATES:
+      g_value_set_boolean (value, filter->blur_plates);
+      break;
+    case PROP_PLATE_THRESHOLD:
+      g_value_set_double (value, filter->plate_threshold);
+      break;
+    case PROP_PLATE_SCALE:
+      g_value_set_uint (value, filter->plate_scale);
+      break;
+    case PROP_PLATE_MIN_HEIGHT:
+      g_value_set_int (value, filter->plate_min_height);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (filter);
+}
+
+/* A cascade cannot run on two threads at once, so every worker of the shared pool needs
+ * its own copy. A worker runs one task at a time whichever element queued it, so the
+ * copies of a profile are shared by every privacyredact using that profile and only
+ * freed when the last of them stops. */
+struct _WorkerDetectors
+{
+  gchar *profile;
+  guint ref_count;
+  Detector **detectors;     /* One per worker of the shared pool */
+  guint n_detectors;
+};
+
+static GMutex worker_detectors_lock;
+static GHashTable *worker_detectors = NULL;    /* profile -> WorkerDetectors */
+
+static void
+worker_detectors_free (WorkerDetectors * workers)
+{
+  guint i;
+
+  for (i = 0; i < workers->n_detectors; i++)
+    g_clear_pointer (&workers->detectors[i], detector_free);
+  g_free (workers->detectors);
+  g_free (workers->profile);
+  g_free (workers);
+}
+
+static WorkerDetectors *
+worker_detectors_acquire (const gchar * profile, WorkPool * pool, GError ** error)
+{
+  WorkerDetectors *workers;
+  guint i;
+
+  g_mutex_lock (&worker_detectors_lock);
+  if (!worker_detectors)
+    worker_detectors = g_hash_table_new (g_str_hash, g_str_equal);
+  workers = g_hash_table_lookup (worker_detectors, profile);
+  if (workers) {
+    workers->ref_count++;
+    g_mutex_unlock (&worker_detectors_lock);
+    return workers;
+  }
+
+  workers = g_new0 (WorkerDetectors, 1);
+  workers->profile = g_strdup (profile);
+  workers->ref_count = 1;
+  workers->n_detectors = work_pool_get_n_workers (pool);
+  workers->detectors = g_new0 (Detector *, workers->n_detectors);
+  for (i = 0; i < workers->n_detectors; i++) {
+    workers->detectors[i] = detector_new (profile, error);
+    if (!workers->detectors[i]) {
+      g_mutex_unlock (&worker_detectors_lock);
+      worker_detectors_free (workers);
+      return NULL;
+    }
+  }
+  g_hash_table_insert (worker_detectors, workers->profile, workers);
+  g_mutex_unlock (&worker_detectors_lock);
+
+  return workers;
+}
+
+static void
+worker_detectors_release (WorkerDetectors * workers)
+{
+  g_mutex_lock (&worker_detectors_lock);
+  if (--workers->ref_count == 0)
+    g_hash_table_remove (worker_detectors, workers->profile);
+  else
+    workers = NULL;
+  g_mutex_unlock (&worker_detectors_lock);
+
+  if (workers)
+    worker_detectors_free (workers);
+}
+
+static void
+gst_privacy_redact_free_detectors (GstPrivacyRedact * filter)
+{
+  g_clear_pointer (&filter->detector, detector_free);
+  g_clear_pointer (&filter->workers, worker_detectors_release);
+  filter->pool = NULL;
+}
+
+static gboolean
+gst_privacy_redact_start (GstBaseTransform * trans)
+{
+  GstPrivacyRedact *filter = GST_PRIVACY_REDACT (trans);
+  GError *error = NULL;
+  gchar *profile;
+  gboolean parallel;
+
+  GST_OBJECT_LOCK (filter);
+  profile = g_strdup (filter->profile);
+  parallel = filter->parallel;
+  GST_OBJECT_UNLOCK (filter);
+
+  filter->detector = detector_new (profile, &error);
+  if (filter->detector && parallel) {
+    filter->pool = work_pool_get_shared ();
+    filter->workers = worker_detectors_acquire (profile, filter->pool, &error);
+  }
+  g_free (profile);
+  if (error) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, NOT_FOUND, ("%s", error->message), (NULL));
+    g_clear_error (&error);
+    gst_privacy_redact_free_detectors (filter);
+    return FALSE;
+  }
+  filter->tracker = tracker_new ();
+  filter->motion = motion_mask_new ();
+  filter->pyramid = luma_pyramid_new ();
+  filter->plate_detector = plate_detector_new ();
+  filter->frames_since_detect = 0;
+  filter->frames_since_refresh = 0;
+  g_array_set_size (filter->detected, 0);
+  filter->seen_delta_units = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_privacy_redact_stop (GstBaseTransform * trans)
+{
+  GstPrivacyRedact *filter = GST_PRIVACY_REDACT (trans);
+
+  gst_privacy_redact_free_detectors (filter);
+  g_clear_pointer (&filter->tracker, tracker_free);
+  g_clear_pointer (&filter->motion, motion_mask_free);
+  g_clear_pointer (&filter->pyramid, luma_pyramid_free);
+  g_clear_pointer (&filter->plate_detector, plate_detector_free);
+  g_clear_pointer (&filter->gray, g_free);
+  filter->gray_size = 0;
+
+  return TRUE;
+}
+
+/* Get the grayscale image the cascade works on. For YUV this is the luma plane itself,
+ * RGB is converted to a scratch buffer. */
+static const guint8 *
+gst_privacy_redact_get_gray (GstPrivacyRedact * filter, GstVideoFrame * frame,
+    gint * gray_stride)
+{
+  const guint8 *rgb = GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
+  gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  gint width = GST_VIDEO_FRAME_WIDTH (frame);
+  gint height = GST_VIDEO_FRAME_HEIGHT (frame);
+  gint x, y;
+
+  if (GST_VIDEO_FRAME_IS_YUV (frame)) {
+    *gray_stride = GST_VIDEO_FRAME_COMP_STRIDE (frame, 0);
+    return GST_VIDEO_FRAME_COMP_DATA (frame, 0);
+  }
+
+  if (filter->gray_size < (gsize) width * height) {
+    g_free (filter->gray);
+    filter->gray_size = (gsize) width * height;
+    filter->gray = g_malloc (filter->gray_size);
+  }
+
+  for (y = 0; y < height; y++) {
+    const guint8 *src = rgb + y * stride;
+    guint8 *dst = filter->gray + y * width;
+
+    /* BT.601 luma in 8 bit fixed point */
+    for (x = 0; x < width; x++, src += 3)
+      dst[x] = (77 * src[0] + 150 * src[1] + 29 * src[2]) >> 8;
+  }
+
+  *gray_stride = width;
+  return filter->gray;
+}
+
+/* Fill @list with one structure named @name per rectangle */
+static void
+gst_privacy_redact_rect_list (GValue * list, const gchar * name, GArray * rects)
+{
+  guint i;
+
+  g_value_init (list, GST_TYPE_LIST);
+  for (i = 0; i < rects->len; i++) {
+    GstVideoRectangle *rect = &g_array_index (rects, GstVideoRectangle, i);
+    GValue item = G_VALUE_INIT;
+
+    g_value_init (&item, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&item, gst_structure_new (name,
+            "x", G_TYPE_UINT, rect->x, "y", G_TYPE_UINT, rect->y,
+            "width", G_TYPE_UINT, rect->w, "height", G_TYPE_UINT, rect->h, NULL));
+    gst_value_list_append_and_take_value (list, &item);
+  }
+}
+
+static void
+gst_privacy_redact_post_message (GstPrivacyRedact * filter, GstBuffer * buf,
+    GArray * rects, GArray * plates)
+{
+  GstStructure *s;
+  GValue faces = G_VALUE_INIT;
+  GValue plate_list = G_VALUE_INIT;
+
+  s = gst_structure_new ("privacyredact",
+      "timestamp", G_TYPE_UINT64, GST_BUFFER_PTS (buf),
+      "duration", G_TYPE_UINT64, GST_BUFFER_DURATION (buf), NULL);
+  gst_privacy_redact_rect_list (&faces, "face", rects);
+  gst_structure_take_value (s, "faces", &faces);
+  if (plates) {
+    gst_privacy_redact_rect_list (&plate_list, "plate", plates);
+    gst_structure_take_value (s, "plates", &plate_list);
+  }
+  gst_element_post_message (GST_ELEMENT (filter),
+      gst_message_new_element (GST_OBJECT (filter), s));
+}
+
+typedef struct
+{
+  GstPrivacyRedact *filter;
+  const LumaPlane *plane;
+  gdouble padding;
+} DetectJob;
+
+static void
+gst_privacy_redact_run_task (gpointer task, guint worker, gpointer user_data)
+{
+  DetectJob *job = user_data;
+
+  detect_task_run (task, job->filter->workers->detectors[worker], job->plane, job->padding,
+      ((DetectTask *) task)->found);
+}
+
+/* Run the queued detection tasks and append the faces they find to @rects. In parallel
+ * mode the tasks are split further and spread over the shared pool while the streaming
+ * thread waits, the duplicates of overlapping tiles are merged afterwards. */
+static void
+gst_privacy_redact_run_tasks (GstPrivacyRedact * filter, const LumaPlane * plane,
+    gdouble padding, guint tile_size, GArray * rects)
+{
+  DetectJob job = { filter, plane, padding };
+  guint first = rects->len, t;
+
+  if (!filter->pool) {
+    detect_tasks_run (filter->tasks, filter->detector, plane, padding, filter->found, rects);
+    g_array_set_size (filter->tasks, 0);
+    return;
+  }
+
+  detect_tasks_split (filter->tasks, tile_size);
+  while (filter->results->len < filter->tasks->len)
+    g_ptr_array_add (filter->results, g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle)));
+  for (t = 0; t < filter->tasks->len; t++)
+    g_array_index (filter->tasks, DetectTask, t).found = g_ptr_array_index (filter->results, t);
+
+  work_pool_run (filter->pool, gst_privacy_redact_run_task, filter->tasks->data,
+      sizeof (DetectTask), filter->tasks->len, &job);
+
+  for (t = 0; t < filter->tasks->len; t++) {
+    GArray *found = g_array_index (filter->tasks, DetectTask, t).found;
+
+    g_array_append_vals (rects, found->data, found->len);
+  }
+  GST_LOG_OBJECT (filter, "ran %u detection tasks", filter->tasks->len);
+  g_array_set_size (filter->tasks, 0);
+
+  /* Only the faces found by this run can be duplicates of each other */
+  if (rects->len - first > 1) {
+    g_array_set_size (filter->found, 0);
+    g_array_append_vals (filter->found, &g_array_index (rects, GstVideoRectangle, first),
+        rects->len - first);
+    detect_merge_overlaps (filter->found, MERGE_OVERLAP);
+    g_array_set_size (rects, first);
+    g_array_append_vals (rects, filter->found->data, filter->found->len);
+  }
+}
+
+/* Detect only in the regions of the frame that changed since the previous detection
+ * pass. The faces of that pass lying outside every changed region did not move and are
+ * kept as they are. */
+static void
+gst_privacy_redact_detect_gated (GstPrivacyRedact * filter, const guint8 * gray,
+    gint width, gint height, gint stride, const LumaPlane * plane, gdouble padding,
+    const DetectorParams * params, GArray * bands, guint threshold, guint tile_size,
+    GArray * rects)
+{
+  guint i, j, n_regions;
+
+  n_regions = motion_mask_update (filter->motion, gray, width, height, stride, threshold,
+      filter->regions);
+
+  g_array_set_size (rects, 0);
+  for (i = 0; i < filter->detected->len; i++) {
+    GstVideoRectangle *face = &g_array_index (filter->detected, GstVideoRectangle, i);
+    gboolean moved = FALSE;
+
+    for (j = 0; j < n_regions && !moved; j++) {
+      GstVideoRectangle *region = &g_array_index (filter->regions, GstVideoRectangle, j);
+
+      moved = face->x < region->x + region->w && region->x < face->x + face->w &&
+          face->y < region->y + region->h && region->y < face->y + face->h;
+    }
+    if (!moved)
+      g_array_append_val (rects, *face);
+  }
+
+  for (j = 0; j < n_regions; j++)
+    detect_tasks_add (filter->tasks, bands, height,
+        &g_array_index (filter->regions, GstVideoRectangle, j), params);
+  gst_privacy_redact_run_tasks (filter, plane, padding, tile_size, rects);
+  GST_LOG_OBJECT (filter, "detected in %u changed regions", n_regions);
+}
+
+/* Collect the regions of type @roi_type attached to @buf */
+static void
+gst_privacy_redact_collect_rois (GstBuffer * buf, GQuark roi_type, GArray * rects)
+{
+  GstVideoRegionOfInterestMeta *meta;
+  gpointer state = NULL;
+
+  g_array_set_size (rects, 0);
+  while ((meta = (GstVideoRegionOfInterestMeta *) gst_buffer_iterate_meta_filtered (buf,
+              &state, GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    GstVideoRectangle rect = { meta->x, meta->y, meta->w, meta->h };
+
+    if (meta->roi_type == roi_type)
+      g_array_append_val (rects, rect);
+  }
+}
+
+static GstFlowReturn
+gst_privacy_redact_transform_frame_ip (GstVideoFilter * vfilter, GstVideoFrame * frame)
+{
+  GstPrivacyRedact *filter = GST_PRIVACY_REDACT (vfilter);
+  GQuark face_quark = g_quark_from_static_string ("face");
+  GQuark plate_quark = g_quark_from_static_string ("license-plate");
+  DetectorParams params;
+  gboolean blur_faces, display, post_messages, motion_gate, detect_plates, blur_plates;
+  guint block_size, detect_scale, detect_interval, motion_threshold, refresh_interval;
+  guint tile_size, plate_scale, strength, i;
+  RedactMode redact_mode;
+  gint plate_min_height;
+  gboolean keyframe;
+  gdouble roi_padding, plate_threshold, blur_scale;
+  const guint8 *gray;
+  const LumaPlane *plane;
+  gint gray_stride;
+  GArray *bands;
+
+  GST_OBJECT_LOCK (filter);
+  params = filter->params;
+  blur_faces = filter->blur_faces;
+  display = filter->display;
+  post_messages = filter->post_messages;
+  block_size = filter->block_size;
+  redact_mode = filter->redact_mode;
+  strength = redact_mode == REDACT_PIXELATE ? block_size : filter->blur_radius;
+  blur_scale = filter->blur_scale;
+  detect_scale = filter->detect_scale;
+  roi_padding = filter->roi_padding;
+  detect_interval = filter->detect_interval;
+  motion_gate = filter->motion_gate;
+  motion_threshold = filter->motion_threshold;
+  refresh_interval = filter->refresh_interval;
+  bands = filter->bands ? g_array_ref (filter->bands) : NULL;
+  tile_size = filter->tile_size;
+  blur_plates = filter->blur_plates;
+  detect_plates = filter->detect_plates || blur_plates;
+  plate_threshold = filter->plate_threshold;
+  plate_scale = filter->plate_scale;
+  plate_min_height = filter->plate_min_height;
+  GST_OBJECT_UNLOCK (filter);
+
+  /* The one detection pass of the frame, recorded as metas so that everything
+   * downstream, including the redaction below, works from the same result */
+  gray = gst_privacy_redact_get_gray (filter, frame, &gray_stride);
+  luma_pyramid_set_frame (filter->pyramid, gray, GST_VIDEO_FRAME_WIDTH (frame),
+      GST_VIDEO_FRAME_HEIGHT (frame), gray_stride);
+
+  /* Raw sources flag no frame as a delta unit, only decoded streams have keyframes */
+  if (GST_BUFFER_FLAG_IS_SET (frame->buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    filter->seen_delta_units = TRUE;
+  keyframe = filter->seen_delta_units &&
+      !GST_BUFFER_FLAG_IS_SET (frame->buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  /* Between two detection passes the boxes are carried forward by the tracker, which
+   * falls back to a detection when it has nothing to track from */
+  if (detect_interval > 1 && !keyframe && filter->frames_since_detect + 1 < detect_interval &&
+      tracker_update (filter->tracker, gray, GST_VIDEO_FRAME_WIDTH (frame),
+          GST_VIDEO_FRAME_HEIGHT (frame), gray_stride, filter->rects)) {
+    filter->frames_since_detect++;
+  } else {
+    plane = luma_pyramid_get (filter->pyramid, detect_scale);
+    if (motion_gate && (refresh_interval == 0 || filter->frames_since_refresh < refresh_interval)) {
+      gst_privacy_redact_detect_gated (filter, gray, GST_VIDEO_FRAME_WIDTH (frame),
+          GST_VIDEO_FRAME_HEIGHT (frame), gray_stride, plane, roi_padding, &params,
+          bands, motion_threshold, tile_size, filter->rects);
+    } else {
+      GstVideoRectangle whole = { 0, 0, GST_VIDEO_FRAME_WIDTH (frame),
+          GST_VIDEO_FRAME_HEIGHT (frame) };
+
+      g_array_set_size (filter->rects, 0);
+      detect_tasks_add (filter->tasks, bands, whole.h, &whole, &params);
+      gst_privacy_redact_run_tasks (filter, plane, roi_padding, tile_size, filter->rects);
+      /* Keep the reference of the motion mask current for the next gated pass */
+      if (motion_gate)
+        motion_mask_update (filter->motion, gray, GST_VIDEO_FRAME_WIDTH (frame),
+            GST_VIDEO_FRAME_HEIGHT (frame), gray_stride, motion_threshold, filter->regions);
+      filter->frames_since_refresh = 0;
+    }
+    g_array_set_size (filter->detected, 0);
+    g_array_append_vals (filter->detected, filter->rects->data, filter->rects->len);
+    if (detect_interval > 1)
+      tracker_reset (filter->tracker, gray, GST_VIDEO_FRAME_WIDTH (frame),
+          GST_VIDEO_FRAME_HEIGHT (frame), gray_stride, filter->rects);
+    filter->frames_since_detect = 0;
+  }
+  filter->frames_since_refresh++;
+  if (bands)
+    g_array_unref (bands);
+  for (i = 0; i < filter->rects->len; i++) {
+    GstVideoRectangle *rect = &g_array_index (filter->rects, GstVideoRectangle, i);
+
+    gst_buffer_add_video_region_of_interest_meta (frame->buffer, "face",
+        rect->x, rect->y, rect->w, rect->h);
+  }
+  GST_LOG_OBJECT (filter, "%u faces", filter->rects->len);
+
+  /* Plates are cheap to find and cars move fast, they are detected on every frame */
+  if (detect_plates) {
+    plate_detector_detect (filter->plate_detector,
+        luma_pyramid_get (filter->pyramid, plate_scale), plate_min_height, plate_threshold,
+        filter->plates);
+    for (i = 0; i < filter->plates->len; i++) {
+      GstVideoRectangle *rect = &g_array_index (filter->plates, GstVideoRectangle, i);
+
+      gst_buffer_add_video_region_of_interest_meta (frame->buffer, "license-plate",
+          rect->x, rect->y, rect->w, rect->h);
+    }
+    GST_LOG_OBJECT (filter, "%u plates", filter->plates->len);
+  }
+
+  if (post_messages)
+    gst_privacy_redact_post_message (filter, frame->buffer, filter->rects,
+        detect_plates ? filter->plates : NULL);
+
+  /* Toggling the rendering never adds another detection pass */
+  if (blur_faces || display) {
+    gst_privacy_redact_collect_rois (frame->buffer, face_quark, filter->rects);
+    if (blur_faces)
+      roi_redact_frame (frame, (GstVideoRectangle *) filter->rects->data,
+          filter->rects->len, redact_mode, strength, blur_scale);
+    if (display)
+      roi_outline_frame (frame, (GstVideoRectangle *) filter->rects->data,
+          filter->rects->len, OUTLINE_THICKNESS);
+  }
+  if (blur_plates || (display && detect_plates)) {
+    gst_privacy_redact_collect_rois (frame->buffer, plate_quark, filter->plates);
+    if (blur_plates)
+      roi_redact_frame (frame, (GstVideoRectangle *) filter->plates->data,
+          filter->plates->len, redact_mode, strength, blur_scale);
+    if (display)
+      roi_outline_frame (frame, (GstVideoRectangle *) filter->plates->data,
+          filter->plates->len, OUTLINE_THICKNESS);
+  }
+
+  return GST_FLOW_OK;
+}
@@ -0,0 +1,95 @@
+#ifndef __GST_PRIVACY_REDACT_H__
+#define __GST_PRIVACY_REDACT_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "smartpole_detector.h"
+#include "smartpole_motion.h"
+#include "smartpole_plates.h"
+#include "smartpole_pool.h"
+#include "smartpole_pyramid.h"
+#include "smartpole_roi.h"
+#include "smartpole_tracker.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PRIVACY_REDACT \
+  (gst_privacy_redact_get_type())
+#define GST_PRIVACY_REDACT(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PRIVACY_REDACT,GstPrivacyRedact))
+#define GST_PRIVACY_REDACT_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_PRIVACY_REDACT,GstPrivacyRedactClass))
+#define GST_IS_PRIVACY_REDACT(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PRIVACY_REDACT))
+
+typedef struct _GstPrivacyRedact GstPrivacyRedact;
+typedef struct _GstPrivacyRedactClass GstPrivacyRedactClass;
+typedef struct _WorkerDetectors WorkerDetectors;
+
+/* Detects faces and number plates once per frame, attaches a
+ * GstVideoRegionOfInterestMeta per hit and redacts every region of the frame in place
+ * from those metas */
+struct _GstPrivacyRedact
+{
+  GstVideoFilter parent;
+
+  /* Properties, protected by the object lock */
+  gboolean blur_faces;
+  gboolean display;
+  gboolean post_messages;
+  gchar *profile;
+  DetectorParams params;
+  guint block_size;
+  RedactMode redact_mode;
+  guint blur_radius;
+  gdouble blur_scale;
+  guint detect_scale;
+  gdouble roi_padding;
+  guint detect_interval;
+  gboolean motion_gate;
+  guint motion_threshold;
+  guint refresh_interval;
+  gchar *size_bands;
+  GArray *bands;            /* Parsed size_bands, SizeBand array or NULL */
+  gboolean parallel;
+  guint tile_size;
+  gboolean detect_plates;
+  gboolean blur_plates;
+  gdouble plate_threshold;
+  guint plate_scale;
+  gint plate_min_height;
+
+  /* Streaming thread only */
+  Detector *detector;
+  WorkPool *pool;           /* Shared pool of the parallel mode, NULL otherwise */
+  WorkerDetectors *workers; /* Detectors of @pool, shared with the other elements */
+  GArray *tasks;            /* DetectTask queued for the current frame */
+  GPtrArray *results;       /* Result array of each task of a parallel run */
+  Tracker *tracker;
+  MotionMask *motion;
+  LumaPyramid *pyramid;     /* Luma plane of the current frame and its downscaled copies */
+  PlateDetector *plate_detector;
+  guint frames_since_detect;
+  guint frames_since_refresh;
+  gboolean seen_delta_units;
+  guint8 *gray;             /* Grayscale copy of the frame handed to the detector */
+  gsize gray_size;
+  GArray *rects;            /* Scratch GstVideoRectangle array */
+  GArray *found;            /* Scratch of a single detector run */
+  GArray *detected;         /* Faces of the last detection pass */
+  GArray *regions;          /* Changed regions of the motion mask */
+  GArray *plates;           /* Plates of the current frame */
+};
+
+struct _GstPrivacyRedactClass
+{
+  GstVideoFilterClass parent_class;
+};
+
+GType gst_privacy_redact_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_PRIVACY_REDACT_H__ */
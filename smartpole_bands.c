@@ -0,0 +1,70 @@
+#include <stdlib.h>
+
+#include "smartpole_bands.h"
+
+/* Parse a list of bands in the form "TOP:MIN:MAX,TOP:MIN:MAX,...", e.g.
+ * "0:20:60,0.4:40:140,0.75:90:0". The first band must start at 0 and the tops must be
+ * increasing. Returns a GArray of SizeBand, or NULL with @error set. */
+GArray *size_bands_parse (const gchar *spec, GError **error)
+{
+  GArray *bands = g_array_new (FALSE, FALSE, sizeof (SizeBand));
+  gchar **items = g_strsplit (spec, ",", -1);
+  guint i;
+
+  for (i = 0; items[i]; i++) {
+    SizeBand band;
+    gchar **fields = g_strsplit (g_strstrip (items[i]), ":", -1);
+    gchar *end_top = NULL, *end_min = NULL, *end_max = NULL;
+    gboolean valid = g_strv_length (fields) == 3;
+
+    if (valid) {
+      band.top = g_ascii_strtod (fields[0], &end_top);
+      band.min_size = strtol (fields[1], &end_min, 10);
+      band.max_size = strtol (fields[2], &end_max, 10);
+      valid = *end_top == '\0' && *end_min == '\0' && *end_max == '\0' &&
+          band.top >= 0.0 && band.top < 1.0 && band.min_size > 0 &&
+          (band.max_size == 0 || band.max_size >= band.min_size) &&
+          (bands->len == 0 ? band.top == 0.0 :
+              band.top > g_array_index (bands, SizeBand, bands->len - 1).top);
+    }
+    g_strfreev (fields);
+
+    if (!valid) {
+      g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+          "Invalid size band \"%s\", expected TOP:MIN:MAX with increasing tops from 0",
+          items[i]);
+      g_strfreev (items);
+      g_array_free (bands, TRUE);
+      return NULL;
+    }
+    g_array_append_val (bands, band);
+  }
+  g_strfreev (items);
+
+  if (bands->len == 0) {
+    g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+        "Empty size band list");
+    g_array_free (bands, TRUE);
+    return NULL;
+  }
+
+  return bands;
+}
+
+/* The inverse of size_bands_parse() */
+gchar *size_bands_to_string (GArray *bands)
+{
+  GString *s = g_string_new (NULL);
+  gchar top[G_ASCII_DTOSTR_BUF_SIZE];
+  guint i;
+
+  for (i = 0; i < bands->len; i++) {
+    SizeBand *band = &g_array_index (bands, SizeBand, i);
+
+    g_ascii_formatd (top, sizeof (top), "%.3g", band->top);
+    g_string_append_printf (s, "%s%s:%d:%d", i ? "," : "", top, band->min_size,
+        band->max_size);
+  }
+
+  return g_string_free (s, FALSE);
+}
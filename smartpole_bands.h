@@ -0,0 +1,22 @@
+#ifndef __SMARTPOLE_BANDS_H__
+#define __SMARTPOLE_BANDS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Range of face sizes expected in one horizontal band of a camera's image. A pole camera
+ * looks down the street, so faces grow from the top of the frame to the bottom. A band
+ * reaches from its top to the top of the next band, or the bottom of the frame. */
+typedef struct _SizeBand {
+  gdouble top;              /* First row, as a fraction of the frame height */
+  gint min_size;            /* Smallest face height searched for, in frame pixels */
+  gint max_size;            /* Largest face height searched for, 0 for no limit */
+} SizeBand;
+
+GArray *size_bands_parse (const gchar *spec, GError **error);
+gchar *size_bands_to_string (GArray *bands);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_BANDS_H__ */
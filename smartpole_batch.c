@@ -0,0 +1,446 @@
+#include <string.h>
+#include <sys/resource.h>
+
+#include <glib/gstdio.h>
+
+#include "smartpole_batch.h"
+#include "smartpole_detector.h"
+#include "smartpole_pool.h"
+
+/* Frames buffered between decode, detection and encoding, which run on threads of their
+ * own */
+#define BATCH_QUEUE_SIZE 4
+/* Constant quality of the re-encoded video, x264's CRF */
+#define BATCH_QUALITY 21
+
+typedef struct _Batch Batch;
+
+/* One recording and the pipeline redacting it */
+typedef struct _BatchJob {
+  Batch *batch;
+  gchar *input;
+  gchar *output;
+  const gchar *muxer;       /* Factory of the output container, NULL for raw H.264 */
+  GstElement *pipeline;
+  GstElement *decoded;      /* Where the decoded video enters */
+  gboolean linked;          /* A video stream is linked to @decoded */
+
+  /* Written from the streaming thread until the pipeline stops */
+  guint64 frames;
+  GstClockTime first_pts;
+  GstClockTime end;         /* End of the last frame */
+
+  gint64 start_time;        /* Monotonic, in us */
+  gint64 end_time;
+  gchar *error;             /* Why the file failed, NULL if it did not */
+} BatchJob;
+
+struct _Batch {
+  GPtrArray *jobs;
+  const PipelineConfig *config;
+  guint n_jobs;             /* Jobs running at once */
+  guint threads;            /* Decoder and encoder threads of each job */
+  guint next;               /* Next job to start */
+  guint running;
+  GMainLoop *loop;
+};
+
+static void batch_job_free (BatchJob *job)
+{
+  if (job->pipeline)
+    gst_object_unref (job->pipeline);
+  g_free (job->input);
+  g_free (job->output);
+  g_free (job->error);
+  g_free (job);
+}
+
+/* Output file of @input in @dir, in the container its extension names */
+static BatchJob *batch_job_new (Batch *batch, const gchar *input, const gchar *dir)
+{
+  BatchJob *job = g_new0 (BatchJob, 1);
+  gchar *base = g_path_get_basename (input), *dot = strrchr (base, '.'), *name;
+  const gchar *extension = "mp4";
+
+  job->batch = batch;
+  job->input = g_strdup (input);
+  job->muxer = "mp4mux";
+  if (dot) {
+    if (g_ascii_strcasecmp (dot, ".mkv") == 0) {
+      extension = "mkv";
+      job->muxer = "matroskamux";
+    } else if (g_ascii_strcasecmp (dot, ".h264") == 0 || g_ascii_strcasecmp (dot, ".264") == 0) {
+      extension = "h264";
+      job->muxer = NULL;
+    }
+    *dot = '\0';
+  }
+  name = g_strdup_printf ("%s.%s", base, extension);
+  job->output = g_build_filename (dir, name, NULL);
+  job->first_pts = GST_CLOCK_TIME_NONE;
+  g_free (name);
+  g_free (base);
+
+  return job;
+}
+
+static gdouble batch_job_media_seconds (BatchJob *job)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (job->first_pts) || job->end <= job->first_pts)
+    return 0.0;
+  return (gdouble) (job->end - job->first_pts) / GST_SECOND;
+}
+
+static gdouble batch_job_wall_seconds (BatchJob *job)
+{
+  return (gdouble) (job->end_time - job->start_time) / G_USEC_PER_SEC;
+}
+
+/* Count the redacted frames and how much video they cover */
+static GstPadProbeReturn redact_probe_cb (GstPad *pad, GstPadProbeInfo *info, BatchJob *job)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+
+  job->frames++;
+  if (GST_CLOCK_TIME_IS_VALID (pts)) {
+    if (!GST_CLOCK_TIME_IS_VALID (job->first_pts) || pts < job->first_pts)
+      job->first_pts = pts;
+    if (GST_BUFFER_DURATION_IS_VALID (buffer))
+      pts += GST_BUFFER_DURATION (buffer);
+    job->end = MAX (job->end, pts);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Give the decoder the job's share of the threads */
+static void deep_element_added_cb (GstBin *bin, GstBin *sub_bin, GstElement *element,
+    BatchJob *job)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  if (factory && g_str_has_prefix (GST_OBJECT_NAME (factory), "avdec_"))
+    g_object_set (G_OBJECT (element), "max-threads", job->batch->threads, NULL);
+}
+
+/* Redact the first video stream, drop the others and the audio */
+static void decode_pad_added_cb (GstElement *decodebin, GstPad *pad, BatchJob *job)
+{
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  gboolean video = caps &&
+      g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure (caps, 0)), "video/");
+  GstElement *sink;
+  GstPad *sink_pad;
+
+  if (caps)
+    gst_caps_unref (caps);
+  if (video && !job->linked) {
+    sink_pad = gst_element_get_static_pad (job->decoded, "sink");
+    job->linked = gst_pad_link (pad, sink_pad) == GST_PAD_LINK_OK;
+  } else {
+    sink = gst_element_factory_make ("fakesink", NULL); g_assert (sink);
+    g_object_set (G_OBJECT (sink), "sync", FALSE, "async", FALSE, NULL);
+    gst_bin_add (GST_BIN (job->pipeline), sink);
+    gst_element_sync_state_with_parent (sink);
+    sink_pad = gst_element_get_static_pad (sink, "sink");
+    gst_pad_link (pad, sink_pad);
+  }
+  gst_object_unref (sink_pad);
+}
+
+/* Without a video stream nothing would ever reach the muxer */
+static void decode_no_more_pads_cb (GstElement *decodebin, BatchJob *job)
+{
+  GError *error;
+
+  if (job->linked)
+    return;
+  error = g_error_new_literal (GST_STREAM_ERROR, GST_STREAM_ERROR_WRONG_TYPE,
+      "No video stream");
+  gst_element_post_message (decodebin, gst_message_new_error (GST_OBJECT (decodebin), error,
+          NULL));
+  g_error_free (error);
+}
+
+static GstElement *make_queue (void)
+{
+  GstElement *queue = gst_element_factory_make ("queue", NULL); g_assert (queue);
+
+  g_object_set (G_OBJECT (queue), "max-size-buffers", (guint) BATCH_QUEUE_SIZE,
+      "max-size-bytes", (guint) 0, "max-size-time", (guint64) 0, NULL);
+  return queue;
+}
+
+/* filesrc ! decodebin ! queue ! videoconvert ! privacyredact ! queue ! videoconvert !
+ * x264enc ! h264parse [! muxer] ! filesink */
+static gboolean batch_job_build (BatchJob *job)
+{
+  const PipelineConfig *config = job->batch->config;
+  GstElement *source, *decodebin, *convert, *redact, *encoder_convert, *encoder, *parse;
+  GstElement *muxer = NULL, *sink;
+  GstElement *chain[10];
+  GstPad *pad;
+  guint n_chain = 0, i;
+
+  job->pipeline = gst_pipeline_new (NULL);
+  source = gst_element_factory_make ("filesrc", NULL); g_assert (source);
+  g_object_set (G_OBJECT (source), "location", job->input, NULL);
+  decodebin = gst_element_factory_make ("decodebin", NULL); g_assert (decodebin);
+  convert = gst_element_factory_make ("videoconvert", NULL); g_assert (convert);
+  redact = gst_element_factory_make ("privacyredact", NULL); g_assert (redact);
+  /* Redacted in line, without a live deadline there is nothing for the async mode to
+   * win */
+  g_object_set (G_OBJECT (redact), "blur-faces", TRUE, "display", FALSE, "blur-plates", TRUE,
+      "detect-scale", config->detect_scale, "detect-interval", config->detect_interval,
+      "motion-gate", config->motion_gate, "parallel", config->parallel_detect,
+      "redact-mode", config->redact_mode, "block-size", REDACT_BLOCK_SIZE, "blur-radius",
+      REDACT_BLUR_RADIUS, "blur-scale",
+      config->redact_mode == REDACT_INTEGRAL_BLUR ? REDACT_BLUR_SCALE : 0.0, NULL);
+  encoder_convert = gst_element_factory_make ("videoconvert", NULL); g_assert (encoder_convert);
+  encoder = gst_element_factory_make ("x264enc", NULL); g_assert (encoder);
+  gst_util_set_object_arg (G_OBJECT (encoder), "pass", "qual");
+  gst_util_set_object_arg (G_OBJECT (encoder), "speed-preset", "veryfast");
+  g_object_set (G_OBJECT (encoder), "quantizer", BATCH_QUALITY, "threads",
+      job->batch->threads, "byte-stream", job->muxer == NULL, NULL);
+  parse = gst_element_factory_make ("h264parse", NULL); g_assert (parse);
+  if (job->muxer) {
+    muxer = gst_element_factory_make (job->muxer, NULL); g_assert (muxer);
+  }
+  sink = gst_element_factory_make ("filesink", NULL); g_assert (sink);
+  g_object_set (G_OBJECT (sink), "location", job->output, "sync", FALSE, NULL);
+
+  job->decoded = make_queue ();
+  chain[n_chain++] = job->decoded;
+  chain[n_chain++] = convert;
+  chain[n_chain++] = redact;
+  chain[n_chain++] = make_queue ();
+  chain[n_chain++] = encoder_convert;
+  chain[n_chain++] = encoder;
+  chain[n_chain++] = parse;
+  if (muxer)
+    chain[n_chain++] = muxer;
+  chain[n_chain++] = sink;
+
+  gst_bin_add_many (GST_BIN (job->pipeline), source, decodebin, NULL);
+  for (i = 0; i < n_chain; i++)
+    gst_bin_add (GST_BIN (job->pipeline), chain[i]);
+  if (!gst_element_link (source, decodebin))
+    return FALSE;
+  for (i = 0; i + 1 < n_chain; i++) {
+    if (!gst_element_link (chain[i], chain[i + 1]))
+      return FALSE;
+  }
+  g_signal_connect (decodebin, "pad-added", G_CALLBACK (decode_pad_added_cb), job);
+  g_signal_connect (decodebin, "no-more-pads", G_CALLBACK (decode_no_more_pads_cb), job);
+  g_signal_connect (job->pipeline, "deep-element-added", G_CALLBACK (deep_element_added_cb),
+      job);
+
+  pad = gst_element_get_static_pad (redact, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) redact_probe_cb,
+      job, NULL);
+  gst_object_unref (pad);
+
+  return TRUE;
+}
+
+static void batch_start_next (Batch *batch);
+
+static void batch_job_finish (BatchJob *job, const gchar *error)
+{
+  Batch *batch = job->batch;
+
+  gst_element_set_state (job->pipeline, GST_STATE_NULL);
+  job->end_time = g_get_monotonic_time ();
+  if (error) {
+    job->error = g_strdup (error);
+    /* A partly written file is not a redacted copy of the recording */
+    g_unlink (job->output);
+    g_printerr ("%s: %s\n", job->input, error);
+  } else {
+    gdouble wall = batch_job_wall_seconds (job);
+
+    g_printerr ("%s: %" G_GUINT64_FORMAT " frames in %.1f s, %.1f fps, %.1fx real time\n",
+        job->input, job->frames, wall, wall > 0.0 ? job->frames / wall : 0.0,
+        wall > 0.0 ? batch_job_media_seconds (job) / wall : 0.0);
+  }
+
+  batch->running--;
+  batch_start_next (batch);
+  if (batch->running == 0)
+    g_main_loop_quit (batch->loop);
+}
+
+static gboolean batch_bus_cb (GstBus *bus, GstMessage *msg, BatchJob *job)
+{
+  GError *err = NULL;
+
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_EOS:
+      batch_job_finish (job, NULL);
+      return G_SOURCE_REMOVE;
+    case GST_MESSAGE_ERROR:
+      gst_message_parse_error (msg, &err, NULL);
+      batch_job_finish (job, err->message);
+      g_clear_error (&err);
+      return G_SOURCE_REMOVE;
+    default:
+      return G_SOURCE_CONTINUE;
+  }
+}
+
+/* Start jobs until @n_jobs run or none is left */
+static void batch_start_next (Batch *batch)
+{
+  while (batch->running < batch->n_jobs && batch->next < batch->jobs->len) {
+    BatchJob *job = g_ptr_array_index (batch->jobs, batch->next++);
+    GstBus *bus;
+
+    if (job->error)
+      continue;
+    job->start_time = g_get_monotonic_time ();
+    if (!batch_job_build (job)) {
+      job->end_time = job->start_time;
+      job->error = g_strdup ("Could not link the pipeline");
+      g_printerr ("%s: %s\n", job->input, job->error);
+      continue;
+    }
+    bus = gst_element_get_bus (job->pipeline);
+    gst_bus_add_watch (bus, (GstBusFunc) batch_bus_cb, job);
+    gst_object_unref (bus);
+    batch->running++;
+    if (gst_element_set_state (job->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+      /* The error message on the bus finishes the job */
+      g_printerr ("%s: could not start\n", job->input);
+  }
+}
+
+/* User and system time of the whole process, in seconds */
+static gdouble batch_cpu_seconds (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0.0;
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+      usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static void append_json_string (GString *json, const gchar *value)
+{
+  gchar *escaped = g_strescape (value, NULL);
+
+  g_string_append_printf (json, "\"%s\"", escaped);
+  g_free (escaped);
+}
+
+gboolean batch_run (gchar **files, const gchar *output_dir, const PipelineConfig *config,
+    guint cpu_budget, guint n_jobs, const gchar *summary_path)
+{
+  Batch batch = { 0 };
+  GHashTable *outputs = g_hash_table_new (g_str_hash, g_str_equal);
+  GString *json = g_string_new (NULL);
+  GError *error = NULL;
+  guint64 frames = 0;
+  gdouble media = 0.0, cpu = batch_cpu_seconds (), wall;
+  gint64 start = g_get_monotonic_time ();
+  guint n_failed = 0, detect_threads, i;
+  gboolean ok;
+
+  if (g_mkdir_with_parents (output_dir, 0755) != 0) {
+    g_printerr ("Could not create %s\n", output_dir);
+    return FALSE;
+  }
+  batch.config = config;
+  batch.jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) batch_job_free);
+  for (i = 0; files[i]; i++) {
+    BatchJob *job = batch_job_new (&batch, files[i], output_dir);
+    gchar *input = g_canonicalize_filename (job->input, NULL);
+    gchar *output = g_canonicalize_filename (job->output, NULL);
+
+    /* Never write over a recording or the redacted copy of another one */
+    if (g_strcmp0 (input, output) == 0)
+      job->error = g_strdup ("The output would replace the recording");
+    else if (g_hash_table_contains (outputs, job->output))
+      job->error = g_strdup_printf ("%s is the output of another recording", job->output);
+    else
+      g_hash_table_add (outputs, job->output);
+    if (job->error)
+      g_printerr ("%s: %s\n", job->input, job->error);
+    g_ptr_array_add (batch.jobs, job);
+    g_free (input);
+    g_free (output);
+  }
+  g_hash_table_unref (outputs);
+
+  /* The jobs split the budget, each decoding and encoding on its share of the cores */
+  batch.n_jobs = n_jobs > 0 ? n_jobs : MAX (1, MIN (cpu_budget, batch.jobs->len));
+  batch.threads = MAX (1, cpu_budget / batch.n_jobs);
+  /* Detection runs on threads every job shares. OpenCV's process-wide pool would start
+   * one thread per core, it gets one job's share: a job whose cascade finds the pool busy
+   * runs it on its own streaming thread. The pool of parallel detection was already
+   * capped to the budget. */
+  if (config->parallel_detect) {
+    detect_threads = work_pool_get_n_workers (work_pool_get_shared ());
+  } else {
+    detect_threads = batch.threads;
+    detector_set_num_threads (detect_threads);
+  }
+  batch.loop = g_main_loop_new (NULL, FALSE);
+  batch_start_next (&batch);
+  if (batch.running > 0)
+    g_main_loop_run (batch.loop);
+  g_main_loop_unref (batch.loop);
+  wall = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+  cpu = batch_cpu_seconds () - cpu;
+
+  g_string_append (json, "{\"results\": [");
+  for (i = 0; i < batch.jobs->len; i++) {
+    BatchJob *job = g_ptr_array_index (batch.jobs, i);
+    gdouble job_wall = batch_job_wall_seconds (job), job_media = batch_job_media_seconds (job);
+
+    if (i > 0)
+      g_string_append (json, ", ");
+    g_string_append (json, "{\"input\": ");
+    append_json_string (json, job->input);
+    g_string_append (json, ", \"output\": ");
+    append_json_string (json, job->output);
+    g_string_append_printf (json, ", \"frames\": %" G_GUINT64_FORMAT ", \"media_s\": %.3f, "
+        "\"wall_s\": %.3f, \"fps\": %.2f, \"speed\": %.2f, \"error\": ", job->frames,
+        job_media, job_wall, job_wall > 0.0 ? job->frames / job_wall : 0.0,
+        job_wall > 0.0 ? job_media / job_wall : 0.0);
+    if (job->error) {
+      append_json_string (json, job->error);
+      n_failed++;
+    } else {
+      g_string_append (json, "null");
+      frames += job->frames;
+      media += job_media;
+    }
+    g_string_append_c (json, '}');
+  }
+  g_string_append_printf (json, "], \"files\": %u, \"failed\": %u, \"jobs\": %u, "
+      "\"cpu_budget\": %u, \"threads_per_job\": %u, \"detect_threads\": %u, "
+      "\"frames\": %" G_GUINT64_FORMAT ", \"media_s\": %.3f, \"wall_s\": %.3f, "
+      "\"fps\": %.2f, \"speed\": %.2f, \"cpu_s\": %.3f, \"cores_used\": %.2f}\n",
+      batch.jobs->len, n_failed, batch.n_jobs, cpu_budget, batch.threads, detect_threads,
+      frames, media, wall, wall > 0.0 ? frames / wall : 0.0, wall > 0.0 ? media / wall : 0.0,
+      cpu, wall > 0.0 ? cpu / wall : 0.0);
+  g_printerr ("%u files, %u failed: %" G_GUINT64_FORMAT " frames in %.1f s, %.1f fps, "
+      "%.1fx real time on %.1f cores\n", batch.jobs->len, n_failed, frames, wall,
+      wall > 0.0 ? frames / wall : 0.0, wall > 0.0 ? media / wall : 0.0,
+      wall > 0.0 ? cpu / wall : 0.0);
+
+  ok = n_failed == 0;
+  if (summary_path && !g_file_set_contents (summary_path, json->str, json->len, &error)) {
+    g_printerr ("Could not write %s: %s\n", summary_path, error->message);
+    g_clear_error (&error);
+    ok = FALSE;
+  } else if (!summary_path) {
+    g_print ("%s", json->str);
+  }
+
+  g_string_free (json, TRUE);
+  g_ptr_array_unref (batch.jobs);
+  return ok;
+}
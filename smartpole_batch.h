@@ -0,0 +1,23 @@
+#ifndef __SMARTPOLE_BATCH_H__
+#define __SMARTPOLE_BATCH_H__
+
+#include <gst/gst.h>
+
+#include "smartpole_camera.h"
+
+G_BEGIN_DECLS
+
+/* Redact recordings (MP4, MKV or raw H.264) as fast as they decode: each file goes
+ * through decode -> privacyredact -> x264enc into a file of the same name and container
+ * in @output_dir, without a clock or a display. @n_jobs files run at once, each with
+ * @cpu_budget / @n_jobs decoder and encoder threads, and the detection threads the jobs
+ * share are limited to the same share, so the batch keeps about @cpu_budget cores busy.
+ * Only the video is kept. The JSON summary of the throughput of
+ * every file goes to @summary_path, or to the standard output if NULL. Returns FALSE
+ * if any file failed. */
+gboolean batch_run (gchar **files, const gchar *output_dir, const PipelineConfig *config,
+    guint cpu_budget, guint n_jobs, const gchar *summary_path);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_BATCH_H__ */
@@ -0,0 +1,1474 @@
+/* Benchmarks of the detection and redaction stages of smartpole_privacy_protector.
+ *
+ *   smartpole_bench scale --input FILE
+ *     Face detection throughput and recall at 1/1, 1/2, 1/3 and 1/4 detection scale. The
+ *     full size detections of each frame are the reference, a reference face counts as
+ *     recalled when the boxes found at the reduced scale cover most of it.
+ *
+ *   smartpole_bench calibrate --input FILE [--bands N]
+ *     Learn the face sizes of every band of rows from a recording of one camera and print
+ *     them as the size-bands line of its [camera ...] group, then replay the recording to
+ *     report the speedup and recall of the banded search against the unrestricted one.
+ *
+ *   smartpole_bench tiles --input FILE [--threads N] [--tile-size PX] [--cameras N]
+ *     Throughput and recall of the detection split into tiles and size ranges on the
+ *     shared pool, against one unsplit cascade per frame, with N cameras submitting frames
+ *     to the pool at the same time.
+ *
+ *   smartpole_bench plates --input FILE [--plate-scale N] [--plate-threshold T]
+ *     Number plate detection throughput on the luma plane downscaled by N, the cost of
+ *     making that plane from the frame, which face detection at the same scale shares,
+ *     and the number of plates found per frame.
+ *
+ *   smartpole_bench kernels [--iterations N]
+ *     Time of the pixelate, box blur and fill redaction kernels per region size, on a
+ *     luma plane and on interleaved NV12 chroma, with every instruction set the processor
+ *     supports. The SIMD outputs are compared with the scalar one and any difference
+ *     fails the benchmark. The integral blur rows show its cost does not grow with the
+ *     radius.
+ *
+ *   smartpole_bench pipeline [--input FILE] [--sprite PNG] [--camera-counts 1,4,8,16]
+ *     End to end throughput of smartpole_privacy_protector itself. A local RTSP server
+ *     stands in for the cameras, playing a test pattern or FILE with the sprite composited
+ *     on it as faces and a number plate drawn over it. The real program runs headless on
+ *     1, 4, 8 and 16 cameras of that server, with --app-args appended to its command line,
+ *     and the benchmark prints JSON with the fps, capture to sink latency percentiles,
+ *     CPU per camera and RSS of every run. Every frame is stamped with the time it was
+ *     made, with --glass-to-glass the program reads it back at its sinks and the runs
+ *     add the true glass to glass latency percentiles. --jitter and --loss delay and drop
+ *     the stand-in's RTP packets the way netem would, to exercise the jitterbuffer.
+ *
+ *   smartpole_bench soak --cameras N [--duration SEC] [--fail-period SEC]
+ *     Fault isolation of smartpole_privacy_protector over a long run. The program runs
+ *     headless on N cameras of the stand-in server. Every --fail-period seconds the first
+ *     camera fails: its connection is dropped, and every other time its stream is also
+ *     gone for a few seconds, so the reconnects fail and back off. The program's own
+ *     metrics, read at the start and the end, give the frames each camera delivered and
+ *     dropped. The benchmark prints them as JSON, and it fails when any of the other
+ *     cameras lost or dropped a frame, or the failing one did not recover.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/rtsp-server/rtsp-server.h>
+#include <gst/video/video.h>
+
+#include "smartpole_bands.h"
+#include "smartpole_detector.h"
+#include "smartpole_kernels.h"
+#include "smartpole_plates.h"
+#include "smartpole_pool.h"
+#include "smartpole_pyramid.h"
+#include "smartpole_stamp.h"
+#include "smartpole_tasks.h"
+
+#ifndef HAAR_CASCADES_DIR
+#define HAAR_CASCADES_DIR "/usr/share/opencv4/haarcascades"
+#endif
+
+#define RECALL_COVERAGE 0.7
+/* Margin around the face heights seen in a band, so that calibration does not lose the
+ * faces slightly smaller or larger than the recording happened to show */
+#define BAND_MIN_MARGIN 0.8
+#define BAND_MAX_MARGIN 1.25
+
+static gchar *opt_input = NULL;
+static gchar *opt_profile = HAAR_CASCADES_DIR "/haarcascade_frontalface_default.xml";
+static gint opt_frames = 300;
+static gint opt_min_size = 40;
+static gint opt_bands = 4;
+static gint opt_threads = 0;
+static gint opt_tile_size = 512;
+static gint opt_cameras = 1;
+static gint opt_plate_scale = 2;
+static gdouble opt_plate_threshold = 3.0;
+static gint opt_plate_min_height = 16;
+static gint opt_iterations = 200;
+static gchar *opt_sprite = NULL;
+static gchar *opt_camera_counts = "1,4,8,16";
+static gint opt_duration = 10;
+static gint opt_width = 1920;
+static gint opt_height = 1080;
+static gint opt_fps = 25;
+static gchar *opt_app = "./smartpole_privacy_protector";
+static gchar *opt_app_args = NULL;
+static gchar *opt_output = NULL;
+static gboolean opt_glass_to_glass = FALSE;
+static gint opt_jitter = 0;
+static gdouble opt_loss = 0.0;
+static gint opt_fail_period = 5;
+
+static GOptionEntry option_entries[] = {
+  { "input", 'i', 0, G_OPTION_ARG_FILENAME, &opt_input,
+    "Video file with faces to benchmark on", "FILE" },
+  { "profile", 0, 0, G_OPTION_ARG_FILENAME, &opt_profile,
+    "Face cascade classifier", "FILE" },
+  { "frames", 'n', 0, G_OPTION_ARG_INT, &opt_frames,
+    "Number of frames to process (default: 300)", "N" },
+  { "min-size", 0, 0, G_OPTION_ARG_INT, &opt_min_size,
+    "Smallest face searched for, in full size pixels (default: 40)", "PX" },
+  { "bands", 0, 0, G_OPTION_ARG_INT, &opt_bands,
+    "Number of row bands learned by calibrate (default: 4)", "N" },
+  { "threads", 0, 0, G_OPTION_ARG_INT, &opt_threads,
+    "Size of the detection pool of tiles, 0 for one thread per processor (default: 0)", "N" },
+  { "tile-size", 0, 0, G_OPTION_ARG_INT, &opt_tile_size,
+    "Smallest side of a tile (default: 512)", "PX" },
+  { "cameras", 0, 0, G_OPTION_ARG_INT, &opt_cameras,
+    "Number of cameras sharing the pool in tiles (default: 1)", "N" },
+  { "plate-scale", 0, 0, G_OPTION_ARG_INT, &opt_plate_scale,
+    "Downscale factor of the plane plates detects on (default: 2)", "N" },
+  { "plate-threshold", 0, 0, G_OPTION_ARG_DOUBLE, &opt_plate_threshold,
+    "Score a number plate needs in plates (default: 3.0)", "T" },
+  { "plate-min-height", 0, 0, G_OPTION_ARG_INT, &opt_plate_min_height,
+    "Smallest plate searched for, in full size pixels (default: 16)", "PX" },
+  { "iterations", 0, 0, G_OPTION_ARG_INT, &opt_iterations,
+    "Runs of each kernel timed by kernels (default: 200)", "N" },
+  { "sprite", 0, 0, G_OPTION_ARG_FILENAME, &opt_sprite,
+    "Face picture pipeline composites on the stand-in cameras' video", "PNG" },
+  { "camera-counts", 0, 0, G_OPTION_ARG_STRING, &opt_camera_counts,
+    "Numbers of cameras pipeline runs the program on (default: 1,4,8,16)", "N,..." },
+  { "duration", 0, 0, G_OPTION_ARG_INT, &opt_duration,
+    "Seconds pipeline measures each run for, after as long a warm-up (default: 10)", "SEC" },
+  { "width", 0, 0, G_OPTION_ARG_INT, &opt_width,
+    "Width of the stand-in cameras' video (default: 1920)", "PX" },
+  { "height", 0, 0, G_OPTION_ARG_INT, &opt_height,
+    "Height of the stand-in cameras' video (default: 1080)", "PX" },
+  { "fps", 0, 0, G_OPTION_ARG_INT, &opt_fps,
+    "Frame rate of the stand-in cameras' video (default: 25)", "N" },
+  { "app", 0, 0, G_OPTION_ARG_FILENAME, &opt_app,
+    "Program pipeline runs (default: ./smartpole_privacy_protector)", "PATH" },
+  { "app-args", 0, 0, G_OPTION_ARG_STRING, &opt_app_args,
+    "Options added to the program's command line, e.g. \"--pipelined --detect-threads 4\"",
+    "ARGS" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &opt_output,
+    "File pipeline writes its JSON to instead of the standard output", "FILE" },
+  { "glass-to-glass", 0, 0, G_OPTION_ARG_NONE, &opt_glass_to_glass,
+    "Run the program in its glass to glass mode and report that latency too", NULL },
+  { "jitter", 0, 0, G_OPTION_ARG_INT, &opt_jitter,
+    "Hold each RTP packet of the stand-in up to this many ms, at random (default: 0)", "MS" },
+  { "loss", 0, 0, G_OPTION_ARG_DOUBLE, &opt_loss,
+    "Percentage of the stand-in's RTP packets dropped at random (default: 0)", "PCT" },
+  { "fail-period", 0, 0, G_OPTION_ARG_INT, &opt_fail_period,
+    "Seconds between the failures soak injects into its first camera (default: 5)", "SEC" },
+  { NULL }
+};
+
+/* Decodes a file to 8 bit grayscale frames */
+typedef struct _FrameSource {
+  GstElement *pipeline;
+  GstElement *appsink;
+  GstSample *sample;
+  GstVideoFrame frame;
+  gboolean mapped;
+} FrameSource;
+
+static gboolean frame_source_open (FrameSource *source, const gchar *path, GError **error)
+{
+  gchar *description;
+
+  memset (source, 0, sizeof (*source));
+  description = g_strdup_printf ("filesrc location=\"%s\" ! decodebin ! videoconvert ! "
+      "video/x-raw,format=GRAY8 ! appsink name=sink sync=false", path);
+  source->pipeline = gst_parse_launch (description, error);
+  g_free (description);
+  if (!source->pipeline)
+    return FALSE;
+
+  source->appsink = gst_bin_get_by_name (GST_BIN (source->pipeline), "sink");
+  gst_element_set_state (source->pipeline, GST_STATE_PLAYING);
+  return TRUE;
+}
+
+/* Map the next frame, returns FALSE at the end of the file */
+static gboolean frame_source_next (FrameSource *source)
+{
+  GstVideoInfo info;
+
+  if (source->mapped) {
+    gst_video_frame_unmap (&source->frame);
+    gst_sample_unref (source->sample);
+    source->mapped = FALSE;
+  }
+
+  source->sample = gst_app_sink_pull_sample (GST_APP_SINK (source->appsink));
+  if (!source->sample)
+    return FALSE;
+  if (!gst_video_info_from_caps (&info, gst_sample_get_caps (source->sample)) ||
+      !gst_video_frame_map (&source->frame, &info, gst_sample_get_buffer (source->sample),
+          GST_MAP_READ)) {
+    gst_sample_unref (source->sample);
+    return FALSE;
+  }
+  source->mapped = TRUE;
+  return TRUE;
+}
+
+static void frame_source_close (FrameSource *source)
+{
+  if (source->mapped) {
+    gst_video_frame_unmap (&source->frame);
+    gst_sample_unref (source->sample);
+  }
+  gst_element_set_state (source->pipeline, GST_STATE_NULL);
+  gst_object_unref (source->appsink);
+  gst_object_unref (source->pipeline);
+}
+
+/* Fraction of @ref covered by the union of @rects, sampled on an 8x8 grid */
+static gdouble coverage (const GstVideoRectangle *ref, GArray *rects)
+{
+  gint covered = 0, gx, gy;
+  guint i;
+
+  for (gy = 0; gy < 8; gy++) {
+    for (gx = 0; gx < 8; gx++) {
+      gint px = ref->x + (2 * gx + 1) * ref->w / 16;
+      gint py = ref->y + (2 * gy + 1) * ref->h / 16;
+
+      for (i = 0; i < rects->len; i++) {
+        GstVideoRectangle *r = &g_array_index (rects, GstVideoRectangle, i);
+
+        if (px >= r->x && px < r->x + r->w && py >= r->y && py < r->y + r->h) {
+          covered++;
+          break;
+        }
+      }
+    }
+  }
+
+  return covered / 64.0;
+}
+
+static const guint bench_scales[] = { 1, 2, 3, 4 };
+#define N_BENCH_SCALES G_N_ELEMENTS (bench_scales)
+
+static int bench_scale (void)
+{
+  Detector *detector;
+  DetectorParams params = { 1.25, 3, opt_min_size, opt_min_size, 0, 0 };
+  FrameSource source;
+  GArray *reference, *rects;
+  GError *error = NULL;
+  gint64 elapsed[N_BENCH_SCALES] = { 0 };
+  guint64 recalled[N_BENCH_SCALES] = { 0 }, found[N_BENCH_SCALES] = { 0 };
+  guint64 n_reference = 0;
+  gint frames = 0;
+  guint s, i;
+
+  if (!opt_input) {
+    g_printerr ("scale needs --input\n");
+    return 1;
+  }
+  detector = detector_new (opt_profile, &error);
+  if (!detector || !frame_source_open (&source, opt_input, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+  reference = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  rects = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+
+  while (frames < opt_frames && frame_source_next (&source)) {
+    const guint8 *gray = GST_VIDEO_FRAME_PLANE_DATA (&source.frame, 0);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (&source.frame, 0);
+    gint width = GST_VIDEO_FRAME_WIDTH (&source.frame);
+    gint height = GST_VIDEO_FRAME_HEIGHT (&source.frame);
+
+    for (s = 0; s < N_BENCH_SCALES; s++) {
+      GArray *out = s == 0 ? reference : rects;
+      gint64 start = g_get_monotonic_time ();
+
+      detector_detect_scaled (detector, gray, width, height, stride, bench_scales[s], 0.1,
+          &params, out);
+      elapsed[s] += g_get_monotonic_time () - start;
+      found[s] += out->len;
+
+      for (i = 0; s > 0 && i < reference->len; i++)
+        if (coverage (&g_array_index (reference, GstVideoRectangle, i), rects) >= RECALL_COVERAGE)
+          recalled[s]++;
+    }
+    n_reference += reference->len;
+    frames++;
+  }
+
+  g_print ("%d frames, %" G_GUINT64_FORMAT " reference faces\n", frames, n_reference);
+  g_print ("scale    fps  speedup  faces  recall\n");
+  for (s = 0; s < N_BENCH_SCALES; s++) {
+    g_print ("1/%u  %7.1f  %6.2fx  %5" G_GUINT64_FORMAT "  %5.1f%%\n", bench_scales[s],
+        elapsed[s] ? frames * (gdouble) G_USEC_PER_SEC / elapsed[s] : 0.0,
+        elapsed[s] ? (gdouble) elapsed[0] / elapsed[s] : 0.0, found[s],
+        s == 0 ? 100.0 : (n_reference ? 100.0 * recalled[s] / n_reference : 0.0));
+  }
+
+  g_array_free (reference, TRUE);
+  g_array_free (rects, TRUE);
+  frame_source_close (&source);
+  detector_free (detector);
+  return 0;
+}
+
+/* Learn the bands from the faces the unrestricted search finds in the recording. A band
+ * without any face keeps the smallest size of the bands above it and the largest of the
+ * bands below it, which the perspective of a pole camera bounds it by. */
+static GArray *calibrate_bands (const gint *band_min, const gint *band_max)
+{
+  GArray *bands = g_array_new (FALSE, FALSE, sizeof (SizeBand));
+  gint b, other;
+
+  for (b = 0; b < opt_bands; b++) {
+    SizeBand band = { (gdouble) b / opt_bands, opt_min_size, 0 };
+
+    if (band_max[b] > 0) {
+      band.min_size = MAX (opt_min_size, (gint) (band_min[b] * BAND_MIN_MARGIN));
+      band.max_size = (gint) (band_max[b] * BAND_MAX_MARGIN + 0.5);
+    } else {
+      for (other = b - 1; other >= 0; other--) {
+        if (band_max[other] > 0) {
+          band.min_size = MAX (opt_min_size, (gint) (band_min[other] * BAND_MIN_MARGIN));
+          break;
+        }
+      }
+      for (other = b + 1; other < opt_bands; other++) {
+        if (band_max[other] > 0) {
+          band.max_size = (gint) (band_max[other] * BAND_MAX_MARGIN + 0.5);
+          break;
+        }
+      }
+    }
+    g_array_append_val (bands, band);
+  }
+
+  return bands;
+}
+
+static int bench_calibrate (void)
+{
+  Detector *detector;
+  DetectorParams params = { 1.25, 3, opt_min_size, opt_min_size, 0, 0 };
+  FrameSource source;
+  GArray *reference, *rects, *scratch, *tasks, *bands;
+  LumaPlane plane;
+  GError *error = NULL;
+  gint *band_min, *band_max;
+  gint64 elapsed_full = 0, elapsed_banded = 0;
+  guint64 n_reference = 0, recalled = 0;
+  gint frames = 0, pass, b, ret = 1;
+  gchar *spec;
+  guint i;
+
+  if (!opt_input || opt_bands < 1 || opt_bands > 32) {
+    g_printerr ("calibrate needs --input and 1 to 32 --bands\n");
+    return 1;
+  }
+  detector = detector_new (opt_profile, &error);
+  if (!detector) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+  reference = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  rects = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  scratch = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  tasks = g_array_new (FALSE, FALSE, sizeof (DetectTask));
+  band_min = g_new0 (gint, opt_bands);
+  band_max = g_new0 (gint, opt_bands);
+  bands = NULL;
+
+  /* The first pass learns the bands, the second one measures them on the same frames */
+  for (pass = 0; pass < 2; pass++) {
+    if (!frame_source_open (&source, opt_input, &error)) {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      g_clear_pointer (&bands, g_array_unref);
+      break;
+    }
+
+    for (frames = 0; frames < opt_frames && frame_source_next (&source); frames++) {
+      const guint8 *gray = GST_VIDEO_FRAME_PLANE_DATA (&source.frame, 0);
+      gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (&source.frame, 0);
+      GstVideoRectangle whole = { 0, 0, GST_VIDEO_FRAME_WIDTH (&source.frame),
+          GST_VIDEO_FRAME_HEIGHT (&source.frame) };
+      gint64 start = g_get_monotonic_time ();
+
+      detector_detect (detector, gray, whole.w, whole.h, stride, &params, reference);
+      elapsed_full += g_get_monotonic_time () - start;
+
+      if (pass == 0) {
+        for (i = 0; i < reference->len; i++) {
+          GstVideoRectangle *face = &g_array_index (reference, GstVideoRectangle, i);
+
+          b = CLAMP ((face->y + face->h / 2) * opt_bands / whole.h, 0, opt_bands - 1);
+          band_min[b] = band_max[b] ? MIN (band_min[b], face->h) : face->h;
+          band_max[b] = MAX (band_max[b], face->h);
+        }
+        continue;
+      }
+
+      start = g_get_monotonic_time ();
+      g_array_set_size (rects, 0);
+      detect_tasks_add (tasks, bands, whole.h, &whole, &params);
+      luma_plane_init (&plane, gray, whole.w, whole.h, stride);
+      detect_tasks_run (tasks, detector, &plane, 0.0, scratch, rects);
+      g_array_set_size (tasks, 0);
+      elapsed_banded += g_get_monotonic_time () - start;
+
+      for (i = 0; i < reference->len; i++)
+        if (coverage (&g_array_index (reference, GstVideoRectangle, i), rects) >= RECALL_COVERAGE)
+          recalled++;
+      n_reference += reference->len;
+    }
+    frame_source_close (&source);
+
+    if (pass == 0) {
+      bands = calibrate_bands (band_min, band_max);
+      elapsed_full = 0;
+    }
+  }
+
+  if (bands) {
+    spec = size_bands_to_string (bands);
+    g_print ("size-bands=%s\n", spec);
+    g_free (spec);
+    g_print ("%d frames, %" G_GUINT64_FORMAT " reference faces, speedup %.2fx, "
+        "recall %.1f%%\n", frames, n_reference,
+        elapsed_banded ? (gdouble) elapsed_full / elapsed_banded : 0.0,
+        n_reference ? 100.0 * recalled / n_reference : 100.0);
+    g_array_unref (bands);
+    ret = 0;
+  }
+
+  g_free (band_min);
+  g_free (band_max);
+  g_array_free (reference, TRUE);
+  g_array_free (rects, TRUE);
+  g_array_free (scratch, TRUE);
+  g_array_free (tasks, TRUE);
+  detector_free (detector);
+  return ret;
+}
+
+/* What one simulated camera of the tiles benchmark detects on */
+typedef struct _TilesCamera {
+  LumaPlane plane;
+  GstVideoRectangle whole;
+  const DetectorParams *params;
+  WorkPool *pool;
+  Detector **workers;
+  GArray *tasks;
+  GArray *rects;
+} TilesCamera;
+
+static void tiles_run_task (gpointer task, guint worker, gpointer user_data)
+{
+  TilesCamera *camera = user_data;
+
+  detect_task_run (task, camera->workers[worker], &camera->plane, 0.0,
+      ((DetectTask *) task)->found);
+}
+
+static gpointer tiles_camera_detect (gpointer data)
+{
+  TilesCamera *camera = data;
+  guint t;
+
+  g_array_set_size (camera->tasks, 0);
+  detect_tasks_add (camera->tasks, NULL, camera->whole.h, &camera->whole, camera->params);
+  detect_tasks_split (camera->tasks, opt_tile_size);
+  for (t = 0; t < camera->tasks->len; t++)
+    g_array_index (camera->tasks, DetectTask, t).found =
+        g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+
+  work_pool_run (camera->pool, tiles_run_task, camera->tasks->data, sizeof (DetectTask),
+      camera->tasks->len, camera);
+
+  g_array_set_size (camera->rects, 0);
+  for (t = 0; t < camera->tasks->len; t++) {
+    GArray *found = g_array_index (camera->tasks, DetectTask, t).found;
+
+    g_array_append_vals (camera->rects, found->data, found->len);
+    g_array_free (found, TRUE);
+  }
+  detect_merge_overlaps (camera->rects, 0.5);
+
+  return NULL;
+}
+
+static int bench_tiles (void)
+{
+  Detector *detector, **workers;
+  DetectorParams params = { 1.25, 3, opt_min_size, opt_min_size, 0, 0 };
+  FrameSource source;
+  TilesCamera *cameras;
+  GThread **threads;
+  WorkPool *pool;
+  GArray *reference;
+  GError *error = NULL;
+  gint64 elapsed_serial = 0, elapsed_tiles = 0;
+  guint64 n_reference = 0, recalled = 0, n_tasks = 0;
+  guint n_workers, w, i;
+  gint frames = 0, c;
+
+  if (!opt_input || opt_cameras < 1 || opt_tile_size < 64) {
+    g_printerr ("tiles needs --input, at least 1 --cameras and a --tile-size of 64 or more\n");
+    return 1;
+  }
+  detector = detector_new (opt_profile, &error);
+  if (!detector || !frame_source_open (&source, opt_input, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+
+  /* Same setup as smartpole_privacy_protector --detect-threads */
+  work_pool_set_shared_size (opt_threads);
+  detector_set_num_threads (0);
+  pool = work_pool_get_shared ();
+  n_workers = work_pool_get_n_workers (pool);
+  workers = g_new0 (Detector *, n_workers * opt_cameras);
+  for (w = 0; w < n_workers * opt_cameras; w++)
+    workers[w] = detector_new (opt_profile, NULL);
+
+  reference = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  cameras = g_new0 (TilesCamera, opt_cameras);
+  threads = g_new0 (GThread *, opt_cameras);
+  for (c = 0; c < opt_cameras; c++) {
+    cameras[c].params = &params;
+    cameras[c].pool = pool;
+    cameras[c].workers = workers + c * n_workers;
+    cameras[c].tasks = g_array_new (FALSE, FALSE, sizeof (DetectTask));
+    cameras[c].rects = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  }
+
+  while (frames < opt_frames && frame_source_next (&source)) {
+    gint64 start = g_get_monotonic_time ();
+
+    for (c = 0; c < opt_cameras; c++) {
+      cameras[c].whole.w = GST_VIDEO_FRAME_WIDTH (&source.frame);
+      cameras[c].whole.h = GST_VIDEO_FRAME_HEIGHT (&source.frame);
+      luma_plane_init (&cameras[c].plane, GST_VIDEO_FRAME_PLANE_DATA (&source.frame, 0),
+          cameras[c].whole.w, cameras[c].whole.h,
+          GST_VIDEO_FRAME_PLANE_STRIDE (&source.frame, 0));
+    }
+
+    detector_detect (detector, cameras[0].plane.data, cameras[0].whole.w, cameras[0].whole.h,
+        cameras[0].plane.stride, &params, reference);
+    elapsed_serial += g_get_monotonic_time () - start;
+
+    /* Every camera submits the same frame at once, as N streaming threads would */
+    start = g_get_monotonic_time ();
+    for (c = 0; c < opt_cameras; c++)
+      threads[c] = g_thread_new ("camera", tiles_camera_detect, &cameras[c]);
+    for (c = 0; c < opt_cameras; c++)
+      g_thread_join (threads[c]);
+    elapsed_tiles += g_get_monotonic_time () - start;
+    n_tasks += cameras[0].tasks->len;
+
+    for (i = 0; i < reference->len; i++)
+      if (coverage (&g_array_index (reference, GstVideoRectangle, i), cameras[0].rects) >=
+          RECALL_COVERAGE)
+        recalled++;
+    n_reference += reference->len;
+    frames++;
+  }
+
+  g_print ("%d frames, %u pool threads, %d cameras, %.1f tasks per frame\n", frames,
+      n_workers, opt_cameras, frames ? (gdouble) n_tasks / frames : 0.0);
+  g_print ("unsplit  %7.1f fps per camera on one thread\n",
+      elapsed_serial ? frames * (gdouble) G_USEC_PER_SEC / elapsed_serial : 0.0);
+  g_print ("tiles    %7.1f fps per camera, speedup %.2fx, recall %.1f%%\n",
+      elapsed_tiles ? frames * (gdouble) G_USEC_PER_SEC / elapsed_tiles : 0.0,
+      elapsed_tiles ? (gdouble) elapsed_serial * opt_cameras / elapsed_tiles : 0.0,
+      n_reference ? 100.0 * recalled / n_reference : 100.0);
+
+  for (c = 0; c < opt_cameras; c++) {
+    g_array_free (cameras[c].tasks, TRUE);
+    g_array_free (cameras[c].rects, TRUE);
+  }
+  for (w = 0; w < n_workers * opt_cameras; w++)
+    if (workers[w])
+      detector_free (workers[w]);
+  g_free (workers);
+  g_free (cameras);
+  g_free (threads);
+  g_array_free (reference, TRUE);
+  frame_source_close (&source);
+  detector_free (detector);
+  return 0;
+}
+
+static int bench_plates (void)
+{
+  PlateDetector *detector;
+  LumaPyramid *pyramid;
+  FrameSource source;
+  GArray *plates;
+  GError *error = NULL;
+  gint64 elapsed_scale = 0, elapsed_detect = 0;
+  guint64 n_plates = 0;
+  gint frames = 0;
+
+  if (!opt_input || opt_plate_scale < 1 || opt_plate_scale > PYRAMID_MAX_SCALE) {
+    g_printerr ("plates needs --input and a --plate-scale of 1 to %d\n", PYRAMID_MAX_SCALE);
+    return 1;
+  }
+  if (!frame_source_open (&source, opt_input, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+  detector = plate_detector_new ();
+  pyramid = luma_pyramid_new ();
+  plates = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+
+  for (frames = 0; frames < opt_frames && frame_source_next (&source); frames++) {
+    const LumaPlane *plane;
+    gint64 start = g_get_monotonic_time ();
+
+    luma_pyramid_set_frame (pyramid, GST_VIDEO_FRAME_PLANE_DATA (&source.frame, 0),
+        GST_VIDEO_FRAME_WIDTH (&source.frame), GST_VIDEO_FRAME_HEIGHT (&source.frame),
+        GST_VIDEO_FRAME_PLANE_STRIDE (&source.frame, 0));
+    plane = luma_pyramid_get (pyramid, opt_plate_scale);
+    elapsed_scale += g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    n_plates += plate_detector_detect (detector, plane, opt_plate_min_height,
+        opt_plate_threshold, plates);
+    elapsed_detect += g_get_monotonic_time () - start;
+  }
+
+  g_print ("%d frames at 1/%d, %.2f plates per frame\n", frames, opt_plate_scale,
+      frames ? (gdouble) n_plates / frames : 0.0);
+  g_print ("downscale %6.2f ms per frame\n",
+      frames ? elapsed_scale / 1000.0 / frames : 0.0);
+  g_print ("plates    %6.2f ms per frame, %.1f fps\n",
+      frames ? elapsed_detect / 1000.0 / frames : 0.0,
+      elapsed_detect ? frames * (gdouble) G_USEC_PER_SEC / elapsed_detect : 0.0);
+
+  g_array_free (plates, TRUE);
+  luma_pyramid_free (pyramid);
+  plate_detector_free (detector);
+  frame_source_close (&source);
+  return 0;
+}
+
+typedef enum {
+  BENCH_PIXELATE,
+  BENCH_BLUR_SMALL,
+  BENCH_BLUR_LARGE,
+  BENCH_INTEGRAL_SMALL,
+  BENCH_INTEGRAL_LARGE,
+  BENCH_FILL
+} BenchKernel;
+
+static const gchar *bench_kernel_names[] = { "pixelate/16", "blur/4", "blur/24", "integral/4",
+  "integral/96", "fill" };
+static const gint bench_region_sizes[] = { 32, 64, 128, 256, 512 };
+
+static void run_kernel (BenchKernel kernel, guint8 *data, gint stride, gint channels,
+    gint size, guint8 *scratch)
+{
+  static const guint8 pixel[] = { 16, 128 };
+  /* Chroma regions are half the size, and so is the strength */
+  gint scale = channels == 2 ? 2 : 1;
+
+  switch (kernel) {
+    case BENCH_PIXELATE:
+      kernel_pixelate (data, stride, channels, size, size, 16 / scale, 16 / scale, scratch);
+      break;
+    case BENCH_BLUR_SMALL:
+      kernel_box_blur (data, stride, channels, size, size, 4 / scale, scratch);
+      break;
+    case BENCH_BLUR_LARGE:
+      kernel_box_blur (data, stride, channels, size, size, 24 / scale, scratch);
+      break;
+    case BENCH_INTEGRAL_SMALL:
+      kernel_integral_blur (data, stride, channels, size, size, 4 / scale, scratch);
+      break;
+    case BENCH_INTEGRAL_LARGE:
+      kernel_integral_blur (data, stride, channels, size, size, 96 / scale, scratch);
+      break;
+    case BENCH_FILL:
+      kernel_fill (data, stride, channels, size, size, pixel);
+      break;
+  }
+}
+
+static int bench_kernels (void)
+{
+  const gint stride = 1024 * 2;
+  const gsize plane_size = (gsize) stride * 512;
+  KernelIsa best = kernel_get_isa (), isa;
+  guint8 *source, *reference, *output, *scratch;
+  gint channels, k, s, i, mismatches = 0;
+
+  source = g_malloc (plane_size);
+  reference = g_malloc (plane_size);
+  output = g_malloc (plane_size);
+  scratch = g_malloc (kernel_redact_scratch_size (512, 512, 2));
+  for (i = 0; i < (gint) plane_size; i++)
+    source[i] = g_random_int_range (0, 256);
+
+  g_print ("%-12s %-7s %6s", "kernel", "plane", "size");
+  for (isa = KERNEL_ISA_SCALAR; isa <= best; isa++)
+    g_print (" %10s", kernel_isa_name (isa));
+  g_print ("   us per region\n");
+
+  for (k = BENCH_PIXELATE; k <= BENCH_FILL; k++) {
+    for (channels = 1; channels <= 2; channels++) {
+      for (s = 0; s < (gint) G_N_ELEMENTS (bench_region_sizes); s++) {
+        gint size = bench_region_sizes[s] / channels;
+
+        g_print ("%-12s %-7s %6d", bench_kernel_names[k], channels == 1 ? "luma" : "chroma",
+            bench_region_sizes[s]);
+        for (isa = KERNEL_ISA_SCALAR; isa <= best; isa++) {
+          gint64 start;
+
+          if (!kernel_set_isa (isa)) {
+            g_print (" %10s", "-");
+            continue;
+          }
+          /* One run on a fresh copy is checked, the timed ones run on their own output */
+          memcpy (output, source, plane_size);
+          run_kernel (k, output, stride, channels, size, scratch);
+          if (isa == KERNEL_ISA_SCALAR) {
+            memcpy (reference, output, plane_size);
+          } else if (memcmp (reference, output, plane_size) != 0) {
+            g_printerr ("%s differs from scalar on %s %d\n", kernel_isa_name (isa),
+                bench_kernel_names[k], size);
+            mismatches++;
+          }
+
+          start = g_get_monotonic_time ();
+          for (i = 0; i < opt_iterations; i++)
+            run_kernel (k, output, stride, channels, size, scratch);
+          g_print (" %10.2f", (gdouble) (g_get_monotonic_time () - start) /
+              MAX (1, opt_iterations));
+        }
+        g_print ("\n");
+      }
+    }
+  }
+  kernel_set_isa (best);
+
+  g_print ("%s\n", mismatches ? "SIMD output differs from scalar" :
+      "SIMD output is bit-exact with scalar");
+  g_free (source);
+  g_free (reference);
+  g_free (output);
+  g_free (scratch);
+  return mismatches ? 1 : 0;
+}
+
+/* What the stand-in cameras show: every client gets the one shared encoding, so the
+ * server costs the same whatever the number of cameras */
+static gchar *pipeline_source_description (void)
+{
+  GString *launch = g_string_new ("( ");
+  /* Where the sprite goes, as fractions of the frame */
+  static const gdouble sprite_positions[][2] = { { 0.2, 0.3 }, { 0.5, 0.25 }, { 0.7, 0.4 } };
+  guint i;
+
+  if (opt_input)
+    g_string_append_printf (launch, "filesrc location=\"%s\" ! decodebin ! videoconvert ! "
+        "videoscale ! videorate ! ", opt_input);
+  else
+    g_string_append (launch, "videotestsrc is-live=true pattern=ball ! ");
+  g_string_append_printf (launch, "video/x-raw,width=%d,height=%d,framerate=%d/1 ! ",
+      opt_width, opt_height, opt_fps);
+  for (i = 0; opt_sprite && i < G_N_ELEMENTS (sprite_positions); i++)
+    g_string_append_printf (launch, "gdkpixbufoverlay location=\"%s\" offset-x=%d "
+        "offset-y=%d ! ", opt_sprite, (gint) (sprite_positions[i][0] * opt_width),
+        (gint) (sprite_positions[i][1] * opt_height));
+  /* Dark on light like a plate, for the edge density plate detection looks for */
+  g_string_append_printf (launch, "textoverlay text=\"AB12 CDE\" font-desc=\"Sans Bold %d\" "
+      "valignment=bottom halignment=center shaded-background=true ! videoconvert ! "
+      "video/x-raw,format=I420 ! identity name=stamp ! x264enc tune=zerolatency speed-preset=ultrafast key-int-max=%d ! "
+      "rtph264pay name=pay0 pt=96 config-interval=-1 )", MAX (12, opt_height / 24), opt_fps);
+
+  return g_string_free (launch, FALSE);
+}
+
+/* Stamp each frame with the wall clock time right before it is encoded */
+static GstPadProbeReturn stamp_probe_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  GstVideoInfo video_info;
+  GstVideoFrame frame;
+
+  if (!caps)
+    return GST_PAD_PROBE_OK;
+  if (gst_video_info_from_caps (&video_info, caps)) {
+    buffer = gst_buffer_make_writable (buffer);
+    GST_PAD_PROBE_INFO_DATA (info) = buffer;
+    if (gst_video_frame_map (&frame, &video_info, buffer, GST_MAP_READWRITE)) {
+      stamp_write (&frame, g_get_real_time ());
+      gst_video_frame_unmap (&frame);
+    }
+  }
+  gst_caps_unref (caps);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Delay and drop the packets of the stand-in like a bad network. A held packet holds
+ * the ones behind it too, as a congested link would. */
+static GstPadProbeReturn netem_probe_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+  if (opt_loss > 0.0 && g_random_double_range (0.0, 100.0) < opt_loss)
+    return GST_PAD_PROBE_DROP;
+  if (opt_jitter > 0)
+    g_usleep (g_random_int_range (0, opt_jitter * 1000 + 1));
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void media_configure_cb (GstRTSPMediaFactory *factory, GstRTSPMedia *media,
+    gpointer data)
+{
+  GstElement *element = gst_rtsp_media_get_element (media);
+  GstElement *stamp = gst_bin_get_by_name (GST_BIN (element), "stamp");
+  GstElement *pay = gst_bin_get_by_name (GST_BIN (element), "pay0");
+  GstPad *pad = gst_element_get_static_pad (stamp, "src");
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, stamp_probe_cb, NULL, NULL);
+  gst_object_unref (pad);
+  if (opt_jitter > 0 || opt_loss > 0.0) {
+    pad = gst_element_get_static_pad (pay, "src");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, netem_probe_cb, NULL, NULL);
+    gst_object_unref (pad);
+  }
+  gst_object_unref (pay);
+  gst_object_unref (stamp);
+  gst_object_unref (element);
+}
+
+/* A factory of the stand-in's video, shared by all of its clients */
+static GstRTSPMediaFactory *stand_in_factory_new (const gchar *launch)
+{
+  GstRTSPMediaFactory *factory = gst_rtsp_media_factory_new ();
+
+  gst_rtsp_media_factory_set_launch (factory, launch);
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  g_signal_connect (factory, "media-configure", G_CALLBACK (media_configure_cb), NULL);
+
+  return factory;
+}
+
+static gboolean pipeline_quit_cb (gpointer loop)
+{
+  g_main_loop_quit (loop);
+  return G_SOURCE_REMOVE;
+}
+
+/* Keep the RTSP server running for @ms */
+static void pipeline_wait (guint ms)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+
+  g_timeout_add (ms, pipeline_quit_cb, loop);
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+}
+
+/* User and system CPU time of process @pid, in seconds */
+static gdouble process_cpu_time (GPid pid)
+{
+  gchar *path = g_strdup_printf ("/proc/%d/stat", (gint) pid), *stat = NULL, *fields;
+  unsigned long utime = 0, stime = 0;
+
+  if (g_file_get_contents (path, &stat, NULL, NULL) && (fields = strrchr (stat, ')')))
+    sscanf (fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime);
+  g_free (stat);
+  g_free (path);
+
+  return (gdouble) (utime + stime) / sysconf (_SC_CLK_TCK);
+}
+
+/* Resident set size of process @pid, in bytes */
+static guint64 process_rss (GPid pid)
+{
+  gchar *path = g_strdup_printf ("/proc/%d/statm", (gint) pid), *statm = NULL;
+  guint64 size = 0, resident = 0;
+
+  if (g_file_get_contents (path, &statm, NULL, NULL))
+    sscanf (statm, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT, &size, &resident);
+  g_free (statm);
+  g_free (path);
+
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+/* The percentiles of @stage in a report of the program, those of its slowest camera,
+ * and the frames it dropped over all of them, in the report's own format, see
+ * camera_report_stats() */
+typedef struct _StagePercentiles {
+  gdouble p50, p95, p99;
+  guint64 dropped;
+} StagePercentiles;
+
+static void report_stage (const gchar *report, const gchar *stage,
+    StagePercentiles *percentiles)
+{
+  gchar *pattern = g_strdup_printf ("\"stage\": \"%s\", \"frames\": [0-9]+, "
+      "\"dropped\": ([0-9]+), \"p50_ms\": ([0-9.]+), \"p95_ms\": ([0-9.]+), "
+      "\"p99_ms\": ([0-9.]+)", stage);
+  GRegex *regex = g_regex_new (pattern, 0, 0, NULL);
+  GMatchInfo *match;
+  gint i;
+
+  memset (percentiles, 0, sizeof (*percentiles));
+  for (g_regex_match (regex, report, 0, &match); g_match_info_matches (match);
+      g_match_info_next (match, NULL)) {
+    gchar *values[4];
+
+    for (i = 0; i < 4; i++)
+      values[i] = g_match_info_fetch (match, i + 1);
+    percentiles->dropped += g_ascii_strtoull (values[0], NULL, 10);
+    percentiles->p50 = MAX (percentiles->p50, g_ascii_strtod (values[1], NULL));
+    percentiles->p95 = MAX (percentiles->p95, g_ascii_strtod (values[2], NULL));
+    percentiles->p99 = MAX (percentiles->p99, g_ascii_strtod (values[3], NULL));
+    for (i = 0; i < 4; i++)
+      g_free (values[i]);
+  }
+  g_match_info_free (match);
+  g_regex_unref (regex);
+  g_free (pattern);
+}
+
+/* Run the program on @n_cameras cameras of @location and append the run to @json.
+ * The program reports every --duration seconds, the second report covers the measured
+ * window after the warm-up. */
+static gboolean pipeline_run (const gchar *location, gint n_cameras, const gchar *dir,
+    GString *json)
+{
+  gchar *config_path = g_build_filename (dir, "cameras.conf", NULL);
+  gchar *stats_path = g_build_filename (dir, "stats.json", NULL);
+  gchar *interval = g_strdup_printf ("%d", opt_duration);
+  GString *config = g_string_new (NULL);
+  GPtrArray *argv = g_ptr_array_new ();
+  gchar **extra = NULL, *report = NULL, *camera_fps;
+  StagePercentiles total, glass;
+  GRegex *fps_regex;
+  GMatchInfo *match;
+  GError *error = NULL;
+  gdouble fps = 0.0, cpu;
+  guint64 rss;
+  gint n_reports = 0, status, c, i;
+  gboolean ok = FALSE;
+  GPid pid;
+
+  for (c = 0; c < n_cameras; c++)
+    g_string_append_printf (config, "[camera bench%d]\nlocation=%s\n\n", c, location);
+  g_unlink (stats_path);
+  if (!g_file_set_contents (config_path, config->str, config->len, &error))
+    goto out;
+
+  g_ptr_array_add (argv, opt_app);
+  g_ptr_array_add (argv, "--headless");
+  g_ptr_array_add (argv, "--config");
+  g_ptr_array_add (argv, config_path);
+  g_ptr_array_add (argv, "--stats-interval");
+  g_ptr_array_add (argv, interval);
+  g_ptr_array_add (argv, "--stats-file");
+  g_ptr_array_add (argv, stats_path);
+  if (opt_glass_to_glass)
+    g_ptr_array_add (argv, "--glass-to-glass");
+  if (opt_app_args && !g_shell_parse_argv (opt_app_args, NULL, &extra, &error))
+    goto out;
+  for (i = 0; extra && extra[i]; i++)
+    g_ptr_array_add (argv, extra[i]);
+  g_ptr_array_add (argv, NULL);
+  if (!g_spawn_async (NULL, (gchar **) argv->pdata, NULL, G_SPAWN_DO_NOT_REAP_CHILD |
+          G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, &pid, &error))
+    goto out;
+
+  pipeline_wait (opt_duration * 1000 + 250);
+  cpu = process_cpu_time (pid);
+  pipeline_wait (opt_duration * 1000);
+  cpu = process_cpu_time (pid) - cpu;
+  rss = process_rss (pid);
+  ok = waitpid (pid, &status, WNOHANG) == 0;
+  if (ok) {
+    kill (pid, SIGTERM);
+    waitpid (pid, &status, 0);
+  }
+  g_spawn_close_pid (pid);
+  if (!ok) {
+    g_set_error (&error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+        "%s exited during the run on %d cameras", opt_app, n_cameras);
+    goto out;
+  }
+  if (!g_file_get_contents (stats_path, &report, NULL, &error)) {
+    ok = FALSE;
+    goto out;
+  }
+
+  fps_regex = g_regex_new ("\"camera\": \"[^\"]*\", \"fps\": ([0-9.]+)", 0, 0, NULL);
+  for (g_regex_match (fps_regex, report, 0, &match); g_match_info_matches (match);
+      g_match_info_next (match, NULL)) {
+    camera_fps = g_match_info_fetch (match, 1);
+    fps += g_ascii_strtod (camera_fps, NULL);
+    g_free (camera_fps);
+    n_reports++;
+  }
+  g_match_info_free (match);
+  g_regex_unref (fps_regex);
+  report_stage (report, "total", &total);
+
+  g_string_append_printf (json, "{\"cameras\": %d, \"fps_per_camera\": %.2f, "
+      "\"latency_p50_ms\": %.3f, \"latency_p95_ms\": %.3f, \"latency_p99_ms\": %.3f, ",
+      n_cameras, n_reports ? fps / n_reports : 0.0, total.p50, total.p95, total.p99);
+  if (opt_glass_to_glass) {
+    report_stage (report, "glass", &glass);
+    g_string_append_printf (json, "\"glass_p50_ms\": %.3f, \"glass_p95_ms\": %.3f, "
+        "\"glass_p99_ms\": %.3f, ", glass.p50, glass.p95, glass.p99);
+  }
+  g_string_append_printf (json, "\"dropped\": %" G_GUINT64_FORMAT ", \"cpu_per_camera\": "
+      "%.3f, \"rss_bytes\": %" G_GUINT64_FORMAT ", \"report\": %s}", total.dropped,
+      cpu / opt_duration / n_cameras, rss, g_strchomp (report));
+  g_printerr ("%2d cameras: %.1f fps per camera, p99 %.1f ms, %.2f cores per camera, "
+      "%.0f MiB\n", n_cameras, n_reports ? fps / n_reports : 0.0, total.p99,
+      cpu / opt_duration / n_cameras, rss / 1048576.0);
+
+out:
+  if (error) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+  }
+  g_unlink (config_path);
+  g_free (report);
+  g_strfreev (extra);
+  g_ptr_array_unref (argv);
+  g_string_free (config, TRUE);
+  g_free (interval);
+  g_free (stats_path);
+  g_free (config_path);
+  return ok;
+}
+
+static int bench_pipeline (void)
+{
+  GstRTSPServer *server;
+  GstRTSPMediaFactory *factory;
+  GstRTSPMountPoints *mounts;
+  gchar **counts, *launch, *location, *dir, *app_args;
+  GString *json;
+  GError *error = NULL;
+  gboolean ok = TRUE;
+  guint i, n_runs = 0;
+
+  if (opt_duration < 1 || opt_width < 16 || opt_height < 16 || opt_fps < 1 ||
+      opt_jitter < 0 || opt_loss < 0.0 || opt_loss > 100.0) {
+    g_printerr ("pipeline needs a --duration of 1 or more, a valid video size and rate and "
+        "a --jitter and --loss that are not negative\n");
+    return 1;
+  }
+  dir = g_dir_make_tmp ("smartpole-bench-XXXXXX", &error);
+  if (!dir) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+
+  /* Any free port, on localhost only */
+  server = gst_rtsp_server_new ();
+  gst_rtsp_server_set_address (server, "127.0.0.1");
+  gst_rtsp_server_set_service (server, "0");
+  launch = pipeline_source_description ();
+  factory = stand_in_factory_new (launch);
+  mounts = gst_rtsp_server_get_mount_points (server);
+  gst_rtsp_mount_points_add_factory (mounts, "/bench", factory);
+  g_object_unref (mounts);
+  if (gst_rtsp_server_attach (server, NULL) == 0) {
+    g_printerr ("Could not start the RTSP server\n");
+    g_object_unref (server);
+    return 1;
+  }
+  location = g_strdup_printf ("rtsp://127.0.0.1:%d/bench", gst_rtsp_server_get_bound_port (server));
+
+  app_args = g_strescape (opt_app_args ? opt_app_args : "", NULL);
+  json = g_string_new (NULL);
+  g_string_append_printf (json, "{\"source\": \"%s\", \"width\": %d, \"height\": %d, "
+      "\"fps\": %d, \"jitter_ms\": %d, \"loss_pct\": %.2f, \"app_args\": \"%s\", "
+      "\"runs\": [", opt_input ? "file" : "videotestsrc", opt_width, opt_height, opt_fps,
+      opt_jitter, opt_loss, app_args);
+  g_free (app_args);
+  counts = g_strsplit (opt_camera_counts, ",", -1);
+  for (i = 0; ok && counts[i]; i++) {
+    gint n_cameras = (gint) g_ascii_strtoll (counts[i], NULL, 10);
+
+    if (n_cameras < 1)
+      continue;
+    if (n_runs++ > 0)
+      g_string_append (json, ", ");
+    ok = pipeline_run (location, n_cameras, dir, json);
+  }
+  g_string_append (json, "]}\n");
+
+  if (ok && opt_output && !g_file_set_contents (opt_output, json->str, json->len, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    ok = FALSE;
+  } else if (ok && !opt_output) {
+    g_print ("%s", json->str);
+  }
+
+  g_strfreev (counts);
+  g_string_free (json, TRUE);
+  g_free (location);
+  g_free (launch);
+  g_rmdir (dir);
+  g_free (dir);
+  g_object_unref (server);
+  return ok ? 0 : 1;
+}
+
+/* Path of the stand-in's stream soak makes fail */
+#define SOAK_FAULTY_PATH "/faulty"
+/* Seconds soak lets the program start before it takes the first metrics */
+#define SOAK_WARMUP_S 5
+/* How long the failing stream is gone every other failure, in ms */
+#define SOAK_OUTAGE_MS 3000
+/* Share of the frames the stand-in sent that the other cameras must deliver, which
+ * leaves room for the metrics not being read at the exact same frame */
+#define SOAK_MIN_FRAMES 0.98
+
+/* What the program's metrics say a camera did since the start */
+typedef struct _SoakCounters {
+  guint64 frames;           /* Frames that reached the sink */
+  guint64 dropped;          /* Frames dropped in any stage */
+  guint64 lost;             /* RTP packets lost */
+  guint64 overruns;         /* Times a stage queue was full */
+  guint64 reconnects;
+  guint64 restarts;
+} SoakCounters;
+
+/* Read the metrics of the program at the unix socket @path into @counters, one per
+ * camera bench0 to bench<n_cameras - 1> */
+static gboolean soak_read_metrics (const gchar *path, SoakCounters *counters, gint n_cameras,
+    GError **error)
+{
+  static const gchar request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+  GSocketClient *client = g_socket_client_new ();
+  GSocketAddress *address = g_unix_socket_address_new (path);
+  GSocketConnection *connection;
+  GString *response = g_string_new (NULL);
+  GRegex *regex;
+  GMatchInfo *match;
+  gchar buffer[4096];
+  gssize n;
+
+  connection = g_socket_client_connect (client, G_SOCKET_CONNECTABLE (address), NULL, error);
+  g_object_unref (address);
+  g_object_unref (client);
+  if (!connection) {
+    g_string_free (response, TRUE);
+    return FALSE;
+  }
+  if (g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (connection)),
+          request, strlen (request), NULL, NULL, error)) {
+    while ((n = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (connection)),
+                buffer, sizeof (buffer), NULL, error)) > 0)
+      g_string_append_len (response, buffer, n);
+  }
+  g_object_unref (connection);
+  if (error && *error) {
+    g_string_free (response, TRUE);
+    return FALSE;
+  }
+
+  memset (counters, 0, n_cameras * sizeof (SoakCounters));
+  regex = g_regex_new ("^(smartpole_[a-z_]+)\\{camera=\"bench([0-9]+)\"(,stage=\"([^\"]*)\")?"
+      "[^}]*\\} ([0-9.]+)$", G_REGEX_MULTILINE, 0, NULL);
+  for (g_regex_match (regex, response->str, 0, &match); g_match_info_matches (match);
+      g_match_info_next (match, NULL)) {
+    gchar *name = g_match_info_fetch (match, 1);
+    gchar *camera = g_match_info_fetch (match, 2);
+    gchar *stage = g_match_info_fetch (match, 4);
+    gchar *value = g_match_info_fetch (match, 5);
+    gint64 c = g_ascii_strtoll (camera, NULL, 10);
+    guint64 count = (guint64) g_ascii_strtod (value, NULL);
+
+    if (c >= 0 && c < n_cameras) {
+      SoakCounters *counter = &counters[c];
+
+      if (g_strcmp0 (name, "smartpole_stage_latency_seconds_count") == 0 &&
+          g_strcmp0 (stage, "total") == 0)
+        counter->frames = count;
+      else if (g_strcmp0 (name, "smartpole_stage_dropped_frames_total") == 0)
+        counter->dropped += count;
+      else if (g_strcmp0 (name, "smartpole_rtp_packets_lost_total") == 0)
+        counter->lost = count;
+      else if (g_strcmp0 (name, "smartpole_queue_overruns_total") == 0)
+        counter->overruns += count;
+      else if (g_strcmp0 (name, "smartpole_reconnects_total") == 0)
+        counter->reconnects = count;
+      else if (g_strcmp0 (name, "smartpole_restarts_total") == 0)
+        counter->restarts = count;
+    }
+    g_free (name);
+    g_free (camera);
+    g_free (stage);
+    g_free (value);
+  }
+  g_match_info_free (match);
+  g_regex_unref (regex);
+  g_string_free (response, TRUE);
+
+  return TRUE;
+}
+
+static GstRTSPFilterResult soak_session_filter_cb (GstRTSPClient *client,
+    GstRTSPSession *session, gpointer found)
+{
+  gint matched;
+
+  if (gst_rtsp_session_get_media (session, SOAK_FAULTY_PATH, &matched))
+    *(gboolean *) found = TRUE;
+  return GST_RTSP_FILTER_KEEP;
+}
+
+/* Close the connections of the clients of the failing stream */
+static GstRTSPFilterResult soak_client_filter_cb (GstRTSPServer *server,
+    GstRTSPClient *client, gpointer data)
+{
+  gboolean found = FALSE;
+
+  gst_rtsp_client_session_filter (client, soak_session_filter_cb, &found);
+  return found ? GST_RTSP_FILTER_REMOVE : GST_RTSP_FILTER_KEEP;
+}
+
+static int bench_soak (void)
+{
+  GstRTSPServer *server;
+  GstRTSPMediaFactory *factory, *faulty;
+  GstRTSPMountPoints *mounts;
+  SoakCounters *start, *recovered, *end;
+  gchar *launch, *dir, *config_path, *metrics_path, *metrics_arg, *app_args;
+  gchar **extra = NULL;
+  GString *config, *json;
+  GPtrArray *argv;
+  GError *error = NULL;
+  gint64 begin, elapsed;
+  gboolean ok = FALSE;
+  gint n_failures = 0, status, c, i;
+  guint port;
+  GPid pid;
+
+  if (opt_cameras < 2 || opt_duration < 1 || opt_fail_period * 1000 <= SOAK_OUTAGE_MS) {
+    g_printerr ("soak needs --cameras 2 or more, a --duration of 1 or more and a "
+        "--fail-period longer than %d s\n", SOAK_OUTAGE_MS / 1000);
+    return 1;
+  }
+  dir = g_dir_make_tmp ("smartpole-soak-XXXXXX", &error);
+  if (!dir) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+
+  server = gst_rtsp_server_new ();
+  gst_rtsp_server_set_address (server, "127.0.0.1");
+  gst_rtsp_server_set_service (server, "0");
+  launch = pipeline_source_description ();
+  factory = stand_in_factory_new (launch);
+  faulty = stand_in_factory_new (launch);
+  mounts = gst_rtsp_server_get_mount_points (server);
+  gst_rtsp_mount_points_add_factory (mounts, "/bench", factory);
+  gst_rtsp_mount_points_add_factory (mounts, SOAK_FAULTY_PATH, g_object_ref (faulty));
+  if (gst_rtsp_server_attach (server, NULL) == 0) {
+    g_printerr ("Could not start the RTSP server\n");
+    g_object_unref (mounts);
+    g_object_unref (faulty);
+    g_object_unref (server);
+    return 1;
+  }
+  port = gst_rtsp_server_get_bound_port (server);
+
+  /* RTP over the RTSP connection for the failing camera, so it sees its connection
+   * dropped right away */
+  config = g_string_new (NULL);
+  g_string_append_printf (config, "[camera bench0]\nlocation=rtspt://127.0.0.1:%u%s\n\n",
+      port, SOAK_FAULTY_PATH);
+  for (c = 1; c < opt_cameras; c++)
+    g_string_append_printf (config, "[camera bench%d]\nlocation=rtsp://127.0.0.1:%u/bench\n\n",
+        c, port);
+  config_path = g_build_filename (dir, "cameras.conf", NULL);
+  metrics_path = g_build_filename (dir, "metrics.sock", NULL);
+  metrics_arg = g_strdup_printf ("unix:%s", metrics_path);
+  start = g_new0 (SoakCounters, opt_cameras);
+  recovered = g_new0 (SoakCounters, opt_cameras);
+  end = g_new0 (SoakCounters, opt_cameras);
+  json = g_string_new (NULL);
+  argv = g_ptr_array_new ();
+  if (!g_file_set_contents (config_path, config->str, config->len, &error))
+    goto out;
+
+  g_ptr_array_add (argv, opt_app);
+  g_ptr_array_add (argv, "--headless");
+  g_ptr_array_add (argv, "--config");
+  g_ptr_array_add (argv, config_path);
+  g_ptr_array_add (argv, "--metrics");
+  g_ptr_array_add (argv, metrics_arg);
+  if (opt_app_args && !g_shell_parse_argv (opt_app_args, NULL, &extra, &error))
+    goto out;
+  for (i = 0; extra && extra[i]; i++)
+    g_ptr_array_add (argv, extra[i]);
+  g_ptr_array_add (argv, NULL);
+  if (!g_spawn_async (NULL, (gchar **) argv->pdata, NULL, G_SPAWN_DO_NOT_REAP_CHILD |
+          G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, &pid, &error))
+    goto out;
+
+  pipeline_wait (SOAK_WARMUP_S * 1000);
+  if (!soak_read_metrics (metrics_path, start, opt_cameras, &error))
+    goto stop;
+  begin = g_get_monotonic_time ();
+  /* The last period has no failure, for the failing camera to show it recovered */
+  while ((g_get_monotonic_time () - begin) / G_USEC_PER_SEC + 2 * opt_fail_period <=
+      opt_duration) {
+    pipeline_wait (opt_fail_period * 1000);
+    if (n_failures++ % 2 == 0) {
+      gst_rtsp_server_client_filter (server, soak_client_filter_cb, NULL);
+    } else {
+      gst_rtsp_mount_points_remove_factory (mounts, SOAK_FAULTY_PATH);
+      gst_rtsp_server_client_filter (server, soak_client_filter_cb, NULL);
+      pipeline_wait (SOAK_OUTAGE_MS);
+      gst_rtsp_mount_points_add_factory (mounts, SOAK_FAULTY_PATH, g_object_ref (faulty));
+    }
+  }
+  if (!soak_read_metrics (metrics_path, recovered, opt_cameras, &error))
+    goto stop;
+  pipeline_wait (MAX (0, opt_duration * 1000 -
+          (gint) ((g_get_monotonic_time () - begin) / 1000)));
+  if (!soak_read_metrics (metrics_path, end, opt_cameras, &error))
+    goto stop;
+  elapsed = g_get_monotonic_time () - begin;
+  ok = TRUE;
+
+  app_args = g_strescape (opt_app_args ? opt_app_args : "", NULL);
+  g_string_append_printf (json, "{\"cameras\": %d, \"duration_s\": %.1f, \"fps\": %d, "
+      "\"failures\": %d, \"app_args\": \"%s\", \"results\": [", opt_cameras,
+      (gdouble) elapsed / G_USEC_PER_SEC, opt_fps, n_failures, app_args);
+  g_free (app_args);
+  for (c = 0; c < opt_cameras; c++) {
+    guint64 frames = end[c].frames - start[c].frames;
+    guint64 expected = (guint64) ((gdouble) elapsed / G_USEC_PER_SEC * opt_fps);
+    guint64 dropped = end[c].dropped - start[c].dropped;
+    guint64 lost = end[c].lost - start[c].lost;
+    guint64 overruns = end[c].overruns - start[c].overruns;
+    gboolean passed;
+
+    if (c == 0)
+      passed = end[c].frames > recovered[c].frames &&
+          (n_failures == 0 || end[c].reconnects + end[c].restarts > start[c].reconnects +
+              start[c].restarts);
+    else
+      passed = dropped == 0 && lost == 0 && overruns == 0 &&
+          frames >= (guint64) (expected * SOAK_MIN_FRAMES);
+    ok = ok && passed;
+    g_string_append_printf (json, "%s{\"camera\": \"bench%d\", \"failing\": %s, \"frames\": %"
+        G_GUINT64_FORMAT ", \"expected_frames\": %" G_GUINT64_FORMAT ", \"dropped\": %"
+        G_GUINT64_FORMAT ", \"rtp_lost\": %" G_GUINT64_FORMAT ", \"overruns\": %"
+        G_GUINT64_FORMAT ", \"reconnects\": %" G_GUINT64_FORMAT ", \"restarts\": %"
+        G_GUINT64_FORMAT ", \"passed\": %s}", c > 0 ? ", " : "", c, c == 0 ? "true" : "false",
+        frames, expected, dropped, lost, overruns, end[c].reconnects - start[c].reconnects,
+        end[c].restarts - start[c].restarts, passed ? "true" : "false");
+    g_printerr ("bench%d%s: %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " frames, %"
+        G_GUINT64_FORMAT " dropped, %" G_GUINT64_FORMAT " packets lost, %" G_GUINT64_FORMAT
+        " reconnects, %s\n", c, c == 0 ? " (failing)" : "", frames, expected, dropped, lost,
+        end[c].reconnects - start[c].reconnects, passed ? "passed" : "FAILED");
+  }
+  g_string_append_printf (json, "], \"passed\": %s}\n", ok ? "true" : "false");
+
+stop:
+  if (waitpid (pid, &status, WNOHANG) == 0) {
+    kill (pid, SIGTERM);
+    waitpid (pid, &status, 0);
+  } else {
+    g_printerr ("%s exited during the soak\n", opt_app);
+    ok = FALSE;
+  }
+  g_spawn_close_pid (pid);
+
+  if (json->len > 0) {
+    if (opt_output && !g_file_set_contents (opt_output, json->str, json->len, &error))
+      ok = FALSE;
+    else if (!opt_output)
+      g_print ("%s", json->str);
+  }
+
+out:
+  if (error) {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    ok = FALSE;
+  }
+  g_unlink (config_path);
+  g_unlink (metrics_path);
+  g_rmdir (dir);
+  g_strfreev (extra);
+  g_ptr_array_unref (argv);
+  g_string_free (json, TRUE);
+  g_string_free (config, TRUE);
+  g_free (start);
+  g_free (recovered);
+  g_free (end);
+  g_free (metrics_arg);
+  g_free (metrics_path);
+  g_free (config_path);
+  g_free (launch);
+  g_free (dir);
+  g_object_unref (mounts);
+  g_object_unref (faulty);
+  g_object_unref (server);
+  return ok ? 0 : 1;
+}
+
+int main (int argc, char *argv[])
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  const gchar *command;
+
+  gst_init (&argc, &argv);
+
+  context = g_option_context_new ("scale|calibrate|tiles|plates|kernels|pipeline|soak - benchmark the privacy protector stages");
+  g_option_context_add_main_entries (context, option_entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("Option parsing failed: %s\n", error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+  g_option_context_free (context);
+
+  command = argc > 1 ? argv[1] : "";
+  if (g_strcmp0 (command, "scale") == 0)
+    return bench_scale ();
+  if (g_strcmp0 (command, "calibrate") == 0)
+    return bench_calibrate ();
+  if (g_strcmp0 (command, "tiles") == 0)
+    return bench_tiles ();
+  if (g_strcmp0 (command, "plates") == 0)
+    return bench_plates ();
+  if (g_strcmp0 (command, "kernels") == 0)
+    return bench_kernels ();
+  if (g_strcmp0 (command, "pipeline") == 0)
+    return bench_pipeline ();
+  if (g_strcmp0 (command, "soak") == 0)
+    return bench_soak ();
+
+  g_printerr ("Unknown benchmark \"%s\", expected scale, calibrate, tiles, plates, kernels, "
+      "pipeline or soak\n", command);
+  return 1;
+}
@@ -0,0 +1,1326 @@
+#include <math.h>
+#include <string.h>
+
+#include <gst/base/gstbasesink.h>
+#include <gst/rtp/rtp.h>
+#include <gst/video/video.h>
+#include <gst/video/videooverlay.h>
+
+#include "smartpole_bands.h"
+#include "smartpole_camera.h"
+#include "smartpole_stamp.h"
+
+#define CAMERA_GROUP_PREFIX "camera"
+
+/* First delay of a reconnect and the longest one the backoff goes to, in ms */
+#define RECONNECT_MIN_DELAY 100
+#define RECONNECT_MAX_DELAY 10000
+/* The same for restarts of the whole camera, which reload its cascades */
+#define RESTART_MIN_DELAY 1000
+#define RESTART_MAX_DELAY 60000
+/* Seconds without any RTP packet after which a camera counts as stalled */
+#define CAMERA_STALL_TIMEOUT 8
+
+Camera *camera_new (const gchar *name, const gchar *location, guint latency)
+{
+  Camera *camera = g_new0 (Camera, 1);
+
+  camera->name = g_strdup (name);
+  camera->location = g_strdup (location);
+  camera->latency = latency;
+  g_mutex_init (&camera->lock);
+  g_mutex_init (&camera->glass_lock);
+  gst_segment_init (&camera->segment, GST_FORMAT_TIME);
+  gst_segment_init (&camera->detect_segment, GST_FORMAT_TIME);
+  gst_segment_init (&camera->redact_segment, GST_FORMAT_TIME);
+  camera->report_time = g_get_monotonic_time ();
+  camera->blur_faces = TRUE;
+  camera->timers = g_ptr_array_new_with_free_func ((GDestroyNotify) stage_timer_free);
+  camera->rtp_seq = -1;
+
+  return camera;
+}
+
+void camera_free (Camera *camera)
+{
+  if (camera->reconnect_id)
+    g_source_remove (camera->reconnect_id);
+  if (camera->restart_id)
+    g_source_remove (camera->restart_id);
+  if (camera->async_detect) {
+    roi_store_clear (&camera->rois);
+    roi_store_clear (&camera->plate_rois);
+    g_array_free (camera->redact_rects, TRUE);
+    g_array_free (camera->plate_rects, TRUE);
+  }
+  g_ptr_array_unref (camera->timers);
+  if (camera->jitterbuffer)
+    gst_object_unref (camera->jitterbuffer);
+  g_mutex_clear (&camera->lock);
+  g_mutex_clear (&camera->glass_lock);
+  g_free (camera->name);
+  g_free (camera->location);
+  g_free (camera->size_bands);
+  g_free (camera->detect_location);
+  g_free (camera);
+}
+
+/* status play -> link rtspsrc */
+static void on_pad_added (GstElement *element, GstPad *pad, gpointer data)
+{
+  GstPad *sinkpad;
+  GstElement *depay = (GstElement *) data;
+
+  sinkpad = gst_element_get_static_pad (depay, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+/* Keep the jitterbuffer of the camera's current RTP session for camera_adapt_latency() */
+static void new_jitterbuffer_cb (GstElement *manager, GstElement *jitterbuffer, guint session,
+    guint ssrc, Camera *camera)
+{
+  g_mutex_lock (&camera->lock);
+  gst_object_replace ((GstObject **) &camera->jitterbuffer, GST_OBJECT (jitterbuffer));
+  camera->adapt_losses = 0;
+  g_mutex_unlock (&camera->lock);
+}
+
+/* rtspsrc makes a new rtpbin for every connection */
+static void new_manager_cb (GstElement *source, GstElement *manager, Camera *camera)
+{
+  g_signal_connect (manager, "new-jitterbuffer", G_CALLBACK (new_jitterbuffer_cb), camera);
+}
+
+/* Called from the upstream streaming thread when a stage queue is full, which means
+ * the stage behind it is the bottleneck */
+static void queue_overrun_cb (GstElement *queue, QueueStats *stats)
+{
+  g_atomic_int_inc (&stats->overruns);
+  g_atomic_int_inc (&stats->overruns_total);
+}
+
+/* Count the RTP packets the jitterbuffer passes on to the depayloader and the gaps in
+ * their sequence numbers, which are the packets it gave up on */
+static GstPadProbeReturn rtp_probe_cb (GstPad *pad, GstPadProbeInfo *info, Camera *camera)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    /* A new session starts its own sequence */
+    if (GST_EVENT_TYPE (event) == GST_EVENT_STREAM_START ||
+        GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      camera->rtp_seq = -1;
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    guint16 seq;
+
+    if (!gst_rtp_buffer_map (GST_PAD_PROBE_INFO_BUFFER (info), GST_MAP_READ, &rtp))
+      return GST_PAD_PROBE_OK;
+    seq = gst_rtp_buffer_get_seq (&rtp);
+    gst_rtp_buffer_unmap (&rtp);
+
+    g_atomic_pointer_add (&camera->rtp_packets, 1);
+    g_atomic_pointer_set (&camera->last_packet, (gsize) g_get_monotonic_time ());
+    if (camera->rtp_seq >= 0) {
+      gint gap = gst_rtp_buffer_compare_seqnum ((guint16) camera->rtp_seq, seq) - 1;
+
+      /* Late packets the jitterbuffer let through are not losses */
+      if (gap > 0)
+        g_atomic_pointer_add (&camera->rtp_lost, gap);
+      if (gap < 0)
+        return GST_PAD_PROBE_OK;
+    }
+    camera->rtp_seq = seq;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Create a bounded queue that starts a new streaming thread for the stage behind it */
+static GstElement *make_stage_queue (Camera *camera, const gchar *name)
+{
+  GstElement *queue;
+  QueueStats *stats;
+
+  g_assert (camera->n_queues < N_STAGE_QUEUES);
+  queue = gst_element_factory_make ("queue", NULL); g_assert (queue);
+  /* Bound the queue in frames only, the byte and time limits would otherwise kick in
+   * first at high resolutions */
+  g_object_set (G_OBJECT (queue), "max-size-buffers", (guint) camera->queue_size,
+      "max-size-bytes", (guint) 0, "max-size-time", (guint64) 0, NULL);
+
+  stats = &camera->queues[camera->n_queues++];
+  memset (stats, 0, sizeof (*stats));
+  stats->name = name;
+  stats->queue = queue;
+  stats->capacity = camera->queue_size;
+  g_signal_connect (queue, "overrun", G_CALLBACK (queue_overrun_cb), stats);
+
+  return queue;
+}
+
+/* Count the frames reaching the sink and how long ago they entered the pipeline. The
+ * running time of a live buffer is its capture time on the pipeline clock, so the clock
+ * time minus that is the time spent in the jitterbuffer, decoder and detector. */
+static GstPadProbeReturn sink_probe_cb (GstPad *pad, GstPadProbeInfo *info, Camera *camera)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT) {
+      g_mutex_lock (&camera->lock);
+      gst_event_copy_segment (event, &camera->segment);
+      g_mutex_unlock (&camera->lock);
+    }
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+    GstClock *clock = gst_element_get_clock (camera->sink);
+    GstClockTime running_time;
+    GstClockTimeDiff latency = -1;
+
+    g_mutex_lock (&camera->lock);
+    running_time = gst_segment_to_running_time (&camera->segment, GST_FORMAT_TIME,
+        GST_BUFFER_PTS (buffer));
+    if (clock && GST_CLOCK_TIME_IS_VALID (running_time))
+      latency = GST_CLOCK_DIFF (gst_element_get_base_time (camera->sink) + running_time,
+          gst_clock_get_time (clock));
+    camera->frames++;
+    if (camera->reconnect_start) {
+      stage_timer_record (camera->reconnect_timer,
+          (g_get_monotonic_time () - camera->reconnect_start) * GST_USECOND);
+      camera->reconnect_start = 0;
+    }
+    if (latency >= 0) {
+      camera->latency_sum += latency;
+      camera->latency_max = MAX (camera->latency_max, latency);
+    }
+    g_mutex_unlock (&camera->lock);
+
+    if (clock)
+      gst_object_unref (clock);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Remember when each frame entered the decoder for glass_probe_cb() */
+static GstPadProbeReturn decoder_probe_cb (GstPad *pad, GstPadProbeInfo *info,
+    Camera *camera)
+{
+  GstClockTime pts = GST_BUFFER_PTS (GST_PAD_PROBE_INFO_BUFFER (info));
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts))
+    return GST_PAD_PROBE_OK;
+  g_mutex_lock (&camera->glass_lock);
+  camera->glass_pts[camera->glass_next] = pts;
+  camera->glass_time[camera->glass_next] = g_get_monotonic_time ();
+  camera->glass_next = (camera->glass_next + 1) % GLASS_PENDING;
+  g_mutex_unlock (&camera->glass_lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* How long the sink will hold a frame before it shows it: until the clock reaches its
+ * running time plus the pipeline latency, for a sink that syncs at all */
+static GstClockTime render_wait (Camera *camera, GstBuffer *buffer)
+{
+  GstBaseSink *sink;
+  GstClock *clock;
+  GstClockTime running_time, wait = 0;
+
+  if (!GST_IS_BASE_SINK (camera->sink))
+    return 0;
+  sink = GST_BASE_SINK (camera->sink);
+  if (!gst_base_sink_get_sync (sink) || !(clock = gst_element_get_clock (camera->sink)))
+    return 0;
+
+  g_mutex_lock (&camera->lock);
+  running_time = gst_segment_to_running_time (&camera->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+  g_mutex_unlock (&camera->lock);
+  if (GST_CLOCK_TIME_IS_VALID (running_time)) {
+    GstClockTimeDiff diff = GST_CLOCK_DIFF (gst_clock_get_time (clock),
+        gst_element_get_base_time (camera->sink) + running_time +
+        gst_base_sink_get_latency (sink) + gst_base_sink_get_render_delay (sink));
+
+    wait = MAX (0, diff);
+  }
+  gst_object_unref (clock);
+
+  return wait;
+}
+
+/* Read the wall clock time the test source stamped into the frame and split the time
+ * since then into the part before the decoder, the network and the jitterbuffer, and
+ * the part the frame will still wait in the sink. The stages in between have their own
+ * timers. */
+static GstPadProbeReturn glass_probe_cb (GstPad *pad, GstPadProbeInfo *info, Camera *camera)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      if (!gst_video_info_from_caps (&camera->glass_info, caps))
+        gst_video_info_init (&camera->glass_info);
+    }
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+    gint64 now = g_get_real_time (), monotonic = g_get_monotonic_time (), stamped = 0;
+    GstClockTime wait;
+    GstVideoFrame frame;
+    gboolean stamp;
+    guint i;
+
+    if (GST_VIDEO_INFO_FORMAT (&camera->glass_info) == GST_VIDEO_FORMAT_UNKNOWN ||
+        !gst_video_frame_map (&frame, &camera->glass_info, buffer, GST_MAP_READ))
+      return GST_PAD_PROBE_OK;
+    stamp = stamp_read (&frame, now, &stamped);
+    gst_video_frame_unmap (&frame);
+    if (!stamp || stamped > now)
+      return GST_PAD_PROBE_OK;
+
+    wait = render_wait (camera, buffer);
+    stage_timer_record (camera->glass_timer, (now - stamped) * GST_USECOND + wait);
+    stage_timer_record (camera->render_timer, wait);
+
+    g_mutex_lock (&camera->glass_lock);
+    for (i = 1; i <= GLASS_PENDING; i++) {
+      guint slot = (camera->glass_next + GLASS_PENDING - i) % GLASS_PENDING;
+
+      if (camera->glass_pts[slot] == GST_BUFFER_PTS (buffer)) {
+        gint64 before = (now - stamped) - (monotonic - camera->glass_time[slot]);
+
+        stage_timer_record (camera->glass_network_timer, MAX (0, before) * GST_USECOND);
+        break;
+      }
+    }
+    g_mutex_unlock (&camera->glass_lock);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+#define OUTLINE_THICKNESS 2
+
+/* Push the rectangle list @field of a "privacyredact" message to @store */
+static void push_rect_list (RoiStore *store, const GstStructure *s, const gchar *field,
+    GstClockTime pts)
+{
+  const GValue *list = gst_structure_get_value (s, field);
+  GstVideoRectangle *rects;
+  guint i, n_rects;
+
+  n_rects = list ? gst_value_list_get_size (list) : 0;
+  rects = g_newa (GstVideoRectangle, n_rects + 1);
+  for (i = 0; i < n_rects; i++) {
+    const GstStructure *item = gst_value_get_structure (gst_value_list_get_value (list, i));
+    guint x = 0, y = 0, width = 0, height = 0;
+
+    gst_structure_get_uint (item, "x", &x);
+    gst_structure_get_uint (item, "y", &y);
+    gst_structure_get_uint (item, "width", &width);
+    gst_structure_get_uint (item, "height", &height);
+    rects[i].x = x;
+    rects[i].y = y;
+    rects[i].w = width;
+    rects[i].h = height;
+  }
+  roi_store_push (store, pts, rects, n_rects);
+}
+
+/* Turn the "privacyredact" element message of the detection branch into ROIs. This runs in
+ * the detection streaming thread, the bus would add a trip through the main loop. */
+static void detect_message_cb (GstBus *bus, GstMessage *msg, Camera *camera)
+{
+  const GstStructure *s = gst_message_get_structure (msg);
+  GstClockTime pts;
+
+  if (GST_MESSAGE_SRC (msg) != GST_OBJECT (camera->redact) ||
+      !gst_structure_has_name (s, "privacyredact") ||
+      !gst_structure_get_uint64 (s, "timestamp", &pts))
+    return;
+
+  pts = gst_segment_to_running_time (&camera->detect_segment, GST_FORMAT_TIME, pts);
+  push_rect_list (&camera->rois, s, "faces", pts);
+  if (gst_structure_has_field (s, "plates"))
+    push_rect_list (&camera->plate_rois, s, "plates", pts);
+}
+
+/* Keep track of the segment and size of the frames entering the detector, from its
+ * streaming thread */
+static GstPadProbeReturn detect_probe_cb (GstPad *pad, GstPadProbeInfo *info, Camera *camera)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT) {
+    gst_event_copy_segment (event, &camera->detect_segment);
+  } else if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+    GstCaps *caps;
+    GstVideoInfo info;
+
+    gst_event_parse_caps (event, &caps);
+    if (gst_video_info_from_caps (&info, caps)) {
+      g_atomic_int_set (&camera->detect_width, GST_VIDEO_INFO_WIDTH (&info));
+      g_atomic_int_set (&camera->detect_height, GST_VIDEO_INFO_HEIGHT (&info));
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Map the @n_rects boxes of @rects from the detected frames to the redacted ones, when
+ * the detector runs on a sub-stream of another size. The boxes are rounded outwards. */
+static void scale_rects (Camera *camera, GArray *rects, guint n_rects)
+{
+  gint width = GST_VIDEO_INFO_WIDTH (&camera->redact_info);
+  gint height = GST_VIDEO_INFO_HEIGHT (&camera->redact_info);
+  gint detect_width = g_atomic_int_get (&camera->detect_width);
+  gint detect_height = g_atomic_int_get (&camera->detect_height);
+  gdouble sx, sy;
+  guint i;
+
+  if (detect_width <= 0 || detect_height <= 0 ||
+      (detect_width == width && detect_height == height))
+    return;
+  sx = (gdouble) width / detect_width;
+  sy = (gdouble) height / detect_height;
+  for (i = 0; i < n_rects; i++) {
+    GstVideoRectangle *rect = &g_array_index (rects, GstVideoRectangle, i);
+    gint x0 = (gint) floor (rect->x * sx), y0 = (gint) floor (rect->y * sy);
+    gint x1 = MIN (width, (gint) ceil ((rect->x + rect->w) * sx));
+    gint y1 = MIN (height, (gint) ceil ((rect->y + rect->h) * sy));
+
+    rect->x = x0;
+    rect->y = y0;
+    rect->w = MAX (0, x1 - x0);
+    rect->h = MAX (0, y1 - y0);
+  }
+}
+
+static void add_roi_metas (GstBuffer *buffer, const gchar *roi_type, GArray *rects, guint n_rects)
+{
+  guint i;
+
+  for (i = 0; i < n_rects; i++) {
+    GstVideoRectangle *rect = &g_array_index (rects, GstVideoRectangle, i);
+
+    gst_buffer_add_video_region_of_interest_meta (buffer, roi_type, rect->x, rect->y,
+        rect->w, rect->h);
+  }
+}
+
+/* Redact the displayed frame with the detections closest to it in time. Only frames
+ * that need redaction are made writable, which copies them while the detection branch
+ * still holds a reference. */
+static GstPadProbeReturn redact_probe_cb (GstPad *pad, GstPadProbeInfo *info, Camera *camera)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      if (!gst_video_info_from_caps (&camera->redact_info, caps))
+        gst_video_info_init (&camera->redact_info);
+    } else if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT) {
+      gst_event_copy_segment (event, &camera->redact_segment);
+    }
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+    gint64 start = g_get_monotonic_time ();
+    gboolean blur_faces = g_atomic_int_get (&camera->blur_faces);
+    gboolean show_faces = g_atomic_int_get (&camera->show_faces);
+    gboolean blur_plates = g_atomic_int_get (&camera->blur_plates);
+    guint n_faces = 0, n_plates = 0;
+    GstClockTime running_time;
+    guint strength = camera->redact_mode == REDACT_PIXELATE ? REDACT_BLOCK_SIZE :
+        REDACT_BLUR_RADIUS;
+    gdouble relative = camera->redact_mode == REDACT_INTEGRAL_BLUR ? REDACT_BLUR_SCALE : 0.0;
+    GstVideoFrame frame;
+
+    if (GST_VIDEO_INFO_FORMAT (&camera->redact_info) == GST_VIDEO_FORMAT_UNKNOWN)
+      return GST_PAD_PROBE_OK;
+    running_time = gst_segment_to_running_time (&camera->redact_segment, GST_FORMAT_TIME,
+        GST_BUFFER_PTS (buffer));
+    if (blur_faces || show_faces)
+      n_faces = roi_store_lookup (&camera->rois, running_time, camera->redact_rects);
+    if (blur_plates)
+      n_plates = roi_store_lookup (&camera->plate_rois, running_time, camera->plate_rects);
+    if (n_faces == 0 && n_plates == 0) {
+      stage_timer_record (camera->redact_timer,
+          (g_get_monotonic_time () - start) * GST_USECOND);
+      return GST_PAD_PROBE_OK;
+    }
+    scale_rects (camera, camera->redact_rects, n_faces);
+    scale_rects (camera, camera->plate_rects, n_plates);
+
+    buffer = gst_buffer_make_writable (buffer);
+    GST_PAD_PROBE_INFO_DATA (info) = buffer;
+    if (gst_video_frame_map (&frame, &camera->redact_info, buffer, GST_MAP_READWRITE)) {
+      if (blur_faces)
+        roi_redact_frame (&frame, (GstVideoRectangle *) camera->redact_rects->data,
+            n_faces, camera->redact_mode, strength, relative);
+      if (show_faces)
+        roi_outline_frame (&frame, (GstVideoRectangle *) camera->redact_rects->data,
+            n_faces, OUTLINE_THICKNESS);
+      if (n_plates)
+        roi_redact_frame (&frame, (GstVideoRectangle *) camera->plate_rects->data,
+            n_plates, camera->redact_mode, strength, relative);
+      gst_video_frame_unmap (&frame);
+    }
+    /* Mark the frame as redacted like privacyredact does, for the restream passthrough */
+    add_roi_metas (buffer, "face", camera->redact_rects, n_faces);
+    add_roi_metas (buffer, "license-plate", camera->plate_rects, n_plates);
+    stage_timer_record (camera->redact_timer, (g_get_monotonic_time () - start) * GST_USECOND);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+#define CAMERA_INPUT_MAIN 1
+#define CAMERA_INPUT_SUB 2
+
+/* A source that lost its camera sends EOS, which would end the branch for good. Only
+ * the EOS of camera_finish() goes through, the others make the camera reconnect. */
+static gboolean eos_reconnect_cb (Camera *camera);
+
+static GstPadProbeReturn eos_probe_cb (GstPad *pad, GstPadProbeInfo *info, Camera *camera)
+{
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_EOS ||
+      g_atomic_int_get (&camera->finishing))
+    return GST_PAD_PROBE_OK;
+
+  g_idle_add ((GSourceFunc) eos_reconnect_cb, camera);
+  return GST_PAD_PROBE_DROP;
+}
+
+/* Drop what a new source sends until its first keyframe, which the kept decoder can
+ * start from. Cameras that take RTCP feedback are asked for one right away. */
+static GstPadProbeReturn keyframe_probe_cb (GstPad *pad, GstPadProbeInfo *info,
+    gboolean *requested)
+{
+  if (!GST_BUFFER_FLAG_IS_SET (GST_PAD_PROBE_INFO_BUFFER (info), GST_BUFFER_FLAG_DELTA_UNIT))
+    return GST_PAD_PROBE_REMOVE;
+  if (!*requested) {
+    *requested = TRUE;
+    gst_pad_send_event (pad, gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE,
+            TRUE, 0));
+  }
+
+  return GST_PAD_PROBE_DROP;
+}
+
+/* Create the rtspsrc and the depayloader of the main stream or the sub-stream, add them
+ * to the bin and link them to the parser of the stream */
+static gboolean make_input (Camera *camera, guint input)
+{
+  gboolean sub = input == CAMERA_INPUT_SUB;
+  gchar *name = g_strdup_printf (sub ? "%s-detect-source" : "%s-source", camera->name);
+  GstElement *source, *depay;
+  GstPad *pad;
+
+  source = gst_element_factory_make ("rtspsrc", name); g_assert (source);
+  g_free (name);
+  g_object_set (G_OBJECT (source), "location", sub ? camera->detect_location : camera->location,
+      "latency", (guint) g_atomic_int_get ((gint *) &camera->latency), NULL);
+  /* With ntp-sync both streams map their RTP timestamps to the camera's NTP clock from
+   * its RTCP sender reports, so a frame of either has the running time it was captured
+   * at and the ROIs of the sub-stream apply to the main stream frame of the same running
+   * time */
+  if (camera->detect_location)
+    g_object_set (G_OBJECT (source), "ntp-sync", TRUE, NULL);
+  /* A packet later than the latency is dropped rather than held, so one slow packet does
+   * not delay everything behind it */
+  if (camera->low_latency)
+    g_object_set (G_OBJECT (source), "drop-on-latency", TRUE, NULL);
+  depay = gst_element_factory_make ("rtph264depay", NULL); g_assert (depay);
+
+  gst_bin_add_many (camera->bin, source, depay, NULL);
+  if (!gst_element_link (depay, sub ? camera->detect_parse : camera->parse)) {
+    g_printerr ("%s: failed to link the %s depayloader\n", camera->name,
+        sub ? "sub-stream" : "main stream");
+    return FALSE;
+  }
+  /* listen for newly created pads */
+  g_signal_connect_object (source, "pad-added", G_CALLBACK (on_pad_added), depay,
+      G_CONNECT_AFTER);
+
+  if (sub) {
+    camera->detect_source = source;
+    camera->detect_depay = depay;
+    if (camera->sub_network_timer)
+      stage_timer_retarget (camera->sub_network_timer, depay, "sink");
+    else
+      camera->sub_network_timer = stage_timer_new_capture ("sub-network", depay, "sink");
+  } else {
+    camera->source = source;
+    camera->depay = depay;
+    g_signal_connect (source, "new-manager", G_CALLBACK (new_manager_cb), camera);
+    pad = gst_element_get_static_pad (depay, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) rtp_probe_cb, camera, NULL);
+    gst_object_unref (pad);
+    if (camera->network_timer)
+      stage_timer_retarget (camera->network_timer, depay, "sink");
+    else
+      camera->network_timer = stage_timer_new_capture ("network", depay, "sink");
+  }
+
+  return TRUE;
+}
+
+/* Tear down the rtspsrc and depayloader of a stream and start new ones. The parser,
+ * decoder, detector and everything behind them, buffer pools and cascades included, keep
+ * running and pick up at the new source's first keyframe. */
+static void replace_input (Camera *camera, guint input)
+{
+  gboolean sub = input == CAMERA_INPUT_SUB;
+  GstElement *source = sub ? camera->detect_source : camera->source;
+  GstElement *depay = sub ? camera->detect_depay : camera->depay;
+  GstPad *pad;
+
+  gst_element_set_state (source, GST_STATE_NULL);
+  gst_element_set_state (depay, GST_STATE_NULL);
+  gst_bin_remove_many (camera->bin, source, depay, NULL);
+  if (!sub) {
+    /* The new session brings its own jitterbuffer, its counters start from 0 */
+    g_mutex_lock (&camera->lock);
+    gst_object_replace ((GstObject **) &camera->jitterbuffer, NULL);
+    camera->adapt_losses = 0;
+    g_mutex_unlock (&camera->lock);
+  }
+  if (!make_input (camera, input))
+    return;
+
+  depay = sub ? camera->detect_depay : camera->depay;
+  pad = gst_element_get_static_pad (depay, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) keyframe_probe_cb, g_new0 (gboolean, 1), g_free);
+  gst_object_unref (pad);
+  gst_element_sync_state_with_parent (depay);
+  gst_element_sync_state_with_parent (sub ? camera->detect_source : camera->source);
+}
+
+static gboolean reconnect_cb (Camera *camera)
+{
+  camera->reconnect_id = 0;
+  g_atomic_int_inc (&camera->reconnects);
+  if (camera->reconnect_inputs & CAMERA_INPUT_MAIN) {
+    g_mutex_lock (&camera->lock);
+    camera->reconnect_start = g_get_monotonic_time ();
+    g_mutex_unlock (&camera->lock);
+    /* Give the new connection as long as a stalled one before it counts as stalled */
+    g_atomic_pointer_set (&camera->last_packet, (gsize) g_get_monotonic_time ());
+    replace_input (camera, CAMERA_INPUT_MAIN);
+  }
+  if (camera->reconnect_inputs & CAMERA_INPUT_SUB)
+    replace_input (camera, CAMERA_INPUT_SUB);
+  camera->reconnect_inputs = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Reconnect at once after a camera that was running failed, and back off while the
+ * reconnects do not bring any frame */
+static void schedule_reconnect (Camera *camera, guint inputs)
+{
+  gboolean failing;
+
+  camera->reconnect_inputs |= inputs;
+  if (camera->reconnect_id || camera->restart_id)
+    return;
+  g_mutex_lock (&camera->lock);
+  failing = camera->reconnect_start != 0;
+  g_mutex_unlock (&camera->lock);
+  camera->reconnect_delay = failing ?
+      MIN (camera->reconnect_delay * 2, RECONNECT_MAX_DELAY) : RECONNECT_MIN_DELAY;
+  g_print ("%s: reconnecting in %u ms\n", camera->name, camera->reconnect_delay);
+  camera->reconnect_id = g_timeout_add (camera->reconnect_delay, (GSourceFunc) reconnect_cb,
+      camera);
+}
+
+static gboolean eos_reconnect_cb (Camera *camera)
+{
+  g_print ("%s: the camera ended the stream\n", camera->name);
+  schedule_reconnect (camera, CAMERA_INPUT_MAIN);
+  return G_SOURCE_REMOVE;
+}
+
+/* Take the elements of the camera down and bring them back up, for the errors a new
+ * source does not fix. The other cameras keep running, the pipeline never leaves
+ * PLAYING. The sink is left out, it keeps its window or goes on with the file it is
+ * writing. */
+static gboolean restart_cb (Camera *camera)
+{
+  camera->restart_id = 0;
+  if (camera->reconnect_id) {
+    g_source_remove (camera->reconnect_id);
+    camera->reconnect_id = 0;
+  }
+  camera->reconnect_inputs = 0;
+  g_atomic_int_inc (&camera->restarts);
+  g_mutex_lock (&camera->lock);
+  camera->reconnect_start = g_get_monotonic_time ();
+  gst_object_replace ((GstObject **) &camera->jitterbuffer, NULL);
+  camera->adapt_losses = 0;
+  g_mutex_unlock (&camera->lock);
+  g_atomic_pointer_set (&camera->last_packet, (gsize) g_get_monotonic_time ());
+
+  gst_element_set_locked_state (camera->sink, TRUE);
+  gst_element_set_state (GST_ELEMENT (camera->bin), GST_STATE_NULL);
+  if (!gst_element_sync_state_with_parent (GST_ELEMENT (camera->bin)))
+    g_printerr ("%s: failed to restart\n", camera->name);
+  gst_element_set_locked_state (camera->sink, FALSE);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Restart after the first failure of a running camera, a second later, and back off
+ * while the restarts do not bring any frame */
+static void schedule_restart (Camera *camera)
+{
+  gboolean failing;
+
+  if (camera->restart_id)
+    return;
+  g_mutex_lock (&camera->lock);
+  failing = camera->reconnect_start != 0;
+  g_mutex_unlock (&camera->lock);
+  camera->restart_delay = failing && camera->restart_delay ?
+      MIN (camera->restart_delay * 2, RESTART_MAX_DELAY) : RESTART_MIN_DELAY;
+  g_print ("%s: restarting in %u ms\n", camera->name, camera->restart_delay);
+  camera->restart_id = g_timeout_add (camera->restart_delay, (GSourceFunc) restart_cb,
+      camera);
+}
+
+/* The stream of the camera @object belongs to, by the name of its topmost ancestor, which
+ * also finds the children of a source that was replaced since */
+static guint input_of (Camera *camera, GstObject *object)
+{
+  GstObject *top = gst_object_ref (object), *parent;
+  gchar *name = g_strdup_printf ("%s-source", camera->name);
+  gchar *detect_name = g_strdup_printf ("%s-detect-source", camera->name);
+  guint input = 0;
+
+  if (object == GST_OBJECT (camera->depay))
+    input = CAMERA_INPUT_MAIN;
+  else if (camera->detect_depay && object == GST_OBJECT (camera->detect_depay))
+    input = CAMERA_INPUT_SUB;
+  while (!input && top) {
+    if (g_strcmp0 (GST_OBJECT_NAME (top), name) == 0)
+      input = CAMERA_INPUT_MAIN;
+    else if (g_strcmp0 (GST_OBJECT_NAME (top), detect_name) == 0)
+      input = CAMERA_INPUT_SUB;
+    parent = gst_object_get_parent (top);
+    gst_object_unref (top);
+    top = parent;
+  }
+  if (top)
+    gst_object_unref (top);
+  g_free (name);
+  g_free (detect_name);
+
+  return input;
+}
+
+/* Handle the error @msg when it comes from an element of the camera: reconnect the
+ * stream for the errors of its sources, restart the camera up to its sink for the
+ * others. Returns FALSE for the errors of the sink and of elements outside of the
+ * camera, which the application handles. */
+gboolean camera_handle_error (Camera *camera, GstMessage *msg)
+{
+  guint input = input_of (camera, GST_MESSAGE_SRC (msg));
+  GError *err;
+
+  /* A restart leaves the sink out, so it does not fix the errors of the sink */
+  if (!input && (!gst_object_has_as_ancestor (GST_MESSAGE_SRC (msg), GST_OBJECT (camera->bin)) ||
+          GST_MESSAGE_SRC (msg) == GST_OBJECT (camera->sink) ||
+          gst_object_has_as_ancestor (GST_MESSAGE_SRC (msg), GST_OBJECT (camera->sink))))
+    return FALSE;
+  gst_message_parse_error (msg, &err, NULL);
+  g_printerr ("%s: %s: %s\n", camera->name, GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)),
+      err->message);
+  g_clear_error (&err);
+  /* A pending restart covers whatever else fails before it */
+  if (input)
+    schedule_reconnect (camera, input);
+  else
+    schedule_restart (camera);
+
+  return TRUE;
+}
+
+/* Reconnect a camera whose link went silent without an error */
+void camera_check_stall (Camera *camera)
+{
+  gint64 last = (gsize) g_atomic_pointer_get (&camera->last_packet);
+
+  if (last && !camera->reconnect_id && !camera->restart_id &&
+      g_get_monotonic_time () - last > CAMERA_STALL_TIMEOUT * G_TIME_SPAN_SECOND) {
+    g_printerr ("%s: no packet for %d s\n", camera->name, CAMERA_STALL_TIMEOUT);
+    schedule_reconnect (camera, CAMERA_INPUT_MAIN);
+  }
+}
+
+/* Let the next EOS through to the sink, for the headless output to finish its file */
+void camera_finish (Camera *camera)
+{
+  g_atomic_int_set (&camera->finishing, TRUE);
+}
+
+/* Create the source -> decoder part of the detection branch of a camera detected on its
+ * sub-stream, add it to the bin and return the decoder */
+static GstElement *make_detect_source (Camera *camera)
+{
+  GstElement *decoder;
+  GstPad *pad;
+
+  camera->detect_parse = gst_element_factory_make ("h264parse", NULL); g_assert (camera->detect_parse);
+  decoder = gst_element_factory_make ("avdec_h264", NULL); g_assert (decoder);
+
+  gst_bin_add_many (camera->bin, camera->detect_parse, decoder, NULL);
+  if (!gst_element_link (camera->detect_parse, decoder) ||
+      !make_input (camera, CAMERA_INPUT_SUB))
+    g_printerr ("%s: failed to link the sub-stream decoder\n", camera->name);
+  pad = gst_element_get_static_pad (camera->detect_parse, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) eos_probe_cb, camera, NULL);
+  gst_object_unref (pad);
+  g_ptr_array_add (camera->timers, camera->sub_network_timer);
+  g_ptr_array_add (camera->timers, stage_timer_new ("sub-decode", decoder));
+
+  return decoder;
+}
+
+/* Create the sink of the camera branch: the display sink, or in headless mode the
+ * output bin of @config or a fakesink */
+static GstElement *make_sink (Camera *camera, const PipelineConfig *config)
+{
+  GstElement *sink;
+  gchar *name = g_strdup_printf ("%s-sink", camera->name);
+
+  if (!config->headless) {
+    sink = gst_element_factory_make ("ximagesink", name); g_assert (sink);
+    /* Show each frame the moment it is redacted instead of at its capture time plus the
+     * pipeline latency */
+    if (config->low_latency)
+      g_object_set (G_OBJECT (sink), "sync", FALSE, NULL);
+  } else if (config->output) {
+    gchar **parts = g_strsplit (config->output, "%s", -1);
+    gchar *description = g_strjoinv (camera->name, parts);
+    GError *error = NULL;
+
+    sink = gst_parse_bin_from_description_full (description, TRUE, NULL,
+        GST_PARSE_FLAG_FATAL_ERRORS, &error);
+    if (sink)
+      gst_object_set_name (GST_OBJECT (sink), name);
+    else {
+      g_printerr ("%s: invalid output \"%s\": %s\n", camera->name, description,
+          error->message);
+      g_clear_error (&error);
+    }
+    g_free (description);
+    g_strfreev (parts);
+  } else {
+    /* Drop the frames as soon as they are redacted, at the rate they arrive */
+    sink = gst_element_factory_make ("fakesink", name); g_assert (sink);
+    g_object_set (G_OBJECT (sink), "sync", FALSE, NULL);
+  }
+  g_free (name);
+
+  return sink;
+}
+
+/* Create the elements of the camera branch, add them to @bin and link them */
+gboolean camera_build (Camera *camera, GstBin *pipeline, const PipelineConfig *config)
+{
+  GstElement *parse, *filter, *decoder, *videoConvert = NULL;
+  GstElement *detect_input = NULL, *detect_queue = NULL, *detect_sink = NULL;
+  GstElement *restream_tee = NULL, *unit_tee = NULL;
+  GstElement *chain[16];
+  GstPad *pad;
+  gchar *name;
+  guint n_chain = 0, n_redact = 0, i;
+
+  camera->queue_size = config->queue_size;
+  /* A camera detected on its sub-stream always redacts from the ROIs of another branch */
+  camera->async_detect = config->async_detect || camera->detect_location;
+  camera->redact_mode = config->redact_mode;
+
+  /* Every camera is a bin of its own, which prerolls on its own, so a camera restarting
+   * never takes the pipeline or the other cameras out of PLAYING */
+  name = g_strdup_printf ("%s-bin", camera->name);
+  camera->bin = GST_BIN (gst_bin_new (name));
+  g_free (name);
+  g_object_set (G_OBJECT (camera->bin), "async-handling", TRUE, NULL);
+  gst_bin_add (pipeline, GST_ELEMENT (camera->bin));
+  camera->low_latency = config->low_latency;
+  if (camera->detect_location)
+    detect_input = make_detect_source (camera);
+
+  parse = camera->parse = gst_element_factory_make ("h264parse", NULL); g_assert (parse);
+  filter = gst_element_factory_make ("capsfilter", NULL); g_assert (filter);
+  decoder = gst_element_factory_make ("avdec_h264", NULL); g_assert (decoder);
+  camera->redact = gst_element_factory_make ("privacyredact", NULL); g_assert (camera->redact);
+  g_object_set (G_OBJECT (camera->redact), "blur-faces", camera->blur_faces,
+      "display", camera->show_faces, "blur-plates", camera->blur_plates, "detect-scale", config->detect_scale,
+      "detect-interval", config->detect_interval, "motion-gate", config->motion_gate,
+      "parallel", config->parallel_detect, "redact-mode", config->redact_mode,
+      "block-size", REDACT_BLOCK_SIZE, "blur-radius", REDACT_BLUR_RADIUS, "blur-scale",
+      config->redact_mode == REDACT_INTEGRAL_BLUR ? REDACT_BLUR_SCALE : 0.0, NULL);
+  if (camera->size_bands)
+    g_object_set (G_OBJECT (camera->redact), "size-bands", camera->size_bands, NULL);
+  camera->sink = make_sink (camera, config);
+  if (!camera->sink)
+    return FALSE;
+  /* privacyredact works on the decoder's I420 output directly, the only conversion left
+   * is the one the display sink needs. A headless output bin converts on its own if it
+   * has to. */
+  if (!config->headless) {
+    videoConvert = gst_element_factory_make ("videoconvert", NULL); g_assert (videoConvert);
+  }
+
+  /* In pipelined mode a bounded queue in front of the decoder, the detector and the sink
+   * gives each of them its own streaming thread, so the frame rate is set by the slowest
+   * stage instead of the sum of all of them */
+  chain[n_chain++] = parse;
+  chain[n_chain++] = filter;
+  if (config->restream && config->restream_passthrough) {
+    /* The access units are tee'd before decoding too, for the GOPs passed through as
+     * they are. The parameter sets must come in-band with every keyframe for those. */
+    g_object_set (G_OBJECT (parse), "config-interval", -1, NULL);
+    unit_tee = gst_element_factory_make ("tee", NULL); g_assert (unit_tee);
+    chain[n_chain++] = unit_tee;
+  }
+  if (config->pipelined)
+    chain[n_chain++] = make_stage_queue (camera, "decode");
+  chain[n_chain++] = decoder;
+  if (camera->async_detect) {
+    /* The detection branch sits behind a one frame leaky queue, so the display path never
+     * waits for the detector, which only sees the newest frame. It is fed by a tee of
+     * the decoded frames, or by the decoded sub-stream. */
+    g_object_set (G_OBJECT (camera->redact), "blur-faces", FALSE, "display", FALSE,
+        "blur-plates", FALSE, "detect-plates", camera->blur_plates, "post-messages", TRUE,
+        NULL);
+    detect_queue = make_stage_queue (camera, "detect");
+    g_object_set (G_OBJECT (detect_queue), "max-size-buffers", 1, "leaky", 2, NULL);
+    camera->queues[camera->n_queues - 1].capacity = 1;
+    detect_sink = gst_element_factory_make ("fakesink", NULL); g_assert (detect_sink);
+    g_object_set (G_OBJECT (detect_sink), "sync", FALSE, "async", FALSE, NULL);
+    n_redact = n_chain - 1;
+    if (!detect_input) {
+      detect_input = gst_element_factory_make ("tee", NULL); g_assert (detect_input);
+      n_redact = n_chain;
+      chain[n_chain++] = detect_input;
+    }
+  } else {
+    if (config->pipelined)
+      chain[n_chain++] = make_stage_queue (camera, "detect");
+    chain[n_chain++] = camera->redact;
+  }
+  if (config->restream) {
+    /* The redacted frames are tee'd to the encoder before any conversion */
+    restream_tee = gst_element_factory_make ("tee", NULL); g_assert (restream_tee);
+    chain[n_chain++] = restream_tee;
+  }
+  if (videoConvert)
+    chain[n_chain++] = videoConvert;
+  if (config->pipelined)
+    chain[n_chain++] = make_stage_queue (camera, "output");
+  chain[n_chain++] = camera->sink;
+
+  for (i = 0; i < n_chain; i++)
+    gst_bin_add (camera->bin, chain[i]);
+  if (camera->async_detect) {
+    GstBus *bus;
+
+    gst_bin_add_many (camera->bin, detect_queue, camera->redact, detect_sink, NULL);
+    if (!gst_element_link_many (detect_input, detect_queue, camera->redact, detect_sink,
+            NULL)) {
+      g_printerr ("%s: failed to link the detection branch\n", camera->name);
+      return FALSE;
+    }
+    pad = gst_element_get_static_pad (camera->redact, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) detect_probe_cb, camera, NULL);
+    gst_object_unref (pad);
+
+    roi_store_init (&camera->rois, config->roi_margin, config->roi_hold);
+    roi_store_init (&camera->plate_rois, config->roi_margin, config->roi_hold);
+    camera->redact_rects = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+    camera->plate_rects = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+    gst_video_info_init (&camera->redact_info);
+    camera->redact_timer = stage_timer_new_manual ("redact");
+    /* The redaction runs right after the decoder or the tee, in front of any output
+     * queue */
+    pad = gst_element_get_static_pad (chain[n_redact + 1], "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) redact_probe_cb, camera, NULL);
+    gst_object_unref (pad);
+
+    bus = gst_element_get_bus (GST_ELEMENT (pipeline));
+    gst_bus_enable_sync_message_emission (bus);
+    g_signal_connect (bus, "sync-message::element", G_CALLBACK (detect_message_cb), camera);
+    gst_object_unref (bus);
+  }
+
+  for (i = 0; i + 1 < n_chain; i++) {
+    if (!gst_element_link (chain[i], chain[i + 1])) {
+      g_printerr ("%s: failed to link %s to %s\n", camera->name,
+          GST_ELEMENT_NAME (chain[i]), GST_ELEMENT_NAME (chain[i + 1]));
+      return FALSE;
+    }
+  }
+  if (!make_input (camera, CAMERA_INPUT_MAIN))
+    return FALSE;
+  pad = gst_element_get_static_pad (parse, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) eos_probe_cb, camera, NULL);
+  gst_object_unref (pad);
+
+  if (restream_tee) {
+    GstElement *units, *encode = restream_add_camera (config->restream, camera->name,
+        camera->bin, &units);
+
+    if (!encode || !gst_element_link (restream_tee, encode) ||
+        (unit_tee && !(units && gst_element_link (unit_tee, units)))) {
+      g_printerr ("%s: failed to link the restream branch\n", camera->name);
+      return FALSE;
+    }
+  }
+
+  pad = gst_element_get_static_pad (camera->sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) sink_probe_cb, camera, NULL);
+  gst_object_unref (pad);
+
+  if (config->glass_to_glass) {
+    for (i = 0; i < GLASS_PENDING; i++)
+      camera->glass_pts[i] = GST_CLOCK_TIME_NONE;
+    gst_video_info_init (&camera->glass_info);
+    camera->glass_timer = stage_timer_new_manual ("glass");
+    camera->glass_network_timer = stage_timer_new_manual ("glass-network");
+    camera->render_timer = stage_timer_new_manual ("render");
+
+    pad = gst_element_get_static_pad (decoder, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) decoder_probe_cb, camera, NULL);
+    gst_object_unref (pad);
+    pad = gst_element_get_static_pad (camera->sink, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) glass_probe_cb, camera, NULL);
+    gst_object_unref (pad);
+  }
+
+  /* From capture to the depayloader is the network and the jitterbuffer of rtspsrc. The
+   * elements in between are timed from their sink to their src pad, and the whole
+   * branch from capture to the sink. */
+  if (camera->glass_timer) {
+    g_ptr_array_add (camera->timers, camera->glass_timer);
+    g_ptr_array_add (camera->timers, camera->glass_network_timer);
+  }
+  g_ptr_array_add (camera->timers, camera->network_timer);
+  for (i = 0; i < camera->n_queues; i++) {
+    gchar *stage = g_strdup_printf ("queue-%s", camera->queues[i].name);
+
+    g_ptr_array_add (camera->timers, stage_timer_new (stage, camera->queues[i].queue));
+    g_free (stage);
+  }
+  g_ptr_array_add (camera->timers, stage_timer_new ("decode", decoder));
+  g_ptr_array_add (camera->timers, stage_timer_new ("detect", camera->redact));
+  if (camera->redact_timer)
+    g_ptr_array_add (camera->timers, camera->redact_timer);
+  if (videoConvert)
+    g_ptr_array_add (camera->timers, stage_timer_new ("convert", videoConvert));
+  if (camera->render_timer)
+    g_ptr_array_add (camera->timers, camera->render_timer);
+  g_ptr_array_add (camera->timers, stage_timer_new_capture ("total", camera->sink, "sink"));
+  camera->reconnect_timer = stage_timer_new_manual ("reconnect");
+  g_ptr_array_add (camera->timers, camera->reconnect_timer);
+
+  return TRUE;
+}
+
+/* Switch the pixelation of the faces on or off. The detection itself keeps running, only
+ * the rendering changes. */
+void camera_set_blur_faces (Camera *camera, gboolean blur_faces)
+{
+  g_atomic_int_set (&camera->blur_faces, blur_faces);
+  if (camera->redact && !camera->async_detect)
+    g_object_set (G_OBJECT (camera->redact), "blur-faces", blur_faces, NULL);
+}
+
+/* Switch the outlining of the faces on or off */
+void camera_set_show_faces (Camera *camera, gboolean show_faces)
+{
+  g_atomic_int_set (&camera->show_faces, show_faces);
+  if (camera->redact && !camera->async_detect)
+    g_object_set (G_OBJECT (camera->redact), "display", show_faces, NULL);
+}
+
+/* Switch the detection and pixelation of the number plates on or off. Plates cost
+ * nothing while this is off. */
+void camera_set_blur_plates (Camera *camera, gboolean blur_plates)
+{
+  g_atomic_int_set (&camera->blur_plates, blur_plates);
+  if (camera->redact)
+    g_object_set (G_OBJECT (camera->redact),
+        camera->async_detect ? "detect-plates" : "blur-plates", blur_plates, NULL);
+}
+
+/* Render the camera into the native window @handle. Headless sinks have no window. */
+void camera_set_window_handle (Camera *camera, guintptr handle)
+{
+  if (GST_IS_VIDEO_OVERLAY (camera->sink))
+    gst_video_overlay_set_window_handle (GST_VIDEO_OVERLAY (camera->sink), handle);
+}
+
+/* Raised latency when packets are lost or late, and what it falls to after
+ * LATENCY_CALM_PERIODS periods without */
+#define LATENCY_RAISE 1.5
+#define LATENCY_LOWER 0.9
+#define LATENCY_CALM_PERIODS 10
+/* The latency never goes below this many times the jitter, plus a margin in ms */
+#define LATENCY_JITTER_FACTOR 4
+#define LATENCY_MARGIN 20
+
+/* Move the jitterbuffer latency between @latency_min and @latency_max ms from the jitter
+ * and the losses of the last period: up at once when packets came too late for it, down
+ * slowly once they have not for a while. Called from the main loop every period. */
+void camera_adapt_latency (Camera *camera, guint latency_min, guint latency_max)
+{
+  GstElement *jitterbuffer = NULL;
+  GstStructure *stats = NULL;
+  guint64 lost = 0, late = 0, jitter = 0, losses, previous;
+  guint latency = g_atomic_int_get ((gint *) &camera->latency), floor, target;
+
+  g_mutex_lock (&camera->lock);
+  if (camera->jitterbuffer)
+    jitterbuffer = gst_object_ref (camera->jitterbuffer);
+  g_mutex_unlock (&camera->lock);
+  if (!jitterbuffer)
+    return;
+
+  g_object_get (G_OBJECT (jitterbuffer), "stats", &stats, NULL);
+  if (stats) {
+    gst_structure_get_uint64 (stats, "num-lost", &lost);
+    gst_structure_get_uint64 (stats, "num-late", &late);
+    gst_structure_get_uint64 (stats, "avg-jitter", &jitter);
+    gst_structure_free (stats);
+  }
+  losses = lost + late;
+  g_mutex_lock (&camera->lock);
+  previous = camera->adapt_losses;
+  camera->adapt_losses = losses;
+  g_mutex_unlock (&camera->lock);
+
+  floor = CLAMP (jitter / GST_MSECOND * LATENCY_JITTER_FACTOR + LATENCY_MARGIN, latency_min,
+      latency_max);
+  target = MAX (latency, floor);
+  if (losses > previous) {
+    camera->adapt_calm = 0;
+    target = MAX (target, (guint) (latency * LATENCY_RAISE));
+  } else if (++camera->adapt_calm >= LATENCY_CALM_PERIODS) {
+    target = MAX (floor, (guint) (latency * LATENCY_LOWER));
+  }
+  target = CLAMP (target, latency_min, latency_max);
+
+  /* The jitterbuffer posts a latency message, the pipeline then redistributes it */
+  if (target != latency) {
+    g_object_set (G_OBJECT (jitterbuffer), "latency", target, NULL);
+    /* and the next session starts from there */
+    g_object_set (G_OBJECT (camera->source), "latency", target, NULL);
+    g_atomic_int_set ((gint *) &camera->latency, target);
+    g_print ("%s: jitterbuffer latency %u ms -> %u ms (jitter %.1f ms, %" G_GUINT64_FORMAT
+        " lost or late)\n", camera->name, latency, target, (gdouble) jitter / GST_MSECOND,
+        losses - MIN (previous, losses));
+  }
+  gst_object_unref (jitterbuffer);
+}
+
+/* Sample the current fill level of every stage queue of the camera */
+void camera_sample_queues (Camera *camera)
+{
+  guint i, level;
+
+  for (i = 0; i < camera->n_queues; i++) {
+    QueueStats *stats = &camera->queues[i];
+
+    g_object_get (G_OBJECT (stats->queue), "current-level-buffers", &level, NULL);
+    g_atomic_int_set (&stats->level, level);
+    stats->samples++;
+    stats->level_sum += level;
+    stats->level_max = MAX (stats->level_max, level);
+  }
+}
+
+/* Append the statistics gathered since the previous report to the human readable @text
+ * and, as a JSON object, to @json, then reset them. A queue that is mostly full sits in
+ * front of the slowest stage, a mostly empty one behind it. */
+void camera_report_stats (Camera *camera, GString *text, GString *json)
+{
+  gint64 now = g_get_monotonic_time ();
+  gdouble seconds = (gdouble) (now - camera->report_time) / G_USEC_PER_SEC;
+  guint64 frames;
+  GstClockTimeDiff latency_sum, latency_max;
+  guint i;
+
+  g_mutex_lock (&camera->lock);
+  frames = camera->frames;
+  latency_sum = camera->latency_sum;
+  latency_max = camera->latency_max;
+  camera->frames = 0;
+  camera->latency_sum = 0;
+  camera->latency_max = 0;
+  g_mutex_unlock (&camera->lock);
+  camera->report_time = now;
+  if (seconds <= 0.0)
+    seconds = 1.0;
+
+  g_string_append_printf (text, "camera %s: %.1f fps, latency avg %.1f ms max %.1f ms, "
+      "jitterbuffer %u ms, %d reconnects, %d restarts\n", camera->name, frames / seconds,
+      frames ? (gdouble) latency_sum / frames / GST_MSECOND : 0.0,
+      (gdouble) latency_max / GST_MSECOND, g_atomic_int_get ((gint *) &camera->latency),
+      g_atomic_int_get (&camera->reconnects), g_atomic_int_get (&camera->restarts));
+  g_string_append_printf (json, "{\"camera\": \"%s\", \"fps\": %.2f, \"latency_avg_ms\": %.3f, "
+      "\"latency_max_ms\": %.3f, \"jitterbuffer_ms\": %u, \"reconnects\": %d, "
+      "\"restarts\": %d, \"stages\": [", camera->name, frames / seconds,
+      frames ? (gdouble) latency_sum / frames / GST_MSECOND : 0.0,
+      (gdouble) latency_max / GST_MSECOND, g_atomic_int_get ((gint *) &camera->latency),
+      g_atomic_int_get (&camera->reconnects), g_atomic_int_get (&camera->restarts));
+
+  for (i = 0; i < camera->timers->len; i++) {
+    StageStats stats;
+
+    stage_timer_snapshot (g_ptr_array_index (camera->timers, i), &stats);
+    g_string_append_printf (text, "  stage %-13s: %5.1f fps, p50 %7.2f p95 %7.2f p99 %7.2f "
+        "max %7.2f ms, %" G_GUINT64_FORMAT " dropped\n", stats.name, stats.frames / seconds,
+        (gdouble) stats.p50 / GST_MSECOND, (gdouble) stats.p95 / GST_MSECOND,
+        (gdouble) stats.p99 / GST_MSECOND, (gdouble) stats.max / GST_MSECOND, stats.dropped);
+    if (i > 0)
+      g_string_append (json, ", ");
+    stage_stats_append_json (&stats, json);
+  }
+  g_string_append (json, "], \"queues\": [");
+
+  for (i = 0; i < camera->n_queues; i++) {
+    QueueStats *stats = &camera->queues[i];
+    gdouble level_avg = stats->samples ? (gdouble) stats->level_sum / stats->samples : 0.0;
+    guint overruns = g_atomic_int_and ((guint *) &stats->overruns, 0);
+
+    g_string_append_printf (text, "  queue %-7s: avg %5.2f max %u of %u frames, %u overruns\n",
+        stats->name, level_avg, stats->level_max, stats->capacity, overruns);
+    g_string_append_printf (json, "%s{\"queue\": \"%s\", \"level_avg\": %.2f, "
+        "\"level_max\": %u, \"size\": %u, \"overruns\": %u}", i > 0 ? ", " : "",
+        stats->name, level_avg, stats->level_max, stats->capacity, overruns);
+    stats->samples = 0;
+    stats->level_sum = 0;
+    stats->level_max = 0;
+  }
+  g_string_append (json, "]}");
+}
+
+static gboolean camera_has_name (gconstpointer camera, gconstpointer name)
+{
+  return g_strcmp0 (((const Camera *) camera)->name, name) == 0;
+}
+
+/* Load the cameras from a key file with one group per camera:
+ *
+ *   [camera front]
+ *   location=rtsp://10.178.134.100:8554/test
+ *   latency=200
+ *   size-bands=0:20:60,0.4:40:140,0.75:90:0
+ *   detect-location=rtsp://10.178.134.100:8554/sub
+ *
+ * The group name after the "camera" prefix names the camera, no two groups may name the
+ * same one. latency is in milliseconds and optional. size-bands is optional and is best
+ * learned from a recording with "smartpole_bench calibrate". detect-location is an
+ * optional low resolution stream of the same camera that faces and plates are detected
+ * on, size-bands then being in its pixels. */
+GPtrArray *camera_load_config (const gchar *path, GError **error)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  GPtrArray *cameras = NULL;
+  gchar **groups;
+  guint i;
+
+  if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, error))
+    goto done;
+
+  cameras = g_ptr_array_new_with_free_func ((GDestroyNotify) camera_free);
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (i = 0; groups[i]; i++) {
+    const gchar *name;
+    gchar *location, *size_bands;
+    GArray *bands;
+    Camera *camera;
+    gint latency;
+    GError *err = NULL;
+
+    if (!g_str_has_prefix (groups[i], CAMERA_GROUP_PREFIX))
+      continue;
+    name = g_strstrip (groups[i] + strlen (CAMERA_GROUP_PREFIX));
+    if (*name == '\0')
+      name = groups[i];
+    /* Every camera gets a bin named after it, which must be unique in the pipeline */
+    if (g_ptr_array_find_with_equal_func (cameras, name, camera_has_name, NULL)) {
+      g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+          "[%s] another group already defines camera %s", groups[i], name);
+      g_clear_pointer (&cameras, g_ptr_array_unref);
+      break;
+    }
+
+    location = g_key_file_get_string (key_file, groups[i], "location", error);
+    if (!location) {
+      g_clear_pointer (&cameras, g_ptr_array_unref);
+      break;
+    }
+    latency = g_key_file_get_integer (key_file, groups[i], "latency", &err);
+    if (err) {
+      latency = CAMERA_DEFAULT_LATENCY;
+      g_clear_error (&err);
+    } else if (latency < 0) {
+      g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+          "[%s] latency must not be negative", groups[i]);
+      g_free (location);
+      g_clear_pointer (&cameras, g_ptr_array_unref);
+      break;
+    }
+
+    camera = camera_new (name, location, latency);
+    g_free (location);
+    g_ptr_array_add (cameras, camera);
+
+    camera->detect_location = g_key_file_get_string (key_file, groups[i], "detect-location",
+        NULL);
+    size_bands = g_key_file_get_string (key_file, groups[i], "size-bands", NULL);
+    if (size_bands) {
+      bands = size_bands_parse (size_bands, error);
+      if (!bands) {
+        g_prefix_error (error, "[%s] ", groups[i]);
+        g_free (size_bands);
+        g_clear_pointer (&cameras, g_ptr_array_unref);
+        break;
+      }
+      g_array_unref (bands);
+      camera->size_bands = size_bands;
+    }
+  }
+  g_strfreev (groups);
+
+  if (cameras && cameras->len == 0) {
+    g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+        "%s does not define any [camera ...] group", path);
+    g_clear_pointer (&cameras, g_ptr_array_unref);
+  }
+
+done:
+  g_key_file_free (key_file);
+  return cameras;
+}
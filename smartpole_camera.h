@@ -0,0 +1,172 @@
+#ifndef __SMARTPOLE_CAMERA_H__
+#define __SMARTPOLE_CAMERA_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "smartpole_restream.h"
+#include "smartpole_roi.h"
+#include "smartpole_stats.h"
+
+G_BEGIN_DECLS
+
+#define CAMERA_DEFAULT_LOCATION "rtsp://10.178.134.100:8554/test"
+#define CAMERA_DEFAULT_LATENCY 200
+
+/* Strength of the redaction of every mode, see privacyredact's properties */
+#define REDACT_BLOCK_SIZE 16
+#define REDACT_BLUR_RADIUS 12
+/* The integral blur of a face covers a quarter of its size, however close it is */
+#define REDACT_BLUR_SCALE 0.25
+
+#define N_STAGE_QUEUES 3
+/* Frames between the decoder and the sink the glass to glass mode keeps track of */
+#define GLASS_PENDING 64
+
+/* Settings shared by the branches of every camera */
+typedef struct _PipelineConfig {
+  gboolean pipelined;       /* Give decode, detection and output their own thread */
+  gint queue_size;          /* Maximum number of frames held by each stage queue */
+  gboolean async_detect;    /* Detect on a leaky side branch, redact from the latest ROIs */
+  gdouble roi_margin;       /* Fraction of a box added on every side in async mode */
+  GstClockTime roi_hold;    /* How long an async detection keeps redacting */
+  guint detect_scale;       /* Detect on the luma plane downscaled by this factor */
+  guint detect_interval;    /* Detect every Nth frame, track in between */
+  gboolean motion_gate;     /* Only detect where the frame changed */
+  gboolean parallel_detect; /* Detect on the shared pool in tiles */
+  RedactMode redact_mode;   /* How faces and plates are redacted */
+  gboolean headless;        /* No display, the frames go to @output or are dropped */
+  const gchar *output;      /* Sink bin description of the headless mode, every "%s" is
+                             * replaced by the camera name, NULL to drop the frames */
+  Restream *restream;       /* RTSP server re-streaming the redacted frames, or NULL */
+  gboolean restream_passthrough; /* @restream forwards the GOPs without detections as is */
+  gboolean glass_to_glass;  /* Read the time stamped into the frames by the test source */
+  gboolean low_latency;     /* Drop late packets and show frames as soon as they are ready */
+} PipelineConfig;
+
+/* Fill-level bookkeeping for one of the stage queues of the pipelined mode */
+typedef struct _QueueStats {
+  const gchar *name;        /* Stage fed by this queue */
+  GstElement *queue;
+  guint capacity;           /* max-size-buffers of the queue */
+  guint64 samples;          /* Number of level samples taken */
+  guint64 level_sum;        /* Sum of the sampled levels, in buffers */
+  guint level_max;          /* Highest sampled level, in buffers */
+  gint overruns;            /* Times the queue was full, bumped from the streaming thread */
+  gint overruns_total;      /* The same since the start, atomic */
+  gint level;               /* Latest sampled level, atomic */
+} QueueStats;
+
+/* One RTSP camera and the source -> decode -> detect -> sink branch it feeds */
+typedef struct _Camera {
+  gchar *name;
+  gchar *location;
+  guint latency;            /* rtspsrc jitterbuffer latency, in ms, atomic */
+  gchar *size_bands;        /* Face sizes per row band, see privacyredact's size-bands */
+  gchar *detect_location;   /* Low resolution sub-stream detected on instead, or NULL */
+
+  /* The rtspsrc and depayloader of each stream are re-created on every reconnect, the
+   * elements from the parser on are kept */
+  GstBin *bin;               /* Bin of the camera's elements, owned by the pipeline */
+  GstElement *source;
+  GstElement *detect_source; /* rtspsrc of @detect_location */
+  GstElement *depay;
+  GstElement *detect_depay;
+  GstElement *parse;
+  GstElement *detect_parse;
+  GstElement *jitterbuffer;  /* rtpjitterbuffer of the current session, under @lock */
+  GstElement *redact;        /* privacyredact */
+  GstElement *sink;
+
+  gint blur_faces;          /* Pixelate the faces, atomic */
+  gint show_faces;          /* Outline the faces, atomic */
+  gint blur_plates;         /* Detect and pixelate the number plates, atomic */
+
+  /* Asynchronous detection: the detector fills @rois, the display path redacts from them.
+   * Both sides key the ROIs by running time, which the two streams of a camera share. */
+  gboolean async_detect;
+  RedactMode redact_mode;
+  RoiStore rois;
+  RoiStore plate_rois;
+  GstSegment detect_segment; /* Segment of the detected frames */
+  gint detect_width;        /* Size of the detected frames, atomic */
+  gint detect_height;
+  GstVideoInfo redact_info; /* Format of the frames redacted on the display path */
+  GstSegment redact_segment;
+  GArray *redact_rects;     /* Scratch GstVideoRectangle array of the display path */
+  GArray *plate_rects;
+
+  QueueStats queues[N_STAGE_QUEUES];
+  guint n_queues;
+  gint queue_size;
+  GPtrArray *timers;        /* StageTimer of every timed stage, upstream first */
+  StageTimer *redact_timer; /* Redaction of the display path in async mode, in @timers */
+
+  /* RTP packets out of the jitterbuffer since the start, atomic */
+  gint rtp_seq;             /* Sequence number of the last one, -1 before the first */
+  gsize rtp_packets;
+  gsize rtp_lost;           /* Gaps in the sequence numbers */
+
+  /* Glass to glass mode: when each frame entered the decoder, to split the latency read
+   * from its stamp at the sink between the network and the pipeline */
+  GMutex glass_lock;
+  GstClockTime glass_pts[GLASS_PENDING];
+  gint64 glass_time[GLASS_PENDING]; /* Monotonic time, in us */
+  guint glass_next;
+  GstVideoInfo glass_info;  /* Format of the frames at the sink */
+  StageTimer *glass_timer;  /* Stamp to display */
+  StageTimer *glass_network_timer; /* Stamp to the decoder */
+  StageTimer *render_timer; /* Sink pad to display, the wait for the frame's render time */
+
+  /* Reconnecting and restarting, see camera_handle_error() */
+  gboolean low_latency;
+  guint reconnect_id;       /* Pending reconnect, 0 if none */
+  guint reconnect_inputs;   /* Streams it re-creates, CAMERA_INPUT_* */
+  guint reconnect_delay;    /* In ms, doubled by every reconnect that shows no frame */
+  guint restart_id;         /* Pending restart of @bin, 0 if none */
+  guint restart_delay;      /* In ms, doubled by every restart that shows no frame */
+  gint64 reconnect_start;   /* Monotonic time of the last reconnect of the main stream or
+                             * restart, 0 once a frame reached the sink, under @lock */
+  gint reconnects;          /* Reconnects since the start, atomic */
+  gint restarts;            /* Restarts since the start, atomic */
+  gint finishing;           /* Let the EOS of camera_finish() through, atomic */
+  gsize last_packet;        /* Monotonic time of the last RTP packet, in us, atomic */
+  StageTimer *network_timer; /* Capture to the depayloader of each stream, in @timers */
+  StageTimer *sub_network_timer;
+  StageTimer *reconnect_timer; /* Reconnect or restart to the first redacted frame, in
+                                * @timers */
+
+  /* Adaptive latency, see camera_adapt_latency() */
+  guint64 adapt_losses;     /* Packets lost or late seen in the previous period */
+  guint adapt_calm;         /* Periods in a row without any */
+
+  /* Frame statistics, written from the sink streaming thread */
+  GMutex lock;
+  GstSegment segment;       /* Last segment seen on the sink pad */
+  guint64 frames;           /* Frames that reached the sink since the last report */
+  GstClockTimeDiff latency_sum;
+  GstClockTimeDiff latency_max;
+  gint64 report_time;       /* Monotonic time of the last report, in us */
+} Camera;
+
+Camera *camera_new (const gchar *name, const gchar *location, guint latency);
+void camera_free (Camera *camera);
+
+gboolean camera_build (Camera *camera, GstBin *pipeline, const PipelineConfig *config);
+void camera_set_blur_faces (Camera *camera, gboolean blur_faces);
+void camera_set_show_faces (Camera *camera, gboolean show_faces);
+void camera_set_blur_plates (Camera *camera, gboolean blur_plates);
+void camera_set_window_handle (Camera *camera, guintptr handle);
+
+gboolean camera_handle_error (Camera *camera, GstMessage *msg);
+void camera_check_stall (Camera *camera);
+void camera_finish (Camera *camera);
+void camera_adapt_latency (Camera *camera, guint latency_min, guint latency_max);
+void camera_sample_queues (Camera *camera);
+void camera_report_stats (Camera *camera, GString *text, GString *json);
+
+GPtrArray *camera_load_config (const gchar *path, GError **error);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_CAMERA_H__ */
@@ -0,0 +1,137 @@
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+
+#include "smartpole_detector.h"
+#include "smartpole_kernels.h"
+
+struct _Detector {
+  cv::CascadeClassifier cascade;
+  std::vector<guint8> proxy;    /* Downscaled image of detector_detect_scaled() */
+};
+
+Detector *detector_new (const gchar *cascade_path, GError **error)
+{
+  Detector *detector = new Detector ();
+
+  if (!detector->cascade.load (cascade_path)) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+        "Could not load cascade classifier %s", cascade_path);
+    delete detector;
+    return NULL;
+  }
+
+  return detector;
+}
+
+void detector_free (Detector *detector)
+{
+  delete detector;
+}
+
+/* Number of threads OpenCV spreads one detection over, process-wide. 0 runs every
+ * detection on the calling thread, for callers doing their own threading. */
+void detector_set_num_threads (gint n_threads)
+{
+  cv::setNumThreads (n_threads);
+}
+
+/* Run the cascade over the @width x @height grayscale image at @gray, without copying it,
+ * and replace the content of @rects with the GstVideoRectangle of every detection.
+ * Returns the number of detections. */
+guint detector_detect (Detector *detector, const guint8 *gray, gint width, gint height,
+    gint stride, const DetectorParams *params, GArray *rects)
+{
+  cv::Mat image (height, width, CV_8UC1, (void *) gray, stride);
+  std::vector<cv::Rect> objects;
+
+  g_array_set_size (rects, 0);
+  try {
+    detector->cascade.detectMultiScale (image, objects, params->scale_factor,
+        params->min_neighbors, 0, cv::Size (params->min_width, params->min_height),
+        cv::Size (params->max_width, params->max_height));
+  } catch (const cv::Exception &e) {
+    g_warning ("Cascade detection failed: %s", e.what ());
+    return 0;
+  }
+
+  for (const cv::Rect &r : objects) {
+    GstVideoRectangle rect = { r.x, r.y, r.width, r.height };
+
+    g_array_append_val (rects, rect);
+  }
+
+  return rects->len;
+}
+
+/* Run the cascade over @area of the frame, given in frame pixels, on the possibly
+ * downscaled @plane of it and replace the content of @rects with the boxes mapped back to
+ * the frame. When the plane is downscaled the boxes are widened on every side by @padding
+ * times their size to make up for the lost precision. The object sizes of @params are
+ * frame pixels. */
+guint detector_detect_plane (Detector *detector, const LumaPlane *plane,
+    const GstVideoRectangle *area, gdouble padding, const DetectorParams *params, GArray *rects)
+{
+  DetectorParams plane_params = *params;
+  gint scale = plane->scale;
+  gint x = area->x / scale, y = area->y / scale;
+  gint width = MIN (plane->width, (area->x + area->w) / scale) - x;
+  gint height = MIN (plane->height, (area->y + area->h) / scale) - y;
+  guint i;
+
+  g_array_set_size (rects, 0);
+  if (width <= 0 || height <= 0)
+    return 0;
+
+  if (scale > 1) {
+    plane_params.min_width = MAX (1, params->min_width / scale);
+    plane_params.min_height = MAX (1, params->min_height / scale);
+    plane_params.max_width = params->max_width / scale;
+    plane_params.max_height = params->max_height / scale;
+  }
+  detector_detect (detector, plane->data + y * plane->stride + x, width, height, plane->stride,
+      &plane_params, rects);
+
+  for (i = 0; i < rects->len; i++) {
+    GstVideoRectangle *rect = &g_array_index (rects, GstVideoRectangle, i);
+    gint pad_x = scale > 1 ? (gint) (rect->w * scale * padding) : 0;
+    gint pad_y = scale > 1 ? (gint) (rect->h * scale * padding) : 0;
+    gint x0 = MAX (0, (x + rect->x) * scale - pad_x);
+    gint y0 = MAX (0, (y + rect->y) * scale - pad_y);
+    gint x1 = MIN (plane->frame_width, (x + rect->x + rect->w) * scale + pad_x);
+    gint y1 = MIN (plane->frame_height, (y + rect->y + rect->h) * scale + pad_y);
+
+    rect->x = x0;
+    rect->y = y0;
+    rect->w = x1 - x0;
+    rect->h = y1 - y0;
+  }
+
+  return rects->len;
+}
+
+/* Run the cascade on a copy of the grayscale image shrunk by the integer @scale, see
+ * detector_detect_plane() */
+guint detector_detect_scaled (Detector *detector, const guint8 *gray, gint width, gint height,
+    gint stride, guint scale, gdouble padding, const DetectorParams *params, GArray *rects)
+{
+  GstVideoRectangle whole = { 0, 0, width, height };
+  LumaPlane plane;
+
+  if (scale <= 1)
+    return detector_detect (detector, gray, width, height, stride, params, rects);
+
+  detector->proxy.resize ((gsize) (width / scale) * (height / scale));
+  kernel_downscale_luma (gray, stride, width, height, scale, detector->proxy.data (),
+      width / scale);
+
+  plane.data = detector->proxy.data ();
+  plane.width = width / scale;
+  plane.height = height / scale;
+  plane.stride = plane.width;
+  plane.scale = scale;
+  plane.frame_width = width;
+  plane.frame_height = height;
+  return detector_detect_plane (detector, &plane, &whole, padding, params, rects);
+}
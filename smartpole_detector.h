@@ -0,0 +1,37 @@
+#ifndef __SMARTPOLE_DETECTOR_H__
+#define __SMARTPOLE_DETECTOR_H__
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+#include "smartpole_pyramid.h"
+
+G_BEGIN_DECLS
+
+/* A Haar/LBP cascade classifier working on 8 bit grayscale images. A detector must not
+ * be used from two threads at the same time. */
+typedef struct _Detector Detector;
+
+typedef struct _DetectorParams {
+  gdouble scale_factor;     /* Scale step between two pyramid levels, > 1 */
+  gint min_neighbors;       /* Overlapping hits needed to keep a detection */
+  gint min_width;           /* Smallest object searched for, in pixels */
+  gint min_height;
+  gint max_width;           /* Largest object searched for, 0 for no limit */
+  gint max_height;
+} DetectorParams;
+
+Detector *detector_new (const gchar *cascade_path, GError **error);
+void detector_free (Detector *detector);
+void detector_set_num_threads (gint n_threads);
+
+guint detector_detect (Detector *detector, const guint8 *gray, gint width, gint height,
+    gint stride, const DetectorParams *params, GArray *rects);
+guint detector_detect_plane (Detector *detector, const LumaPlane *plane,
+    const GstVideoRectangle *area, gdouble padding, const DetectorParams *params, GArray *rects);
+guint detector_detect_scaled (Detector *detector, const guint8 *gray, gint width, gint height,
+    gint stride, guint scale, gdouble padding, const DetectorParams *params, GArray *rects);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_DETECTOR_H__ */
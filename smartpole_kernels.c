@@ -0,0 +1,776 @@
+#include <string.h>
+
+#include "smartpole_kernels.h"
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* AVX2 code is built with a per-function target and only run when the processor has it */
+#if defined (__GNUC__) && defined (__SSE2__)
+#define HAVE_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+/* Halve both dimensions, averaging each 2x2 block as the average of its two row averages.
+ * The rounding is the one of the SSE2 path, so both produce the same image. */
+static void downscale_2x_scalar (const guint8 *src, gint src_stride, gint dst_width,
+    gint dst_height, guint8 *dst, gint dst_stride, gint x_start)
+{
+  gint x, y;
+
+  for (y = 0; y < dst_height; y++) {
+    const guint8 *row0 = src + 2 * y * src_stride;
+    const guint8 *row1 = row0 + src_stride;
+    guint8 *out = dst + y * dst_stride;
+
+    for (x = x_start; x < dst_width; x++) {
+      guint left = (row0[2 * x] + row1[2 * x] + 1) >> 1;
+      guint right = (row0[2 * x + 1] + row1[2 * x + 1] + 1) >> 1;
+
+      out[x] = (left + right + 1) >> 1;
+    }
+  }
+}
+
+#if defined (__SSE2__)
+static void downscale_2x_sse2 (const guint8 *src, gint src_stride, gint dst_width,
+    gint dst_height, guint8 *dst, gint dst_stride)
+{
+  const __m128i low_bytes = _mm_set1_epi16 (0x00ff);
+  const __m128i one = _mm_set1_epi16 (1);
+  gint x, y, simd_width = dst_width & ~7;
+
+  for (y = 0; y < dst_height; y++) {
+    const guint8 *row0 = src + 2 * y * src_stride;
+    const guint8 *row1 = row0 + src_stride;
+    guint8 *out = dst + y * dst_stride;
+
+    /* 16 source columns give 8 output pixels */
+    for (x = 0; x < simd_width; x += 8) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (row0 + 2 * x));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (row1 + 2 * x));
+      __m128i v = _mm_avg_epu8 (a, b);
+      __m128i even = _mm_and_si128 (v, low_bytes);
+      __m128i odd = _mm_srli_epi16 (v, 8);
+      __m128i avg = _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (even, odd), one), 1);
+
+      _mm_storel_epi64 ((__m128i *) (out + x), _mm_packus_epi16 (avg, avg));
+    }
+  }
+  downscale_2x_scalar (src, src_stride, dst_width, dst_height, dst, dst_stride, simd_width);
+}
+#endif
+
+/* Box filter over @factor x @factor blocks for the other integer factors. The inner loop
+ * only has fixed-width additions, which the compiler vectorizes. */
+static void downscale_nx (const guint8 *src, gint src_stride, gint dst_width,
+    gint dst_height, guint factor, guint8 *dst, gint dst_stride)
+{
+  guint16 sums[dst_width];
+  guint area = factor * factor, i;
+  gint x, y;
+
+  for (y = 0; y < dst_height; y++) {
+    guint8 *out = dst + y * dst_stride;
+
+    memset (sums, 0, sizeof (sums));
+    for (i = 0; i < factor; i++) {
+      const guint8 *row = src + (y * factor + i) * src_stride;
+      guint j;
+
+      for (x = 0; x < dst_width; x++)
+        for (j = 0; j < factor; j++)
+          sums[x] += row[x * factor + j];
+    }
+    for (x = 0; x < dst_width; x++)
+      out[x] = (sums[x] + area / 2) / area;
+  }
+}
+
+/* Shrink the @width x @height luma plane at @src by the integer @factor into @dst, which
+ * must hold @width / @factor x @height / @factor pixels. Trailing columns and rows that
+ * do not fill a whole block are dropped. */
+void kernel_downscale_luma (const guint8 *src, gint src_stride, gint width, gint height,
+    guint factor, guint8 *dst, gint dst_stride)
+{
+  gint dst_width = width / factor;
+  gint dst_height = height / factor;
+
+  /* A plane smaller than one block has nothing to shrink, and downscale_nx() cannot
+   * size its row of sums to zero columns */
+  if (dst_width <= 0 || dst_height <= 0)
+    return;
+
+  if (factor == 1) {
+    gint y;
+
+    for (y = 0; y < height; y++)
+      memcpy (dst + y * dst_stride, src + y * src_stride, width);
+  } else if (factor == 2) {
+#if defined (__SSE2__)
+    downscale_2x_sse2 (src, src_stride, dst_width, dst_height, dst, dst_stride);
+#else
+    downscale_2x_scalar (src, src_stride, dst_width, dst_height, dst, dst_stride, 0);
+#endif
+  } else {
+    downscale_nx (src, src_stride, dst_width, dst_height, factor, dst, dst_stride);
+  }
+}
+
+/* Sum of absolute differences between two @width x @height blocks */
+guint kernel_sad (const guint8 *a, gint a_stride, const guint8 *b, gint b_stride,
+    gint width, gint height)
+{
+  guint sad = 0;
+  gint x, y, simd_width = 0;
+
+#if defined (__SSE2__)
+  simd_width = width & ~15;
+  for (y = 0; y < height; y++) {
+    const guint8 *ra = a + y * a_stride;
+    const guint8 *rb = b + y * b_stride;
+    __m128i acc = _mm_setzero_si128 ();
+
+    for (x = 0; x < simd_width; x += 16)
+      acc = _mm_add_epi64 (acc, _mm_sad_epu8 (_mm_loadu_si128 ((const __m128i *) (ra + x)),
+              _mm_loadu_si128 ((const __m128i *) (rb + x))));
+    sad += _mm_cvtsi128_si32 (acc) + _mm_cvtsi128_si32 (_mm_srli_si128 (acc, 8));
+  }
+#endif
+
+  for (y = 0; y < height; y++) {
+    const guint8 *ra = a + y * a_stride;
+    const guint8 *rb = b + y * b_stride;
+
+    for (x = simd_width; x < width; x++)
+      sad += ABS (ra[x] - rb[x]);
+  }
+
+  return sad;
+}
+
+/* Intersection area of the box (@bx0, @by0)-(@bx1, @by1) with each of the @n boxes given
+ * as separate arrays of corners, 4 boxes per step with SSE2 */
+void kernel_box_intersections (const gfloat *x0, const gfloat *y0, const gfloat *x1,
+    const gfloat *y1, guint n, gfloat bx0, gfloat by0, gfloat bx1, gfloat by1, gfloat *inter)
+{
+  guint i = 0;
+
+#if defined (__SSE2__)
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 vx0 = _mm_set1_ps (bx0), vy0 = _mm_set1_ps (by0);
+  const __m128 vx1 = _mm_set1_ps (bx1), vy1 = _mm_set1_ps (by1);
+
+  for (; i + 4 <= n; i += 4) {
+    __m128 w = _mm_sub_ps (_mm_min_ps (vx1, _mm_loadu_ps (x1 + i)),
+        _mm_max_ps (vx0, _mm_loadu_ps (x0 + i)));
+    __m128 h = _mm_sub_ps (_mm_min_ps (vy1, _mm_loadu_ps (y1 + i)),
+        _mm_max_ps (vy0, _mm_loadu_ps (y0 + i)));
+
+    _mm_storeu_ps (inter + i, _mm_mul_ps (_mm_max_ps (w, zero), _mm_max_ps (h, zero)));
+  }
+#endif
+
+  for (; i < n; i++) {
+    gfloat w = MIN (bx1, x1[i]) - MAX (bx0, x0[i]);
+    gfloat h = MIN (by1, y1[i]) - MAX (by0, y0[i]);
+
+    inter[i] = MAX (w, 0.0f) * MAX (h, 0.0f);
+  }
+}
+
+/* Mark with 1 the pixels whose horizontal (@vertical_edges) or vertical central
+ * difference is at least @threshold, 0 elsewhere. The border pixels without both
+ * neighbours are 0. */
+void kernel_edge_map (const guint8 *src, gint src_stride, gint width, gint height,
+    guint8 threshold, gboolean vertical_edges, guint8 *dst, gint dst_stride)
+{
+  gint dx = vertical_edges ? 1 : 0, dy = vertical_edges ? 0 : 1;
+  gint x, y;
+
+  for (y = 0; y < height; y++) {
+    const guint8 *row = src + y * src_stride;
+    guint8 *out = dst + y * dst_stride;
+    gint x_start = dx, x_end = width - dx;
+
+    memset (out, 0, width);
+    if (y < dy || y >= height - dy || threshold == 0)
+      continue;
+
+    x = x_start;
+#if defined (__SSE2__)
+    {
+      const __m128i bias = _mm_set1_epi8 ((gchar) (threshold - 1));
+      const __m128i zero = _mm_setzero_si128 ();
+      const __m128i one = _mm_set1_epi8 (1);
+
+      for (; x + 16 <= x_end; x += 16) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (row + x - dx - dy * src_stride));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (row + x + dx + dy * src_stride));
+        __m128i diff = _mm_or_si128 (_mm_subs_epu8 (a, b), _mm_subs_epu8 (b, a));
+        __m128i below = _mm_cmpeq_epi8 (_mm_subs_epu8 (diff, bias), zero);
+
+        _mm_storeu_si128 ((__m128i *) (out + x), _mm_andnot_si128 (below, one));
+      }
+    }
+#endif
+    for (; x < x_end; x++)
+      out[x] = ABS (row[x + dx + dy * src_stride] - row[x - dx - dy * src_stride]) >= threshold;
+  }
+}
+
+/* Redaction kernels. The inner loops exist in a scalar, an SSE2 and an AVX2 version,
+ * picked at run time from what the processor supports. All versions compute the same
+ * integers, so their output is identical. */
+
+typedef struct _RedactOps {
+  /* @sums += @row over @n bytes */
+  void (*accumulate) (guint16 *sums, const guint8 *row, gint n);
+  /* Sum of the 2 * @radius + 1 bytes @channels apart starting at each of the @n bytes of
+   * @pad, normalized */
+  void (*box_row) (const guint8 *pad, gint n, gint channels, gint radius, guint16 half,
+      guint16 mul, guint8 *out);
+  /* Normalize @sums into @out, then slide the window: @sums += @add - @sub */
+  void (*box_step) (guint16 *sums, const guint8 *add, const guint8 *sub, gint n,
+      guint16 half, guint16 mul, guint8 *out);
+} RedactOps;
+
+/* Mean of a window of n bytes from its sum: (sum + n / 2) * ceil (65536 / n) >> 16, which
+ * the SIMD paths get from a single high multiply */
+static inline guint8 box_normalize (guint sum, guint16 half, guint16 mul)
+{
+  return MIN (255, ((sum + half) * mul) >> 16);
+}
+
+static void accumulate_scalar (guint16 *sums, const guint8 *row, gint n)
+{
+  gint i;
+
+  for (i = 0; i < n; i++)
+    sums[i] += row[i];
+}
+
+static void box_row_scalar (const guint8 *pad, gint n, gint channels, gint radius,
+    guint16 half, guint16 mul, guint8 *out)
+{
+  gint i, k, window = 2 * radius + 1;
+
+  /* A running sum per interleaved channel */
+  for (k = 0; k < channels && k < n; k++) {
+    guint sum = 0;
+
+    for (i = 0; i < window; i++)
+      sum += pad[k + i * channels];
+    for (i = k; i < n; i += channels) {
+      out[i] = box_normalize (sum, half, mul);
+      if (i + channels < n)
+        sum += pad[i + window * channels] - pad[i];
+    }
+  }
+}
+
+static void box_step_scalar (guint16 *sums, const guint8 *add, const guint8 *sub, gint n,
+    guint16 half, guint16 mul, guint8 *out)
+{
+  gint i;
+
+  for (i = 0; i < n; i++) {
+    out[i] = box_normalize (sums[i], half, mul);
+    sums[i] += add[i] - sub[i];
+  }
+}
+
+static const RedactOps redact_ops_scalar = {
+  accumulate_scalar, box_row_scalar, box_step_scalar
+};
+
+#if defined (__SSE2__)
+static void accumulate_sse2 (guint16 *sums, const guint8 *row, gint n)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  gint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (row + i));
+    __m128i *s = (__m128i *) (sums + i);
+
+    _mm_storeu_si128 (s, _mm_add_epi16 (_mm_loadu_si128 (s), _mm_unpacklo_epi8 (v, zero)));
+    _mm_storeu_si128 (s + 1, _mm_add_epi16 (_mm_loadu_si128 (s + 1),
+            _mm_unpackhi_epi8 (v, zero)));
+  }
+  accumulate_scalar (sums + i, row + i, n - i);
+}
+
+static inline __m128i box_normalize_sse2 (__m128i lo, __m128i hi, __m128i half, __m128i mul)
+{
+  lo = _mm_mulhi_epu16 (_mm_add_epi16 (lo, half), mul);
+  hi = _mm_mulhi_epu16 (_mm_add_epi16 (hi, half), mul);
+  return _mm_packus_epi16 (lo, hi);
+}
+
+/* Sliding sum across a row, 8 bytes per step. Each step adds to the previous sums the
+ * prefix sums, per channel, of what enters minus what leaves the window. */
+static void box_row_sse2 (const guint8 *pad, gint n, gint channels, gint radius,
+    guint16 half, guint16 mul, guint8 *out)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i vhalf = _mm_set1_epi16 (half), vmul = _mm_set1_epi16 (mul);
+  gint i, k, t, window = 2 * radius + 1, lead = window * channels;
+  __m128i sum, v;
+  guint16 first[8];
+
+  if (n < 8 || (channels != 1 && channels != 2 && channels != 4)) {
+    box_row_scalar (pad, n, channels, radius, half, mul, out);
+    return;
+  }
+
+  /* Only the first window of each channel is summed in full */
+  for (k = 0; k < 8; k++) {
+    if (k < channels) {
+      first[k] = 0;
+      for (t = 0; t < window; t++)
+        first[k] += pad[k + t * channels];
+    } else {
+      first[k] = first[k - channels] + pad[k - channels + lead] - pad[k - channels];
+    }
+  }
+  sum = _mm_loadu_si128 ((const __m128i *) first);
+  v = _mm_mulhi_epu16 (_mm_add_epi16 (sum, vhalf), vmul);
+  _mm_storel_epi64 ((__m128i *) out, _mm_packus_epi16 (v, v));
+
+  for (i = 8; i + 8 <= n; i += 8) {
+    __m128i in = _mm_loadl_epi64 ((const __m128i *) (pad + i - channels + lead));
+    __m128i away = _mm_loadl_epi64 ((const __m128i *) (pad + i - channels));
+    __m128i delta = _mm_sub_epi16 (_mm_unpacklo_epi8 (in, zero), _mm_unpacklo_epi8 (away, zero));
+    __m128i carry;
+
+    /* The sums wrap around in 16 bits on the way but always end in 0..65535 */
+    switch (channels) {
+      case 1:
+        delta = _mm_add_epi16 (delta, _mm_slli_si128 (delta, 2));
+        delta = _mm_add_epi16 (delta, _mm_slli_si128 (delta, 4));
+        delta = _mm_add_epi16 (delta, _mm_slli_si128 (delta, 8));
+        carry = _mm_set1_epi16 (_mm_extract_epi16 (sum, 7));
+        break;
+      case 2:
+        delta = _mm_add_epi16 (delta, _mm_slli_si128 (delta, 4));
+        delta = _mm_add_epi16 (delta, _mm_slli_si128 (delta, 8));
+        carry = _mm_shuffle_epi32 (sum, 0xff);
+        break;
+      default:
+        delta = _mm_add_epi16 (delta, _mm_slli_si128 (delta, 8));
+        carry = _mm_unpackhi_epi64 (sum, sum);
+        break;
+    }
+    sum = _mm_add_epi16 (carry, delta);
+    v = _mm_mulhi_epu16 (_mm_add_epi16 (sum, vhalf), vmul);
+    _mm_storel_epi64 ((__m128i *) (out + i), _mm_packus_epi16 (v, v));
+  }
+  for (; i < n; i++) {
+    guint total = 0;
+
+    for (t = 0; t < window; t++)
+      total += pad[i + t * channels];
+    out[i] = box_normalize (total, half, mul);
+  }
+}
+
+static void box_step_sse2 (guint16 *sums, const guint8 *add, const guint8 *sub, gint n,
+    guint16 half, guint16 mul, guint8 *out)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i vhalf = _mm_set1_epi16 (half), vmul = _mm_set1_epi16 (mul);
+  gint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m128i *s = (__m128i *) (sums + i);
+    __m128i lo = _mm_loadu_si128 (s), hi = _mm_loadu_si128 (s + 1);
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (add + i));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (sub + i));
+
+    _mm_storeu_si128 ((__m128i *) (out + i), box_normalize_sse2 (lo, hi, vhalf, vmul));
+    lo = _mm_sub_epi16 (_mm_add_epi16 (lo, _mm_unpacklo_epi8 (a, zero)),
+        _mm_unpacklo_epi8 (b, zero));
+    hi = _mm_sub_epi16 (_mm_add_epi16 (hi, _mm_unpackhi_epi8 (a, zero)),
+        _mm_unpackhi_epi8 (b, zero));
+    _mm_storeu_si128 (s, lo);
+    _mm_storeu_si128 (s + 1, hi);
+  }
+  box_step_scalar (sums + i, add + i, sub + i, n - i, half, mul, out + i);
+}
+
+static const RedactOps redact_ops_sse2 = {
+  accumulate_sse2, box_row_sse2, box_step_sse2
+};
+#endif
+
+#if defined (HAVE_AVX2_DISPATCH)
+/* Compiled for AVX2 whatever the target of the file, only called after checking the
+ * processor supports it. 16 bytes are widened to one vector of 16 words per step. */
+__attribute__ ((target ("avx2")))
+static void accumulate_avx2 (guint16 *sums, const guint8 *row, gint n)
+{
+  gint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m256i v = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (row + i)));
+    __m256i *s = (__m256i *) (sums + i);
+
+    _mm256_storeu_si256 (s, _mm256_add_epi16 (_mm256_loadu_si256 (s), v));
+  }
+  accumulate_scalar (sums + i, row + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m128i box_normalize_avx2 (__m256i sum, __m256i half, __m256i mul)
+{
+  __m256i v = _mm256_mulhi_epu16 (_mm256_add_epi16 (sum, half), mul);
+
+  return _mm_packus_epi16 (_mm256_castsi256_si128 (v), _mm256_extracti128_si256 (v, 1));
+}
+
+__attribute__ ((target ("avx2")))
+static void box_step_avx2 (guint16 *sums, const guint8 *add, const guint8 *sub, gint n,
+    guint16 half, guint16 mul, guint8 *out)
+{
+  const __m256i vhalf = _mm256_set1_epi16 (half), vmul = _mm256_set1_epi16 (mul);
+  gint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m256i *s = (__m256i *) (sums + i);
+    __m256i sum = _mm256_loadu_si256 (s);
+    __m256i a = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (add + i)));
+    __m256i b = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) (sub + i)));
+
+    _mm_storeu_si128 ((__m128i *) (out + i), box_normalize_avx2 (sum, vhalf, vmul));
+    _mm256_storeu_si256 (s, _mm256_sub_epi16 (_mm256_add_epi16 (sum, a), b));
+  }
+  box_step_scalar (sums + i, add + i, sub + i, n - i, half, mul, out + i);
+}
+
+/* The sliding row sum is a chain of dependent steps that wider vectors do not speed up */
+static const RedactOps redact_ops_avx2 = {
+  accumulate_avx2, box_row_sse2, box_step_avx2
+};
+#endif
+
+static const RedactOps *redact_ops;
+static KernelIsa redact_isa;
+
+static const RedactOps *redact_ops_for_isa (KernelIsa isa)
+{
+  switch (isa) {
+#if defined (HAVE_AVX2_DISPATCH)
+    case KERNEL_ISA_AVX2:
+      return __builtin_cpu_supports ("avx2") ? &redact_ops_avx2 : NULL;
+#endif
+#if defined (__SSE2__)
+    case KERNEL_ISA_SSE2:
+      return &redact_ops_sse2;
+#endif
+    case KERNEL_ISA_SCALAR:
+      return &redact_ops_scalar;
+    default:
+      return NULL;
+  }
+}
+
+static const RedactOps *get_redact_ops (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    KernelIsa isa = KERNEL_ISA_AVX2;
+
+    while (!redact_ops_for_isa (isa))
+      isa--;
+    redact_isa = isa;
+    redact_ops = redact_ops_for_isa (isa);
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return redact_ops;
+}
+
+/* The instruction set the redaction kernels use, the best one the processor has unless
+ * kernel_set_isa() picked another */
+KernelIsa kernel_get_isa (void)
+{
+  get_redact_ops ();
+  return redact_isa;
+}
+
+/* Make the redaction kernels use @isa, for benchmarks and checks. Not thread safe, call it
+ * before any kernel runs. Returns FALSE if the build or the processor lacks @isa. */
+gboolean kernel_set_isa (KernelIsa isa)
+{
+  const RedactOps *ops = redact_ops_for_isa (isa);
+
+  get_redact_ops ();
+  if (!ops)
+    return FALSE;
+  redact_ops = ops;
+  redact_isa = isa;
+  return TRUE;
+}
+
+const gchar *kernel_isa_name (KernelIsa isa)
+{
+  static const gchar *names[] = { "scalar", "sse2", "avx2" };
+
+  return (guint) isa < G_N_ELEMENTS (names) ? names[isa] : "unknown";
+}
+
+/* Bytes of scratch kernel_pixelate(), kernel_box_blur() and kernel_integral_blur() need
+ * for a @width x @height region of @channels interleaved bytes per pixel */
+gsize kernel_redact_scratch_size (gint width, gint height, gint channels)
+{
+  gsize row = (gsize) width * channels;
+  gsize separable = row * height + 2 * (row + 2 * KERNEL_MAX_BLUR_RADIUS * channels) + 2 * row;
+  gsize integral = (gsize) (width + 1) * (height + 1) * channels * sizeof (guint32) +
+      (gsize) width * channels * sizeof (gfloat);
+
+  return MAX (separable, integral) + 32;
+}
+
+/* Replace every @block_w x @block_h block of the @width x @height region at @data by its
+ * average, per interleaved channel. Blocks on the right and bottom edges may be
+ * smaller. */
+void kernel_pixelate (guint8 *data, gint stride, gint channels, gint width, gint height,
+    gint block_w, gint block_h, guint8 *scratch)
+{
+  const RedactOps *ops = get_redact_ops ();
+  gint row = width * channels;
+  guint16 *sums = (guint16 *) GSIZE_TO_POINTER (((gsize) scratch + 15) & ~(gsize) 15);
+  guint8 *pattern = (guint8 *) (sums + row);
+  gint bx, by, x, y, k;
+
+  for (by = 0; by < height; by += block_h) {
+    gint bh = MIN (block_h, height - by);
+
+    /* Column sums over the rows of the band, then one average per block and channel */
+    memset (sums, 0, row * sizeof (guint16));
+    for (y = by; y < by + bh; y++)
+      ops->accumulate (sums, data + y * stride, row);
+
+    for (bx = 0; bx < width; bx += block_w) {
+      gint bw = MIN (block_w, width - bx);
+
+      for (k = 0; k < channels; k++) {
+        guint sum = 0;
+        guint8 avg;
+
+        for (x = bx; x < bx + bw; x++)
+          sum += sums[x * channels + k];
+        avg = sum / (bw * bh);
+        for (x = bx; x < bx + bw; x++)
+          pattern[x * channels + k] = avg;
+      }
+    }
+    for (y = by; y < by + bh; y++)
+      memcpy (data + y * stride, pattern, row);
+  }
+}
+
+/* Blur the @width x @height region at @data in place with a box of 2 * @radius + 1
+ * pixels, horizontally then vertically, per interleaved channel. Pixels outside the
+ * region are never read, the region edges are repeated instead. @radius is at most
+ * KERNEL_MAX_BLUR_RADIUS. */
+void kernel_box_blur (guint8 *data, gint stride, gint channels, gint width, gint height,
+    gint radius, guint8 *scratch)
+{
+  const RedactOps *ops = get_redact_ops ();
+  gint row = width * channels, window, x, y, k;
+  guint16 half, mul;
+  guint16 *sums = (guint16 *) GSIZE_TO_POINTER (((gsize) scratch + 15) & ~(gsize) 15);
+  guint8 *pad = (guint8 *) (sums + row);
+  guint8 *tmp = pad + row + 2 * KERNEL_MAX_BLUR_RADIUS * channels;
+
+  radius = MIN (radius, KERNEL_MAX_BLUR_RADIUS);
+  if (radius <= 0 || width <= 0 || height <= 0)
+    return;
+  window = 2 * radius + 1;
+  half = window / 2;
+  mul = (65536 + window - 1) / window;
+
+  /* Horizontal pass into @tmp, through a copy of the row with its edges repeated */
+  for (y = 0; y < height; y++) {
+    const guint8 *src = data + y * stride;
+
+    for (x = 0; x < radius; x++) {
+      for (k = 0; k < channels; k++) {
+        pad[x * channels + k] = src[k];
+        pad[(radius + width + x) * channels + k] = src[row - channels + k];
+      }
+    }
+    memcpy (pad + radius * channels, src, row);
+    ops->box_row (pad, row, channels, radius, half, mul, tmp + y * row);
+  }
+
+  /* Vertical pass back into the region, sliding a sum per column */
+  memset (sums, 0, row * sizeof (guint16));
+  for (y = -radius; y <= radius; y++)
+    ops->accumulate (sums, tmp + CLAMP (y, 0, height - 1) * row, row);
+  for (y = 0; y < height; y++)
+    ops->box_step (sums, tmp + MIN (y + radius + 1, height - 1) * row,
+        tmp + MAX (y - radius, 0) * row, row, half, mul, data + y * stride);
+}
+
+/* Write @n bytes of a row of kernel_integral_blur(). The box of byte j ends at the table
+ * columns @bottom_r + j and @top_r + j and starts after @bottom_l + j and @top_l + j. A
+ * step of 0 instead repeats the first 4 values of those, for the boxes clipped by an
+ * edge of the region. */
+static void integral_blur_span (const guint32 *bottom_r, const guint32 *top_r, gint step_r,
+    const guint32 *bottom_l, const guint32 *top_l, gint step_l, const gfloat *scale,
+    gfloat row_scale, gint n, guint8 *out)
+{
+  gint j = 0;
+
+  /* The sums stay below 2^31 and convert to float as signed integers */
+#if defined (__SSE2__)
+  const __m128 vrow = _mm_set1_ps (row_scale), vhalf = _mm_set1_ps (0.5f);
+
+  for (; j + 16 <= n; j += 16) {
+    __m128i v[4];
+    gint k;
+
+    for (k = 0; k < 4; k++) {
+      gint o = j + 4 * k;
+      __m128i right = _mm_sub_epi32 (_mm_loadu_si128 ((const __m128i *) (bottom_r + o * step_r)),
+          _mm_loadu_si128 ((const __m128i *) (top_r + o * step_r)));
+      __m128i left = _mm_sub_epi32 (_mm_loadu_si128 ((const __m128i *) (bottom_l + o * step_l)),
+          _mm_loadu_si128 ((const __m128i *) (top_l + o * step_l)));
+      __m128 box_scale = _mm_mul_ps (_mm_loadu_ps (scale + o), vrow);
+
+      v[k] = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (_mm_cvtepi32_ps (_mm_sub_epi32 (right,
+                      left)), box_scale), vhalf));
+    }
+    _mm_storeu_si128 ((__m128i *) (out + j), _mm_packus_epi16 (_mm_packs_epi32 (v[0], v[1]),
+            _mm_packs_epi32 (v[2], v[3])));
+  }
+#endif
+
+  for (; j < n; j++) {
+    gint r = step_r ? j : j & 3, l = step_l ? j : j & 3;
+    gint32 sum = (bottom_r[r] - top_r[r]) - (bottom_l[l] - top_l[l]);
+
+    out[j] = (gint) (sum * (scale[j] * row_scale) + 0.5f);
+  }
+}
+
+/* Blur the @width x @height region at @data in place with a box of 2 * @radius + 1
+ * pixels per side, per interleaved channel, from a summed-area table of the region. Each
+ * pixel costs four table reads whatever @radius is, and @radius is not limited. Near the
+ * region edges the box is clipped to the region and its mean taken over what is left. */
+void kernel_integral_blur (guint8 *data, gint stride, gint channels, gint width,
+    gint height, gint radius, guint8 *scratch)
+{
+  static const guint32 zero[4] = { 0, };
+  gint row = width * channels, table_row = (width + 1) * channels, x, y, k, s;
+  gint lead = (radius + 1) * channels, back = radius * channels, clip_left, clip_right;
+  guint32 *table = (guint32 *) GSIZE_TO_POINTER (((gsize) scratch + 15) & ~(gsize) 15);
+  gfloat *column_scale = (gfloat *) (table + (gsize) table_row * (height + 1));
+  gint splits[4];
+
+  if (radius <= 0 || width <= 0 || height <= 0)
+    return;
+
+  /* table[y][x] holds the sum of the pixels above and left of (x, y). The sums of a
+   * region of less than 8M pixels fit 31 bits. */
+  memset (table, 0, table_row * sizeof (guint32));
+  for (y = 0; y < height; y++) {
+    const guint8 *src = data + y * stride;
+    const guint32 *above = table + (gsize) y * table_row;
+    guint32 *sums = table + (gsize) (y + 1) * table_row;
+
+    for (k = 0; k < channels; k++) {
+      guint32 run = 0;
+
+      sums[k] = 0;
+      for (x = k; x < row; x += channels) {
+        run += src[x];
+        sums[x + channels] = above[x + channels] + run;
+      }
+    }
+  }
+
+  /* The clipped box width of the column of each byte, the height is per row */
+  for (x = 0; x < width; x++)
+    for (k = 0; k < channels; k++)
+      column_scale[x * channels + k] =
+          1.0f / (MIN (width, x + radius + 1) - MAX (0, x - radius));
+
+  /* The columns left of @clip_left have their box clipped by the left edge, the ones
+   * from @clip_right on by the right edge. Within each span between those the box has
+   * the same shape. */
+  clip_left = MIN (radius, width);
+  clip_right = MAX (0, width - radius);
+  splits[0] = 0;
+  splits[1] = MIN (clip_left, clip_right);
+  splits[2] = MAX (clip_left, clip_right);
+  splits[3] = width;
+
+  for (y = 0; y < height; y++) {
+    gint y0 = MAX (0, y - radius), y1 = MIN (height, y + radius + 1);
+    const guint32 *top = table + (gsize) y0 * table_row;
+    const guint32 *bottom = table + (gsize) y1 * table_row;
+    gfloat row_scale = 1.0f / (y1 - y0);
+    guint8 *out = data + y * stride;
+    guint32 corner_bottom[4], corner_top[4];
+
+    /* The repeated edge values only line up with 4 lanes for 1, 2 and 4 channels */
+    if (4 % channels != 0) {
+      for (x = 0; x < width; x++) {
+        gint x0 = MAX (0, x - radius) * channels, x1 = MIN (width, x + radius + 1) * channels;
+
+        for (k = 0; k < channels; k++) {
+          gint32 sum = (bottom[x1 + k] - top[x1 + k]) - (bottom[x0 + k] - top[x0 + k]);
+
+          out[x * channels + k] =
+              (gint) (sum * (column_scale[x * channels + k] * row_scale) + 0.5f);
+        }
+      }
+      continue;
+    }
+
+    for (k = 0; k < 4; k++) {
+      corner_bottom[k] = bottom[row + k % channels];
+      corner_top[k] = top[row + k % channels];
+    }
+    for (s = 0; s < 3; s++) {
+      gboolean left_clipped = splits[s] < clip_left, right_clipped = splits[s] >= clip_right;
+      gint j = splits[s] * channels;
+
+      if (splits[s] >= splits[s + 1])
+        continue;
+      integral_blur_span (right_clipped ? corner_bottom : bottom + j + lead,
+          right_clipped ? corner_top : top + j + lead, right_clipped ? 0 : 1,
+          left_clipped ? zero : bottom + j - back, left_clipped ? zero : top + j - back,
+          left_clipped ? 0 : 1, column_scale + j, row_scale,
+          (splits[s + 1] - splits[s]) * channels, out + j);
+    }
+  }
+}
+
+/* Set every pixel of the @width x @height region at @data to the @channels bytes at
+ * @pixel */
+void kernel_fill (guint8 *data, gint stride, gint channels, gint width, gint height,
+    const guint8 *pixel)
+{
+  gint x, y;
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  if (channels == 1) {
+    for (y = 0; y < height; y++)
+      memset (data + y * stride, pixel[0], width);
+    return;
+  }
+
+  for (x = 0; x < width; x++)
+    memcpy (data + x * channels, pixel, channels);
+  for (y = 1; y < height; y++)
+    memcpy (data + y * stride, data, (gsize) width * channels);
+}
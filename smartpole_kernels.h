@@ -0,0 +1,42 @@
+#ifndef __SMARTPOLE_KERNELS_H__
+#define __SMARTPOLE_KERNELS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Largest radius of kernel_box_blur(), its column sums are 16 bit */
+#define KERNEL_MAX_BLUR_RADIUS 127
+
+typedef enum {
+  KERNEL_ISA_SCALAR,
+  KERNEL_ISA_SSE2,
+  KERNEL_ISA_AVX2
+} KernelIsa;
+
+void kernel_downscale_luma (const guint8 *src, gint src_stride, gint width, gint height,
+    guint factor, guint8 *dst, gint dst_stride);
+guint kernel_sad (const guint8 *a, gint a_stride, const guint8 *b, gint b_stride,
+    gint width, gint height);
+void kernel_edge_map (const guint8 *src, gint src_stride, gint width, gint height,
+    guint8 threshold, gboolean vertical_edges, guint8 *dst, gint dst_stride);
+void kernel_box_intersections (const gfloat *x0, const gfloat *y0, const gfloat *x1,
+    const gfloat *y1, guint n, gfloat bx0, gfloat by0, gfloat bx1, gfloat by1, gfloat *inter);
+
+KernelIsa kernel_get_isa (void);
+gboolean kernel_set_isa (KernelIsa isa);
+const gchar *kernel_isa_name (KernelIsa isa);
+
+gsize kernel_redact_scratch_size (gint width, gint height, gint channels);
+void kernel_pixelate (guint8 *data, gint stride, gint channels, gint width, gint height,
+    gint block_w, gint block_h, guint8 *scratch);
+void kernel_box_blur (guint8 *data, gint stride, gint channels, gint width, gint height,
+    gint radius, guint8 *scratch);
+void kernel_integral_blur (guint8 *data, gint stride, gint channels, gint width,
+    gint height, gint radius, guint8 *scratch);
+void kernel_fill (guint8 *data, gint stride, gint channels, gint width, gint height,
+    const guint8 *pixel);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_KERNELS_H__ */
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "smartpole_camera.h"
+#include "smartpole_metrics.h"
+
+/* Scrapes served at once, more wait for a thread */
+#define METRICS_MAX_THREADS 2
+/* Seconds a client has to send its request and take the response */
+#define METRICS_TIMEOUT 5
+/* Longest request read, the headers past it are ignored */
+#define METRICS_MAX_REQUEST 4096
+
+struct _MetricsServer {
+  GSocketService *service;
+  GPtrArray *cameras;       /* Camera, not owned, fixed once the pipeline is built */
+  gchar *unix_path;         /* Socket file to remove on exit, or NULL */
+};
+
+/* Append @value as a label value, escaped as the text format wants */
+static void append_label (GString *text, const gchar *name, const gchar *value)
+{
+  const gchar *c;
+
+  g_string_append_printf (text, "%s=\"", name);
+  for (c = value; *c; c++) {
+    if (*c == '\\' || *c == '"')
+      g_string_append_c (text, '\\');
+    if (*c == '\n')
+      g_string_append (text, "\\n");
+    else
+      g_string_append_c (text, *c);
+  }
+  g_string_append_c (text, '"');
+}
+
+static void append_family (GString *text, const gchar *name, const gchar *type,
+    const gchar *help)
+{
+  g_string_append_printf (text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/* Resident set size of the whole process, 0 if it cannot be read */
+static guint64 read_rss (void)
+{
+  gchar *statm;
+  guint64 size = 0, resident = 0;
+
+  if (!g_file_get_contents ("/proc/self/statm", &statm, NULL, NULL))
+    return 0;
+  if (sscanf (statm, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT, &size, &resident) != 2)
+    resident = 0;
+  g_free (statm);
+
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+/* The metrics of every camera, all the samples of a family together as the format
+ * requires */
+static void format_metrics (MetricsServer *server, GString *text)
+{
+  guint i, j;
+
+  append_family (text, "smartpole_stage_latency_seconds", "summary",
+      "Time frames spent in a pipeline stage, its rate of frames is the stage's fps");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    for (j = 0; j < camera->timers->len; j++) {
+      StageTimer *timer = g_ptr_array_index (camera->timers, j);
+      guint64 frames, dropped;
+      GstClockTime time;
+
+      stage_timer_get_totals (timer, &frames, &dropped, &time);
+      g_string_append (text, "smartpole_stage_latency_seconds_sum{");
+      append_label (text, "camera", camera->name);
+      g_string_append_c (text, ',');
+      append_label (text, "stage", stage_timer_get_name (timer));
+      g_string_append_printf (text, "} %.6f\n", (gdouble) time / GST_SECOND);
+      g_string_append (text, "smartpole_stage_latency_seconds_count{");
+      append_label (text, "camera", camera->name);
+      g_string_append_c (text, ',');
+      append_label (text, "stage", stage_timer_get_name (timer));
+      g_string_append_printf (text, "} %" G_GUINT64_FORMAT "\n", frames);
+    }
+  }
+
+  append_family (text, "smartpole_stage_dropped_frames_total", "counter",
+      "Frames into a pipeline stage that never came out of it");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    for (j = 0; j < camera->timers->len; j++) {
+      StageTimer *timer = g_ptr_array_index (camera->timers, j);
+      guint64 frames, dropped;
+      GstClockTime time;
+
+      stage_timer_get_totals (timer, &frames, &dropped, &time);
+      g_string_append (text, "smartpole_stage_dropped_frames_total{");
+      append_label (text, "camera", camera->name);
+      g_string_append_c (text, ',');
+      append_label (text, "stage", stage_timer_get_name (timer));
+      g_string_append_printf (text, "} %" G_GUINT64_FORMAT "\n", dropped);
+    }
+  }
+
+  append_family (text, "smartpole_queue_level_frames", "gauge",
+      "Frames waiting in a stage queue at the latest sample");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    for (j = 0; j < camera->n_queues; j++) {
+      g_string_append (text, "smartpole_queue_level_frames{");
+      append_label (text, "camera", camera->name);
+      g_string_append_c (text, ',');
+      append_label (text, "queue", camera->queues[j].name);
+      g_string_append_printf (text, "} %d\n", g_atomic_int_get (&camera->queues[j].level));
+    }
+  }
+
+  append_family (text, "smartpole_queue_overruns_total", "counter",
+      "Times a stage queue was full, the stage behind it being too slow");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    for (j = 0; j < camera->n_queues; j++) {
+      g_string_append (text, "smartpole_queue_overruns_total{");
+      append_label (text, "camera", camera->name);
+      g_string_append_c (text, ',');
+      append_label (text, "queue", camera->queues[j].name);
+      g_string_append_printf (text, "} %u\n",
+          (guint) g_atomic_int_get (&camera->queues[j].overruns_total));
+    }
+  }
+
+  append_family (text, "smartpole_rtp_packets_total", "counter",
+      "RTP packets the jitterbuffer passed on to the depayloader");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    g_string_append (text, "smartpole_rtp_packets_total{");
+    append_label (text, "camera", camera->name);
+    g_string_append_printf (text, "} %" G_GSIZE_FORMAT "\n",
+        (gsize) g_atomic_pointer_get (&camera->rtp_packets));
+  }
+
+  append_family (text, "smartpole_rtp_packets_lost_total", "counter",
+      "RTP packets missing from the sequence out of the jitterbuffer");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    g_string_append (text, "smartpole_rtp_packets_lost_total{");
+    append_label (text, "camera", camera->name);
+    g_string_append_printf (text, "} %" G_GSIZE_FORMAT "\n",
+        (gsize) g_atomic_pointer_get (&camera->rtp_lost));
+  }
+
+  append_family (text, "smartpole_jitterbuffer_latency_seconds", "gauge",
+      "Latency the jitterbuffer of a camera currently holds packets for");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    g_string_append (text, "smartpole_jitterbuffer_latency_seconds{");
+    append_label (text, "camera", camera->name);
+    g_string_append_printf (text, "} %.3f\n",
+        (guint) g_atomic_int_get ((gint *) &camera->latency) / 1000.0);
+  }
+
+  append_family (text, "smartpole_reconnects_total", "counter",
+      "Times the RTSP source of a camera was re-created after an error, an EOS or a stall");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    g_string_append (text, "smartpole_reconnects_total{");
+    append_label (text, "camera", camera->name);
+    g_string_append_printf (text, "} %d\n", g_atomic_int_get (&camera->reconnects));
+  }
+
+  append_family (text, "smartpole_restarts_total", "counter",
+      "Times every element of a camera was restarted after an error outside its source");
+  for (i = 0; i < server->cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (server->cameras, i);
+
+    g_string_append (text, "smartpole_restarts_total{");
+    append_label (text, "camera", camera->name);
+    g_string_append_printf (text, "} %d\n", g_atomic_int_get (&camera->restarts));
+  }
+
+  append_family (text, "process_resident_memory_bytes", "gauge",
+      "Resident memory of the process, shared by every camera");
+  g_string_append_printf (text, "process_resident_memory_bytes %" G_GUINT64_FORMAT "\n",
+      read_rss ());
+}
+
+/* Serve one connection on a thread of the service: read the request line, answer
+ * GET /metrics and close */
+static gboolean metrics_run_cb (GThreadedSocketService *service,
+    GSocketConnection *connection, GObject *source, MetricsServer *server)
+{
+  GInputStream *input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+  GOutputStream *output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+  gchar request[METRICS_MAX_REQUEST + 1];
+  gsize length = 0;
+  gssize n;
+  GString *response, *body = NULL;
+
+  g_socket_set_timeout (g_socket_connection_get_socket (connection), METRICS_TIMEOUT);
+  while (length < METRICS_MAX_REQUEST) {
+    n = g_input_stream_read (input, request + length, METRICS_MAX_REQUEST - length, NULL,
+        NULL);
+    if (n <= 0)
+      break;
+    length += n;
+    request[length] = '\0';
+    if (strstr (request, "\r\n\r\n") || strstr (request, "\n\n"))
+      break;
+  }
+  request[length] = '\0';
+
+  if (g_str_has_prefix (request, "GET /metrics ") || g_str_has_prefix (request, "GET / ")) {
+    body = g_string_new (NULL);
+    format_metrics (server, body);
+    response = g_string_new ("HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n");
+  } else {
+    response = g_string_new ("HTTP/1.0 404 Not Found\r\n");
+  }
+  g_string_append_printf (response, "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+      "Connection: close\r\n\r\n", body ? body->len : 0);
+  if (body)
+    g_string_append_len (response, body->str, body->len);
+
+  g_output_stream_write_all (output, response->str, response->len, NULL, NULL, NULL);
+  g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+  g_string_free (response, TRUE);
+  if (body)
+    g_string_free (body, TRUE);
+
+  return TRUE;
+}
+
+MetricsServer *metrics_server_new (const gchar *address, GPtrArray *cameras, GError **error)
+{
+  MetricsServer *server;
+  GSocketAddress *socket_address;
+
+  if (g_str_has_prefix (address, "unix:")) {
+    const gchar *path = address + strlen ("unix:");
+    GStatBuf st;
+
+    /* A socket file left over by a crash would make the bind fail. Anything else at the
+     * path is left alone, the bind reports it. */
+    if (g_lstat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+      g_unlink (path);
+    socket_address = g_unix_socket_address_new (path);
+  } else {
+    GSocketConnectable *connectable;
+    GSocketAddressEnumerator *enumerator;
+
+    /* A bare port listens on localhost only, the metrics are not for the network */
+    if (!strchr (address, ':')) {
+      guint64 port = g_ascii_strtoull (address, NULL, 10);
+
+      if (port == 0 || port > G_MAXUINT16) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+            "Invalid metrics port \"%s\"", address);
+        return NULL;
+      }
+      connectable = g_network_address_new_loopback ((guint16) port);
+    } else {
+      connectable = g_network_address_parse (address, 0, error);
+      if (!connectable)
+        return NULL;
+    }
+    enumerator = g_socket_connectable_enumerate (connectable);
+    socket_address = g_socket_address_enumerator_next (enumerator, NULL, error);
+    g_object_unref (enumerator);
+    g_object_unref (connectable);
+    if (!socket_address) {
+      if (error && !*error)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+            "Could not resolve \"%s\"", address);
+      return NULL;
+    }
+  }
+
+  server = g_new0 (MetricsServer, 1);
+  server->cameras = cameras;
+  server->service = g_threaded_socket_service_new (METRICS_MAX_THREADS);
+  if (G_IS_UNIX_SOCKET_ADDRESS (socket_address))
+    server->unix_path = g_strdup (address + strlen ("unix:"));
+  if (!g_socket_listener_add_address (G_SOCKET_LISTENER (server->service), socket_address,
+          G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, error)) {
+    g_object_unref (socket_address);
+    g_free (server->unix_path);
+    server->unix_path = NULL;
+    metrics_server_free (server);
+    return NULL;
+  }
+  g_object_unref (socket_address);
+
+  g_signal_connect (server->service, "run", G_CALLBACK (metrics_run_cb), server);
+  g_socket_service_start (server->service);
+
+  return server;
+}
+
+void metrics_server_free (MetricsServer *server)
+{
+  g_socket_service_stop (server->service);
+  g_socket_listener_close (G_SOCKET_LISTENER (server->service));
+  g_object_unref (server->service);
+  if (server->unix_path)
+    g_unlink (server->unix_path);
+  g_free (server->unix_path);
+  g_free (server);
+}
@@ -0,0 +1,19 @@
+#ifndef __SMARTPOLE_METRICS_H__
+#define __SMARTPOLE_METRICS_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* An HTTP endpoint serving the health of every camera in the Prometheus text format at
+ * /metrics, on a thread of its own. It only reads counters the streaming threads keep
+ * atomically, so a scrape never waits on a frame or makes a frame wait. @address is
+ * PORT or HOST:PORT, PORT alone listening on localhost only, or unix:PATH. */
+typedef struct _MetricsServer MetricsServer;
+
+MetricsServer *metrics_server_new (const gchar *address, GPtrArray *cameras, GError **error);
+void metrics_server_free (MetricsServer *server);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_METRICS_H__ */
@@ -0,0 +1,153 @@
+#include "smartpole_kernels.h"
+#include "smartpole_motion.h"
+
+/* Differencing runs on the luma plane downscaled by this factor */
+#define MOTION_SCALE 4
+/* Side of a tile, in downscaled pixels */
+#define MOTION_TILE 16
+
+struct _MotionMask {
+  guint8 *prev;             /* Downscaled luma of the previous call */
+  guint8 *cur;
+  gint width, height;       /* Size of the downscaled planes */
+  gint frame_width, frame_height;
+  gint tiles_x, tiles_y;
+  guint8 *changed;          /* Per tile, after dilation */
+  guint8 *visited;          /* Per tile, scratch of the region labelling */
+  gint *stack;              /* Scratch of the region labelling */
+  gboolean valid;
+};
+
+MotionMask *motion_mask_new (void)
+{
+  return g_new0 (MotionMask, 1);
+}
+
+static void motion_mask_release (MotionMask *mask)
+{
+  g_free (mask->prev);
+  g_free (mask->cur);
+  g_free (mask->changed);
+  g_free (mask->visited);
+  g_free (mask->stack);
+}
+
+void motion_mask_free (MotionMask *mask)
+{
+  motion_mask_release (mask);
+  g_free (mask);
+}
+
+static void motion_mask_resize (MotionMask *mask, gint width, gint height)
+{
+  gint n_tiles;
+
+  motion_mask_release (mask);
+  mask->frame_width = width;
+  mask->frame_height = height;
+  mask->width = width / MOTION_SCALE;
+  mask->height = height / MOTION_SCALE;
+  mask->tiles_x = (mask->width + MOTION_TILE - 1) / MOTION_TILE;
+  mask->tiles_y = (mask->height + MOTION_TILE - 1) / MOTION_TILE;
+  n_tiles = mask->tiles_x * mask->tiles_y;
+  mask->prev = g_malloc ((gsize) mask->width * mask->height);
+  mask->cur = g_malloc ((gsize) mask->width * mask->height);
+  mask->changed = g_malloc (n_tiles);
+  mask->visited = g_malloc (n_tiles);
+  mask->stack = g_new (gint, n_tiles);
+  mask->valid = FALSE;
+}
+
+/* Compare the @width x @height luma plane @gray with the one of the previous call and
+ * replace the content of @regions with the bounding boxes, in frame pixels, of the
+ * connected groups of tiles whose mean absolute difference is above @threshold. Changed
+ * tiles are grown by one tile so that objects crossing a tile border are not cut. The
+ * first call, or the first after a size change, reports the whole frame. Returns the
+ * number of regions. */
+guint motion_mask_update (MotionMask *mask, const guint8 *gray, gint width, gint height,
+    gint stride, guint threshold, GArray *regions)
+{
+  gint tx, ty, i, n_tiles;
+  guint8 *tmp;
+
+  g_array_set_size (regions, 0);
+  if (width != mask->frame_width || height != mask->frame_height)
+    motion_mask_resize (mask, width, height);
+  n_tiles = mask->tiles_x * mask->tiles_y;
+
+  kernel_downscale_luma (gray, stride, width, height, MOTION_SCALE, mask->cur, mask->width);
+
+  if (!mask->valid) {
+    GstVideoRectangle all = { 0, 0, width, height };
+
+    mask->valid = TRUE;
+    g_array_append_val (regions, all);
+    goto done;
+  }
+
+  /* Threshold the tiles, then dilate by one tile into the visited scratch */
+  memset (mask->visited, 0, n_tiles);
+  for (ty = 0; ty < mask->tiles_y; ty++) {
+    for (tx = 0; tx < mask->tiles_x; tx++) {
+      gint x = tx * MOTION_TILE, y = ty * MOTION_TILE;
+      gint w = MIN (MOTION_TILE, mask->width - x), h = MIN (MOTION_TILE, mask->height - y);
+      guint sad = kernel_sad (mask->prev + y * mask->width + x, mask->width,
+          mask->cur + y * mask->width + x, mask->width, w, h);
+
+      if (sad > threshold * w * h) {
+        gint dx, dy;
+
+        for (dy = -1; dy <= 1; dy++)
+          for (dx = -1; dx <= 1; dx++)
+            if (tx + dx >= 0 && tx + dx < mask->tiles_x && ty + dy >= 0 && ty + dy < mask->tiles_y)
+              mask->visited[(ty + dy) * mask->tiles_x + tx + dx] = 1;
+      }
+    }
+  }
+  memcpy (mask->changed, mask->visited, n_tiles);
+  memset (mask->visited, 0, n_tiles);
+
+  /* Bounding box of every 4-connected group of changed tiles */
+  for (i = 0; i < n_tiles; i++) {
+    gint x0, y0, x1, y1, top = 0;
+    GstVideoRectangle rect;
+
+    if (!mask->changed[i] || mask->visited[i])
+      continue;
+
+    x0 = x1 = i % mask->tiles_x;
+    y0 = y1 = i / mask->tiles_x;
+    mask->visited[i] = 1;
+    mask->stack[top++] = i;
+    while (top > 0) {
+      gint t = mask->stack[--top];
+      gint x = t % mask->tiles_x, y = t / mask->tiles_x;
+      gint neighbors[4] = { x > 0 ? t - 1 : -1, x + 1 < mask->tiles_x ? t + 1 : -1,
+          y > 0 ? t - mask->tiles_x : -1, y + 1 < mask->tiles_y ? t + mask->tiles_x : -1 };
+      gint k;
+
+      x0 = MIN (x0, x);
+      x1 = MAX (x1, x);
+      y0 = MIN (y0, y);
+      y1 = MAX (y1, y);
+      for (k = 0; k < 4; k++) {
+        if (neighbors[k] >= 0 && mask->changed[neighbors[k]] && !mask->visited[neighbors[k]]) {
+          mask->visited[neighbors[k]] = 1;
+          mask->stack[top++] = neighbors[k];
+        }
+      }
+    }
+
+    rect.x = x0 * MOTION_TILE * MOTION_SCALE;
+    rect.y = y0 * MOTION_TILE * MOTION_SCALE;
+    rect.w = MIN (width, (x1 + 1) * MOTION_TILE * MOTION_SCALE) - rect.x;
+    rect.h = MIN (height, (y1 + 1) * MOTION_TILE * MOTION_SCALE) - rect.y;
+    g_array_append_val (regions, rect);
+  }
+
+done:
+  tmp = mask->prev;
+  mask->prev = mask->cur;
+  mask->cur = tmp;
+  return regions->len;
+}
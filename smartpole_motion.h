@@ -0,0 +1,21 @@
+#ifndef __SMARTPOLE_MOTION_H__
+#define __SMARTPOLE_MOTION_H__
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/* Finds the tiles of the frame that changed since the previous call by differencing a
+ * downscaled copy of the luma plane */
+typedef struct _MotionMask MotionMask;
+
+MotionMask *motion_mask_new (void);
+void motion_mask_free (MotionMask *mask);
+
+guint motion_mask_update (MotionMask *mask, const guint8 *gray, gint width, gint height,
+    gint stride, guint threshold, GArray *regions);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_MOTION_H__ */
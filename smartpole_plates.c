@@ -0,0 +1,216 @@
+#include <math.h>
+#include <string.h>
+
+#include "smartpole_kernels.h"
+#include "smartpole_plates.h"
+
+/* Gradient above which a pixel is an edge */
+#define PLATE_EDGE_THRESHOLD 48
+/* Edges are counted per cell of CELL_W x CELL_H plane pixels */
+#define CELL_W 4
+#define CELL_H 2
+/* Vertical edge pixels needed to mark a cell, out of CELL_W * CELL_H */
+#define CELL_MIN_EDGES 2
+/* Unmarked cells bridged between two marked ones on a row, the gaps between characters */
+#define CELL_GAP 2
+/* Width over height of the boxes kept as candidates. Single row plates are 2 (US) to 5
+ * (EU, KR) times wider than high. */
+#define PLATE_MIN_ASPECT 1.8
+#define PLATE_MAX_ASPECT 6.5
+/* Largest plate searched for, as a fraction of the frame height */
+#define PLATE_MAX_HEIGHT 0.15
+/* Fraction of the box size added on every side of an accepted plate */
+#define PLATE_PADDING 0.15
+
+struct _PlateDetector {
+  gint width, height;       /* Size of the plane the buffers are allocated for */
+  gint cells_x, cells_y;
+  guint8 *vertical;         /* Vertical edge map of the plane */
+  guint8 *horizontal;       /* Horizontal edge map of the plane */
+  guint8 *cells;            /* Per cell, marked or not */
+  guint8 *visited;          /* Per cell, scratch of the labelling */
+  gint *stack;
+};
+
+PlateDetector *plate_detector_new (void)
+{
+  return g_new0 (PlateDetector, 1);
+}
+
+static void plate_detector_release (PlateDetector *detector)
+{
+  g_free (detector->vertical);
+  g_free (detector->horizontal);
+  g_free (detector->cells);
+  g_free (detector->visited);
+  g_free (detector->stack);
+}
+
+void plate_detector_free (PlateDetector *detector)
+{
+  plate_detector_release (detector);
+  g_free (detector);
+}
+
+static void plate_detector_resize (PlateDetector *detector, gint width, gint height)
+{
+  gint n_cells;
+
+  plate_detector_release (detector);
+  detector->width = width;
+  detector->height = height;
+  detector->cells_x = width / CELL_W;
+  detector->cells_y = height / CELL_H;
+  n_cells = detector->cells_x * detector->cells_y;
+  detector->vertical = g_malloc ((gsize) width * height);
+  detector->horizontal = g_malloc ((gsize) width * height);
+  detector->cells = g_malloc (MAX (n_cells, 1));
+  detector->visited = g_malloc (MAX (n_cells, 1));
+  detector->stack = g_new (gint, MAX (n_cells, 1));
+}
+
+/* Score a candidate box of the plane with a hand-tuned linear classifier. Plates have
+ * many more vertical than horizontal edges, several strokes crossing every row, and
+ * strong contrast between characters and background. The score is from 0 to 5. */
+static gdouble plate_score (PlateDetector *detector, const LumaPlane *plane,
+    const GstVideoRectangle *box)
+{
+  guint64 sum = 0, sum_sq = 0;
+  guint n_vertical = 0, n_horizontal = 0, transitions = 0, rows = 0;
+  gdouble area = (gdouble) box->w * box->h, mean, stddev, ratio, strokes;
+  gint x, y;
+
+  for (y = box->y; y < box->y + box->h; y++) {
+    const guint8 *luma = plane->data + y * plane->stride;
+    const guint8 *v = detector->vertical + y * detector->width;
+    const guint8 *h = detector->horizontal + y * detector->width;
+    gboolean middle = y >= box->y + box->h / 4 && y < box->y + 3 * box->h / 4;
+
+    for (x = box->x; x < box->x + box->w; x++) {
+      sum += luma[x];
+      sum_sq += luma[x] * luma[x];
+      n_vertical += v[x];
+      n_horizontal += h[x];
+      if (middle && x > box->x && v[x] && !v[x - 1])
+        transitions++;
+    }
+    rows += middle;
+  }
+
+  mean = sum / area;
+  stddev = sqrt (MAX (0.0, sum_sq / area - mean * mean));
+  ratio = (n_vertical + 1.0) / (n_horizontal + 1.0);
+  /* Edge runs per row per box height of width: about two characters of two strokes
+   * with two edges each */
+  strokes = rows ? transitions / (gdouble) rows / ((gdouble) box->w / box->h) : 0.0;
+
+  return 2.0 * MIN (n_vertical / area, 0.3) / 0.3 +
+      1.0 * CLAMP (ratio - 1.0, 0.0, 2.0) / 2.0 +
+      1.0 * MIN (strokes / 4.0, 1.0) +
+      1.0 * MIN (stddev / 50.0, 1.0) -
+      (n_vertical / area > 0.6 ? 2.0 : 0.0);
+}
+
+/* Replace the content of @rects with the plates found on @plane, in frame pixels, at
+ * least @min_height frame pixels high and scoring at least @threshold. Returns the
+ * number of plates. */
+guint plate_detector_detect (PlateDetector *detector, const LumaPlane *plane, gint min_height,
+    gdouble threshold, GArray *rects)
+{
+  gint cx, cy, i, n_cells, min_cells, max_cells;
+  gint scale = plane->scale;
+
+  g_array_set_size (rects, 0);
+  if (plane->width < 3 || plane->height < 3)
+    return 0;
+  if (plane->width != detector->width || plane->height != detector->height)
+    plate_detector_resize (detector, plane->width, plane->height);
+  n_cells = detector->cells_x * detector->cells_y;
+
+  kernel_edge_map (plane->data, plane->stride, plane->width, plane->height,
+      PLATE_EDGE_THRESHOLD, TRUE, detector->vertical, detector->width);
+  kernel_edge_map (plane->data, plane->stride, plane->width, plane->height,
+      PLATE_EDGE_THRESHOLD, FALSE, detector->horizontal, detector->width);
+
+  /* Mark the cells dense in vertical edges and bridge the gaps between characters */
+  for (cy = 0; cy < detector->cells_y; cy++) {
+    guint8 *row = detector->cells + cy * detector->cells_x;
+    gint last = -1;
+
+    for (cx = 0; cx < detector->cells_x; cx++) {
+      const guint8 *v = detector->vertical + cy * CELL_H * detector->width + cx * CELL_W;
+      gint count = 0, x, y;
+
+      for (y = 0; y < CELL_H; y++)
+        for (x = 0; x < CELL_W; x++)
+          count += v[y * detector->width + x];
+      row[cx] = count >= CELL_MIN_EDGES;
+      if (row[cx]) {
+        if (last >= 0 && cx - last - 1 <= CELL_GAP)
+          memset (row + last + 1, 1, cx - last - 1);
+        last = cx;
+      }
+    }
+  }
+
+  /* Bounding box of every 4-connected group of marked cells */
+  min_cells = MAX (2, min_height / scale / CELL_H);
+  max_cells = MAX (min_cells, (gint) (plane->height * PLATE_MAX_HEIGHT) / CELL_H);
+  memset (detector->visited, 0, n_cells);
+  for (i = 0; i < n_cells; i++) {
+    gint x0, y0, x1, y1, top = 0;
+    GstVideoRectangle box;
+    gdouble aspect;
+
+    if (!detector->cells[i] || detector->visited[i])
+      continue;
+
+    x0 = x1 = i % detector->cells_x;
+    y0 = y1 = i / detector->cells_x;
+    detector->visited[i] = 1;
+    detector->stack[top++] = i;
+    while (top > 0) {
+      gint t = detector->stack[--top];
+      gint x = t % detector->cells_x, y = t / detector->cells_x;
+      gint neighbors[4] = { x > 0 ? t - 1 : -1, x + 1 < detector->cells_x ? t + 1 : -1,
+          y > 0 ? t - detector->cells_x : -1,
+          y + 1 < detector->cells_y ? t + detector->cells_x : -1 };
+      gint k;
+
+      x0 = MIN (x0, x);
+      x1 = MAX (x1, x);
+      y0 = MIN (y0, y);
+      y1 = MAX (y1, y);
+      for (k = 0; k < 4; k++) {
+        if (neighbors[k] >= 0 && detector->cells[neighbors[k]] &&
+            !detector->visited[neighbors[k]]) {
+          detector->visited[neighbors[k]] = 1;
+          detector->stack[top++] = neighbors[k];
+        }
+      }
+    }
+
+    if (y1 - y0 + 1 < min_cells || y1 - y0 + 1 > max_cells)
+      continue;
+    box.x = x0 * CELL_W;
+    box.y = y0 * CELL_H;
+    box.w = (x1 - x0 + 1) * CELL_W;
+    box.h = (y1 - y0 + 1) * CELL_H;
+    aspect = (gdouble) box.w / box.h;
+    if (aspect < PLATE_MIN_ASPECT || aspect > PLATE_MAX_ASPECT ||
+        plate_score (detector, plane, &box) < threshold)
+      continue;
+
+    {
+      gint pad_x = box.w * scale * PLATE_PADDING, pad_y = box.h * scale * PLATE_PADDING;
+      gint fx0 = MAX (0, box.x * scale - pad_x), fy0 = MAX (0, box.y * scale - pad_y);
+      gint fx1 = MIN (plane->frame_width, (box.x + box.w) * scale + pad_x);
+      gint fy1 = MIN (plane->frame_height, (box.y + box.h) * scale + pad_y);
+      GstVideoRectangle plate = { fx0, fy0, fx1 - fx0, fy1 - fy0 };
+
+      g_array_append_val (rects, plate);
+    }
+  }
+
+  return rects->len;
+}
@@ -0,0 +1,24 @@
+#ifndef __SMARTPOLE_PLATES_H__
+#define __SMARTPOLE_PLATES_H__
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+#include "smartpole_pyramid.h"
+
+G_BEGIN_DECLS
+
+/* Finds number plates on a luma plane: dense runs of vertical edges, the character
+ * strokes, are grouped into candidate boxes of plate shape, which a small linear
+ * classifier over edge and contrast features accepts or rejects */
+typedef struct _PlateDetector PlateDetector;
+
+PlateDetector *plate_detector_new (void);
+void plate_detector_free (PlateDetector *detector);
+
+guint plate_detector_detect (PlateDetector *detector, const LumaPlane *plane, gint min_height,
+    gdouble threshold, GArray *rects);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_PLATES_H__ */
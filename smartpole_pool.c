@@ -0,0 +1,238 @@
+#include "smartpole_pool.h"
+
+/* The tasks of one work_pool_run() call */
+typedef struct _WorkBatch {
+  WorkFunc func;
+  guint8 *tasks;
+  gsize task_size;
+  gpointer user_data;
+  guint pending;            /* Tasks not finished yet, under @lock */
+  GMutex lock;
+  GCond done;
+} WorkBatch;
+
+typedef struct _WorkItem {
+  WorkBatch *batch;
+  guint index;
+} WorkItem;
+
+/* The queue of one worker. The owner takes from the tail, so it keeps working on the
+ * neighbouring tasks it was handed, thieves take from the head. */
+typedef struct _WorkQueue {
+  GMutex lock;
+  GArray *items;            /* WorkItem */
+  guint head;
+} WorkQueue;
+
+struct _WorkPool {
+  guint n_workers;
+  GThread **threads;
+  WorkQueue *queues;
+  gint n_items;             /* Items queued over all the queues, atomic */
+  guint next_queue;         /* Queue the next batch starts filling, under @lock */
+  GMutex lock;
+  GCond wake;
+  gboolean quit;
+};
+
+typedef struct _WorkerData {
+  WorkPool *pool;
+  guint index;
+} WorkerData;
+
+static gboolean work_queue_pop (WorkPool *pool, WorkQueue *queue, gboolean from_head,
+    WorkItem *item)
+{
+  gboolean found = FALSE;
+
+  g_mutex_lock (&queue->lock);
+  if (queue->head < queue->items->len) {
+    if (from_head) {
+      *item = g_array_index (queue->items, WorkItem, queue->head++);
+    } else {
+      *item = g_array_index (queue->items, WorkItem, queue->items->len - 1);
+      g_array_set_size (queue->items, queue->items->len - 1);
+    }
+    if (queue->head == queue->items->len) {
+      g_array_set_size (queue->items, 0);
+      queue->head = 0;
+    }
+    g_atomic_int_add (&pool->n_items, -1);
+    found = TRUE;
+  }
+  g_mutex_unlock (&queue->lock);
+
+  return found;
+}
+
+/* Take an item from the own queue of worker @index, or steal one from another worker */
+static gboolean work_pool_take (WorkPool *pool, guint index, WorkItem *item)
+{
+  guint i;
+
+  for (i = 0; i < pool->n_workers; i++) {
+    if (work_queue_pop (pool, &pool->queues[(index + i) % pool->n_workers], i > 0, item))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gpointer work_pool_worker (gpointer data)
+{
+  WorkerData *worker = data;
+  WorkPool *pool = worker->pool;
+  WorkItem item;
+
+  for (;;) {
+    if (work_pool_take (pool, worker->index, &item)) {
+      WorkBatch *batch = item.batch;
+
+      batch->func (batch->tasks + item.index * batch->task_size, worker->index,
+          batch->user_data);
+      /* The batch lives on the stack of its caller, which may return as soon as it
+       * sees the count drop to 0, so the count only changes under the batch lock */
+      g_mutex_lock (&batch->lock);
+      if (--batch->pending == 0)
+        g_cond_signal (&batch->done);
+      g_mutex_unlock (&batch->lock);
+      continue;
+    }
+
+    g_mutex_lock (&pool->lock);
+    while (!pool->quit && g_atomic_int_get (&pool->n_items) == 0)
+      g_cond_wait (&pool->wake, &pool->lock);
+    if (pool->quit) {
+      g_mutex_unlock (&pool->lock);
+      break;
+    }
+    g_mutex_unlock (&pool->lock);
+  }
+
+  g_free (worker);
+  return NULL;
+}
+
+WorkPool *work_pool_new (guint n_workers)
+{
+  WorkPool *pool = g_new0 (WorkPool, 1);
+  guint i;
+
+  pool->n_workers = MAX (1, n_workers);
+  pool->threads = g_new0 (GThread *, pool->n_workers);
+  pool->queues = g_new0 (WorkQueue, pool->n_workers);
+  g_mutex_init (&pool->lock);
+  g_cond_init (&pool->wake);
+
+  /* Every queue must exist before the first worker starts stealing */
+  for (i = 0; i < pool->n_workers; i++) {
+    g_mutex_init (&pool->queues[i].lock);
+    pool->queues[i].items = g_array_new (FALSE, FALSE, sizeof (WorkItem));
+  }
+  for (i = 0; i < pool->n_workers; i++) {
+    WorkerData *worker = g_new (WorkerData, 1);
+    gchar *name = g_strdup_printf ("detect-%u", i);
+
+    worker->pool = pool;
+    worker->index = i;
+    pool->threads[i] = g_thread_new (name, work_pool_worker, worker);
+    g_free (name);
+  }
+
+  return pool;
+}
+
+/* Stop the workers once the running batches are done */
+void work_pool_free (WorkPool *pool)
+{
+  guint i;
+
+  g_mutex_lock (&pool->lock);
+  pool->quit = TRUE;
+  g_cond_broadcast (&pool->wake);
+  g_mutex_unlock (&pool->lock);
+
+  for (i = 0; i < pool->n_workers; i++) {
+    g_thread_join (pool->threads[i]);
+    g_array_free (pool->queues[i].items, TRUE);
+    g_mutex_clear (&pool->queues[i].lock);
+  }
+  g_mutex_clear (&pool->lock);
+  g_cond_clear (&pool->wake);
+  g_free (pool->threads);
+  g_free (pool->queues);
+  g_free (pool);
+}
+
+guint work_pool_get_n_workers (WorkPool *pool)
+{
+  return pool->n_workers;
+}
+
+/* Run @func on each of the @n_tasks tasks of @task_size bytes at @tasks and wait until
+ * all of them are done. Consecutive tasks are handed to the same worker, the batches of
+ * successive calls start on different workers so that concurrent callers spread out. */
+void work_pool_run (WorkPool *pool, WorkFunc func, gpointer tasks, gsize task_size,
+    guint n_tasks, gpointer user_data)
+{
+  WorkBatch batch = { func, tasks, task_size, user_data, n_tasks };
+  guint first, i;
+
+  if (n_tasks == 0)
+    return;
+
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.done);
+
+  /* Queuing under the pool lock keeps @n_items at least the number of queued items for
+   * the workers deciding to sleep */
+  g_mutex_lock (&pool->lock);
+  first = pool->next_queue;
+  pool->next_queue = (pool->next_queue + 1) % pool->n_workers;
+  g_atomic_int_add (&pool->n_items, n_tasks);
+  for (i = 0; i < n_tasks; i++) {
+    WorkQueue *queue = &pool->queues[(first + i * pool->n_workers / n_tasks) % pool->n_workers];
+    WorkItem item = { &batch, i };
+
+    g_mutex_lock (&queue->lock);
+    g_array_append_val (queue->items, item);
+    g_mutex_unlock (&queue->lock);
+  }
+  g_cond_broadcast (&pool->wake);
+  g_mutex_unlock (&pool->lock);
+
+  g_mutex_lock (&batch.lock);
+  while (batch.pending > 0)
+    g_cond_wait (&batch.done, &batch.lock);
+  g_mutex_unlock (&batch.lock);
+
+  g_mutex_clear (&batch.lock);
+  g_cond_clear (&batch.done);
+}
+
+static GMutex shared_lock;
+static WorkPool *shared_pool = NULL;
+static guint shared_size = 0;
+
+/* Size of the pool work_pool_get_shared() creates, 0 for one worker per processor. Only
+ * has an effect before the first call to work_pool_get_shared(). */
+void work_pool_set_shared_size (guint n_workers)
+{
+  g_mutex_lock (&shared_lock);
+  shared_size = n_workers;
+  g_mutex_unlock (&shared_lock);
+}
+
+/* The process-wide pool, created on first use and never freed */
+WorkPool *work_pool_get_shared (void)
+{
+  WorkPool *pool;
+
+  g_mutex_lock (&shared_lock);
+  if (!shared_pool)
+    shared_pool = work_pool_new (shared_size ? shared_size : g_get_num_processors ());
+  pool = shared_pool;
+  g_mutex_unlock (&shared_lock);
+
+  return pool;
+}
@@ -0,0 +1,29 @@
+#ifndef __SMARTPOLE_POOL_H__
+#define __SMARTPOLE_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A fixed set of worker threads shared by every camera. Each worker has its own queue of
+ * tasks and steals from the others when it runs out, so the tasks of a frame spread over
+ * every core without more threads than the pool was sized for. */
+typedef struct _WorkPool WorkPool;
+
+/* Run one task. @worker is the index of the running worker, below
+ * work_pool_get_n_workers(), so that per-worker state needs no locking. */
+typedef void (*WorkFunc) (gpointer task, guint worker, gpointer user_data);
+
+WorkPool *work_pool_new (guint n_workers);
+void work_pool_free (WorkPool *pool);
+guint work_pool_get_n_workers (WorkPool *pool);
+
+void work_pool_run (WorkPool *pool, WorkFunc func, gpointer tasks, gsize task_size,
+    guint n_tasks, gpointer user_data);
+
+void work_pool_set_shared_size (guint n_workers);
+WorkPool *work_pool_get_shared (void);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_POOL_H__ */
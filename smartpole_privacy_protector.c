@@ -1,9 +1,16 @@
 #include <string.h>
+#include <math.h>
 
+#include <glib-unix.h>
 #include <gtk/gtk.h>
 #include <gst/gst.h>
 #include <gst/video/videooverlay.h>
 
+#include "gstprivacyredact.h"
+#include "smartpole_batch.h"
+#include "smartpole_camera.h"
+#include "smartpole_metrics.h"
+
 #include <gdk/gdk.h>
 #if defined (GDK_WINDOWING_X11)
 #include <gdk/gdkx.h>
@@ -443,29 +450,23 @@ static void window_closed (GtkWidget * widget, GdkEvent * event, gpointer user_d
   gtk_main_quit ();
 }
 
-// status play -> link rtspsrc
-static void on_pad_added (GstElement *element, GstPad *pad, gpointer data) {
-
-	GstPad *sinkpad;
-	GstElement *demux = (GstElement *) data;
-	sinkpad = gst_element_get_static_pad (demux, "sink");
-	gst_pad_link (pad, sinkpad);
-	gst_object_unref (sinkpad);
-}
-static int _g_is_faceblur_onoff = 0; // default off
+static int _g_is_faceblur_onoff = 1; // default on, privacyredact blurs from the start
 static void button_faceblur_onoff_func(GtkWidget *widget, gpointer *data )
 {
   printf("button_faceblur_onoff_func\r\n");
-  GstElement *faceblur = (GstElement *) data;
+  GPtrArray *cameras = (GPtrArray *) data;
+  guint i;
   if(_g_is_faceblur_onoff == 0)
   {
-      //g_object_set (G_OBJECT (faceblur), "display", 1, NULL);
+      for (i = 0; i < cameras->len; i++)
+        camera_set_blur_faces (g_ptr_array_index (cameras, i), TRUE);
       _g_is_faceblur_onoff = 1;
       gtk_button_set_label(GTK_BUTTON(widget), "face SHOW");
   }
   else
   {
-      //g_object_set (G_OBJECT (faceblur), "display", 0, NULL);
+      for (i = 0; i < cameras->len; i++)
+        camera_set_blur_faces (g_ptr_array_index (cameras, i), FALSE);
       _g_is_faceblur_onoff = 0;
       gtk_button_set_label(GTK_BUTTON(widget), "face HIDE");
 
@@ -476,35 +477,41 @@ static int _g_is_facearea_onoff = 0; // default off
 static void button_facearea_onoff_func(GtkWidget *widget, gpointer *data )
 {
   printf("button_facearea_onoff_func\r\n");
-  GstElement *facedetect = (GstElement *) data;
+  GPtrArray *cameras = (GPtrArray *) data;
+  guint i;
   if(_g_is_facearea_onoff == 0)
   {
-      g_object_set (G_OBJECT (facedetect), "display", 1, NULL);
+      for (i = 0; i < cameras->len; i++)
+        camera_set_show_faces (g_ptr_array_index (cameras, i), TRUE);
       _g_is_facearea_onoff = 1;
       gtk_button_set_label(GTK_BUTTON(widget), "faceArea HIDE");
   }
   else
   {
-      g_object_set (G_OBJECT (facedetect), "display", 0, NULL);
+      for (i = 0; i < cameras->len; i++)
+        camera_set_show_faces (g_ptr_array_index (cameras, i), FALSE);
       _g_is_facearea_onoff = 0;
       gtk_button_set_label(GTK_BUTTON(widget), "faceArea SHOW");
 
   } 
 }
-static int _g_is_numberplateblur_onoff = 0; // default off
+static int _g_is_numberplateblur_onoff = 0; // default off, plates are not even detected
 static void button_numberplateblur_onoff_func(GtkWidget *widget, gpointer *data )
 {
   printf("button_numberplateblur_onoff_func\r\n");
-  GstElement *numberplateblur = (GstElement *) data;
+  GPtrArray *cameras = (GPtrArray *) data;
+  guint i;
   if(_g_is_numberplateblur_onoff == 0)
   {
-      //g_object_set (G_OBJECT (numberplateblur), "display", 1, NULL);
+      for (i = 0; i < cameras->len; i++)
+        camera_set_blur_plates (g_ptr_array_index (cameras, i), TRUE);
       _g_is_numberplateblur_onoff = 1;
       gtk_button_set_label(GTK_BUTTON(widget), "numberPlate SHOW");
   }
   else
   {
-      //g_object_set (G_OBJECT (numberplateblur), "display", 0, NULL);
+      for (i = 0; i < cameras->len; i++)
+        camera_set_blur_plates (g_ptr_array_index (cameras, i), FALSE);
       _g_is_numberplateblur_onoff = 0;
       gtk_button_set_label(GTK_BUTTON(widget), "numberPlate HIDE");
 
@@ -529,49 +536,268 @@ static void _eos_cb (GstBus *bus, GstMessage *msg, CustomData *data)
   gst_element_set_state (pipeline, GST_STATE_PLAYING);
 }
 
-//#gst-launch-1.0 rtspsrc location=rtsp://10.100.100.100:8554/test latency=200 ! decodebin ! videoconvert ! faceblur ! videoconvert ! ximagesink
-int main(int argc, char *argv[])
+/* Command line options of main() */
+static gboolean opt_pipelined = FALSE;
+static gint opt_queue_size = 4;
+static gint opt_stats_interval = 5;
+static gchar *opt_stats_file = NULL;
+static gchar *opt_config = NULL;
+static gboolean opt_async_detect = FALSE;
+static gint opt_roi_margin = 20;
+static gint opt_roi_hold = 500;
+static gint opt_detect_scale = 1;
+static gint opt_detect_interval = 1;
+static gboolean opt_motion_gate = FALSE;
+static gint opt_detect_threads = 0;
+static gchar *opt_redact_mode = NULL;
+static gboolean opt_headless = FALSE;
+static gchar *opt_output = NULL;
+static gint opt_restream_port = 0;
+static gint opt_restream_bitrate = 2048;
+static gint opt_restream_client_queue = 1024;
+static gboolean opt_restream_passthrough = FALSE;
+static gchar *opt_metrics = NULL;
+static gboolean opt_glass_to_glass = FALSE;
+static gint opt_latency_min = 0;
+static gint opt_latency_max = 0;
+static gboolean opt_low_latency = FALSE;
+static gchar *opt_batch = NULL;
+static gint opt_jobs = 0;
+static gint opt_cpu_budget = 0;
+static gchar *opt_summary = NULL;
+
+static GOptionEntry option_entries[] = {
+  { "config", 'c', 0, G_OPTION_ARG_FILENAME, &opt_config,
+    "Key file listing the cameras to show, one [camera NAME] group each", "FILE" },
+  { "pipelined", 'p', 0, G_OPTION_ARG_NONE, &opt_pipelined,
+    "Run decode, detection and output on their own streaming threads", NULL },
+  { "queue-size", 'q', 0, G_OPTION_ARG_INT, &opt_queue_size,
+    "Maximum number of frames buffered between two stages (default: 4)", "N" },
+  { "stats-interval", 0, 0, G_OPTION_ARG_INT, &opt_stats_interval,
+    "Seconds between per-camera fps, latency and queue reports, 0 to disable (default: 5)", "SEC" },
+  { "stats-file", 0, 0, G_OPTION_ARG_FILENAME, &opt_stats_file,
+    "Replace this file with each report as JSON, with the latency percentiles of every "
+    "pipeline stage", "FILE" },
+  { "async-detect", 'a', 0, G_OPTION_ARG_NONE, &opt_async_detect,
+    "Detect faces on a leaky side branch so display never waits for the detector", NULL },
+  { "roi-margin", 0, 0, G_OPTION_ARG_INT, &opt_roi_margin,
+    "Percentage of a face box added on every side in async mode (default: 20)", "PCT" },
+  { "roi-hold", 0, 0, G_OPTION_ARG_INT, &opt_roi_hold,
+    "Milliseconds a detection keeps being redacted in async mode (default: 500)", "MS" },
+  { "detect-scale", 's', 0, G_OPTION_ARG_INT, &opt_detect_scale,
+    "Detect on the luma plane downscaled by this factor, 1 to 8 (default: 1)", "N" },
+  { "detect-interval", 'n', 0, G_OPTION_ARG_INT, &opt_detect_interval,
+    "Detect on keyframes and every Nth frame, track faces in between (default: 1)", "N" },
+  { "motion-gate", 'm', 0, G_OPTION_ARG_NONE, &opt_motion_gate,
+    "Only run the detector on the parts of the frame that changed", NULL },
+  { "detect-threads", 't', 0, G_OPTION_ARG_INT, &opt_detect_threads,
+    "Split detection into tiles run on one pool of N threads shared by every camera, "
+    "0 to detect on each camera's own thread (default: 0)", "N" },
+  { "redact-mode", 'r', 0, G_OPTION_ARG_STRING, &opt_redact_mode,
+    "How faces and plates are redacted: pixelate, blur, integral-blur or fill "
+    "(default: pixelate)", "MODE" },
+  { "headless", 'H', 0, G_OPTION_ARG_NONE, &opt_headless,
+    "Run without GTK, a window or X11 rendering, for servers without a display", NULL },
+  { "output", 'o', 0, G_OPTION_ARG_STRING, &opt_output,
+    "Sink bin each camera feeds in headless mode, every %s replaced by the camera name, "
+    "e.g. \"x264enc ! mp4mux ! filesink location=%s.mp4\" (default: drop the frames)",
+    "PIPELINE" },
+  { "restream-port", 'R', 0, G_OPTION_ARG_INT, &opt_restream_port,
+    "Re-stream every camera's redacted video from an RTSP server on this port, at "
+    "rtsp://HOST:PORT/NAME, 0 to disable (default: 0)", "PORT" },
+  { "restream-bitrate", 0, 0, G_OPTION_ARG_INT, &opt_restream_bitrate,
+    "Bitrate each re-streamed camera is encoded at once for all its clients, in kbit/s "
+    "(default: 2048)", "KBPS" },
+  { "restream-client-queue", 0, 0, G_OPTION_ARG_INT, &opt_restream_client_queue,
+    "KiB a re-stream client may lag behind before it skips to the next keyframe "
+    "(default: 1024)", "KIB" },
+  { "restream-passthrough", 0, 0, G_OPTION_ARG_NONE, &opt_restream_passthrough,
+    "Look one GOP ahead and re-stream the camera's own H.264 for GOPs without faces or "
+    "plates, only re-encoding the others", NULL },
+  { "metrics", 'M', 0, G_OPTION_ARG_STRING, &opt_metrics,
+    "Serve per-camera metrics in the Prometheus text format at /metrics, on PORT or "
+    "HOST:PORT (a bare port listens on localhost) or unix:PATH", "ADDRESS" },
+  { "glass-to-glass", 'G', 0, G_OPTION_ARG_NONE, &opt_glass_to_glass,
+    "Read the time smartpole_bench pipeline stamps into its test frames at each sink and "
+    "report the true capture to display latency, split by stage", NULL },
+  { "latency-min", 0, 0, G_OPTION_ARG_INT, &opt_latency_min,
+    "Adapt every camera's jitterbuffer latency to the jitter and losses seen, from this "
+    "many ms up to --latency-max, instead of keeping its configured latency", "MS" },
+  { "latency-max", 0, 0, G_OPTION_ARG_INT, &opt_latency_max,
+    "Highest jitterbuffer latency of the adaptive mode (default: 1000 with --latency-min)",
+    "MS" },
+  { "low-latency", 'L', 0, G_OPTION_ARG_NONE, &opt_low_latency,
+    "Live monitoring profile: drop packets later than the jitterbuffer latency and show "
+    "frames as soon as they are redacted", NULL },
+  { "batch", 'B', 0, G_OPTION_ARG_FILENAME, &opt_batch,
+    "Redact the recordings given as arguments (MP4, MKV or raw H.264) into this directory "
+    "as fast as they decode, instead of showing cameras", "DIR" },
+  { "jobs", 'j', 0, G_OPTION_ARG_INT, &opt_jobs,
+    "Recordings --batch redacts at once (default: one per core of --cpu-budget, at most "
+    "one per recording)", "N" },
+  { "cpu-budget", 0, 0, G_OPTION_ARG_INT, &opt_cpu_budget,
+    "Cores --batch shares out between its jobs' decoder, detection and encoder threads "
+    "(default: every core)", "N" },
+  { "summary", 0, 0, G_OPTION_ARG_FILENAME, &opt_summary,
+    "File --batch writes its JSON throughput summary to (default: the standard output)",
+    "FILE" },
+  { NULL }
+};
+
+#define QUEUE_SAMPLE_PERIOD_MS 50
+
+/* All the cameras shown by main(), in display order */
+static GPtrArray *cameras = NULL;
+
+static gboolean sample_queue_stats (gpointer user_data)
 {
-  GdkWindow *video_window_xwindow;
-  GtkWidget *window, *video_window;
-  gulong embed_xid;
-  GstStateChangeReturn sret;
-  GstBus *bus;
+  guint i;
 
-  gst_init (&argc, &argv);
-  gtk_init (&argc, &argv);
+  for (i = 0; i < cameras->len; i++)
+    camera_sample_queues (g_ptr_array_index (cameras, i));
+  return TRUE;
+}
 
-  GstElement *pipeline, *source, *appxrtp, *filter, *typefind, *demux , *parse, *decodebin, *videoConvert, *sink, *decoder;
-  GstElement *facedetect, *faceblur, *videoConvert2;
+#define LATENCY_ADAPT_PERIOD_S 1
 
-  pipeline = gst_pipeline_new ("cctv player");
-  source = gst_element_factory_make ("rtspsrc", "source"); g_assert(source);
-
-  //Set CAPS
-  g_object_set (G_OBJECT (source), "location", "rtsp://10.178.134.100:8554/test", NULL);
-  g_object_set (G_OBJECT (source), "latency",200,NULL);
-  demux  = gst_element_factory_make ("rtph264depay", NULL); g_assert(demux );
-  parse = gst_element_factory_make ("h264parse", NULL); g_assert(parse);
-  filter = gst_element_factory_make("capsfilter", "filter"); g_assert(filter);
-  decodebin = gst_element_factory_make ("avdec_h264", NULL); g_assert(decodebin);
-  videoConvert = gst_element_factory_make ("videoconvert", NULL); g_assert(videoConvert);
-  videoConvert2 = gst_element_factory_make ("videoconvert", NULL); g_assert(videoConvert2);
-  sink = gst_element_factory_make ("ximagesink", NULL); g_assert(sink);
-  //sink = gst_element_factory_make ("autovideosink", NULL); g_assert(sink);
-  faceblur = gst_element_factory_make ("faceblur", NULL); g_assert(sink);
-  facedetect = gst_element_factory_make ("facedetect", NULL); g_assert(sink);
-
-  //ADD
-  //gst_bin_add_many (GST_BIN (pipeline), source, demux , parse, filter, decodebin, videoConvert, faceblur, facedetect, videoConvert2, sink, NULL);
-  gst_bin_add_many (GST_BIN (pipeline), source, demux , parse, filter, decodebin, videoConvert, facedetect, videoConvert2, sink, NULL);
-
-   // listen for newly created pads
-  //g_signal_connect(source, "pad-added", G_CALLBACK(on_pad_added),demux );
-  g_signal_connect_object(source, "pad-added", G_CALLBACK(on_pad_added), demux, G_CONNECT_AFTER);
-  //LINK
-// if(!gst_element_link_many(demux , parse, filter, decodebin, videoConvert, faceblur, videoConvert2, sink,NULL))
- if(!gst_element_link_many(demux , parse, filter, decodebin, videoConvert, facedetect, videoConvert2, sink,NULL))
-    printf("\nFailed to link parse to sink");
+static gboolean adapt_latency (gpointer user_data)
+{
+  guint i;
+
+  for (i = 0; i < cameras->len; i++)
+    camera_adapt_latency (g_ptr_array_index (cameras, i), opt_latency_min, opt_latency_max);
+  return TRUE;
+}
+
+#define STALL_CHECK_PERIOD_S 1
+
+static gboolean check_stalls (gpointer user_data)
+{
+  guint i;
+
+  for (i = 0; i < cameras->len; i++)
+    camera_check_stall (g_ptr_array_index (cameras, i));
+  return TRUE;
+}
+
+/* A camera reconnects or restarts on the errors of its own elements, the pipeline and
+ * the other cameras keep running */
+static gboolean camera_error (GstMessage *msg)
+{
+  guint i;
+
+  for (i = 0; i < cameras->len; i++) {
+    if (camera_handle_error (g_ptr_array_index (cameras, i), msg))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* Quit the viewer on the errors no camera handles */
+static void viewer_error_cb (GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+  GError *err;
+  gchar *debug_info;
+
+  if (camera_error (msg))
+    return;
+  gst_message_parse_error (msg, &err, &debug_info);
+  g_printerr ("Error received from element %s: %s\n", GST_OBJECT_NAME (msg->src), err->message);
+  g_printerr ("Debugging information: %s\n", debug_info ? debug_info : "none");
+  g_clear_error (&err);
+  g_free (debug_info);
+
+  gtk_main_quit ();
+}
+
+/* A jitterbuffer changed its latency, share the pipeline's out again */
+static void latency_cb (GstBus *bus, GstMessage *msg, GstElement *pipeline)
+{
+  gst_bin_recalculate_latency (GST_BIN (pipeline));
+}
+
+/* RTSP server of --restream-port, or NULL */
+static Restream *restream = NULL;
+
+/* Text view the viewer shows the reports in, NULL in headless mode */
+static GtkWidget *stats_view = NULL;
+
+static gboolean report_stats (gpointer user_data)
+{
+  GString *text = g_string_new (NULL);
+  GString *json = g_string_new ("{\"cameras\": [");
+  GError *error = NULL;
+  guint i;
+
+  for (i = 0; i < cameras->len; i++) {
+    if (i > 0)
+      g_string_append (json, ", ");
+    camera_report_stats (g_ptr_array_index (cameras, i), text, json);
+  }
+  g_string_append (json, "]}\n");
+
+  g_print ("%s", text->str);
+  if (stats_view)
+    gtk_text_buffer_set_text (gtk_text_view_get_buffer (GTK_TEXT_VIEW (stats_view)),
+        text->str, -1);
+  /* Written to a temporary file and renamed, a reader never sees half a report */
+  if (opt_stats_file && !g_file_set_contents (opt_stats_file, json->str, json->len, &error)) {
+    g_printerr ("Could not write %s: %s\n", opt_stats_file, error->message);
+    g_clear_error (&error);
+  }
+  g_string_free (text, TRUE);
+  g_string_free (json, TRUE);
+
+  if (restream)
+    restream_report_stats (restream);
+  return TRUE;
+}
+
+/* Main loop of the headless mode, which has no GTK one */
+static GMainLoop *headless_loop = NULL;
+static int headless_status = 0;
+
+/* Stop the headless mode on SIGINT and SIGTERM */
+static gboolean headless_quit_cb (gpointer user_data)
+{
+  g_print ("Stopping\n");
+  g_main_loop_quit (headless_loop);
+  return G_SOURCE_CONTINUE;
+}
+
+/* Exit the headless mode on a pipeline error no camera handles, with a failure status
+ * for the service manager to restart us */
+static void headless_error_cb (GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+  GError *err;
+  gchar *debug_info;
+
+  if (camera_error (msg))
+    return;
+  gst_message_parse_error (msg, &err, &debug_info);
+  g_printerr ("Error received from element %s: %s\n", GST_OBJECT_NAME (msg->src), err->message);
+  g_printerr ("Debugging information: %s\n", debug_info ? debug_info : "none");
+  g_clear_error (&err);
+  g_free (debug_info);
+
+  headless_status = -1;
+  g_main_loop_quit (headless_loop);
+}
+
+static void headless_eos_cb (GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+  g_print ("End-Of-Stream reached.\n");
+  g_main_loop_quit (headless_loop);
+}
+
+/* Build the viewer window: one video area per camera on a near-square grid, the
+ * statistics beside them and the redaction buttons below */
+static void create_viewer (GstElement *pipeline)
+{
+  GdkWindow *video_window_xwindow;
+  GtkWidget *window, *video_window;
+  gulong embed_xid;
+  guint i;
 
   /* prepare the ui */
   window = gtk_window_new (GTK_WINDOW_TOPLEVEL);   
@@ -582,26 +808,27 @@ int main(int argc, char *argv[])
 
   GtkWidget *vbox;
   GtkWidget *hbox;
+  GtkWidget *main_hbox;
   vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
   hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+  main_hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 2);
 
   gtk_container_add(GTK_CONTAINER(window), vbox);
 
   /* buttons */
   GtkWidget *button_faceblur_onoff;
-  button_faceblur_onoff = gtk_button_new_with_label ("face HIDE");
+  button_faceblur_onoff = gtk_button_new_with_label ("face SHOW");
   gtk_widget_set_size_request(button_faceblur_onoff, 300, 80);
 
   g_signal_connect (button_faceblur_onoff, "clicked",
-                      G_CALLBACK (button_faceblur_onoff_func), faceblur);
+                      G_CALLBACK (button_faceblur_onoff_func), (gpointer) cameras);
 
   GtkWidget *button_facearea_onoff;
   button_facearea_onoff = gtk_button_new_with_label ("faceArea SHOW");
   gtk_widget_set_size_request(button_facearea_onoff, 300, 80);
 
   g_signal_connect (button_facearea_onoff, "clicked",
-                      G_CALLBACK (button_facearea_onoff_func), (gpointer) facedetect);
-  g_object_set (G_OBJECT (facedetect), "display", 0,NULL);
+                      G_CALLBACK (button_facearea_onoff_func), (gpointer) cameras);
 
 
   GtkWidget *button_numberplateblur_onoff;
@@ -609,12 +836,34 @@ int main(int argc, char *argv[])
   gtk_widget_set_size_request(button_numberplateblur_onoff, 300, 80);
 
   g_signal_connect (button_numberplateblur_onoff, "clicked",
-                      G_CALLBACK (button_numberplateblur_onoff_func), NULL);//(gpointer) image_detect);
-
-  /* video drawing area */
-  video_window = gtk_drawing_area_new ();
+                      G_CALLBACK (button_numberplateblur_onoff_func), (gpointer) cameras);
+
+  /* video drawing areas, one per camera on a near-square grid */
+  GtkWidget *grid;
+  GtkWidget **video_windows = g_new0 (GtkWidget *, cameras->len);
+  guint columns = (guint) ceil (sqrt (cameras->len));
+
+  grid = gtk_grid_new ();
+  gtk_grid_set_row_homogeneous (GTK_GRID (grid), TRUE);
+  gtk_grid_set_column_homogeneous (GTK_GRID (grid), TRUE);
+  gtk_grid_set_row_spacing (GTK_GRID (grid), 2);
+  gtk_grid_set_column_spacing (GTK_GRID (grid), 2);
+  for (i = 0; i < cameras->len; i++) {
+    video_window = gtk_drawing_area_new ();
+    gtk_widget_set_hexpand (video_window, TRUE);
+    gtk_widget_set_vexpand (video_window, TRUE);
+    gtk_grid_attach (GTK_GRID (grid), video_window, i % columns, i / columns, 1, 1);
+    video_windows[i] = video_window;
+  }
   //gtk_container_add (GTK_CONTAINER (window), video_window);
-  gtk_box_pack_start(GTK_BOX(vbox), video_window, TRUE, TRUE, 0);
+  gtk_box_pack_start(GTK_BOX(main_hbox), grid, TRUE, TRUE, 0);
+  if (opt_stats_interval > 0) {
+    stats_view = gtk_text_view_new ();
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (stats_view), FALSE);
+    gtk_text_view_set_monospace (GTK_TEXT_VIEW (stats_view), TRUE);
+    gtk_box_pack_start (GTK_BOX (main_hbox), stats_view, FALSE, FALSE, 2);
+  }
+  gtk_box_pack_start(GTK_BOX(vbox), main_hbox, TRUE, TRUE, 0);
   gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
 
   gtk_box_pack_start(GTK_BOX(hbox), button_faceblur_onoff, TRUE, TRUE, 0);
@@ -624,28 +873,235 @@ int main(int argc, char *argv[])
   gtk_container_set_border_width (GTK_CONTAINER (window), 2);
   gtk_widget_show_all (window);
 
-  video_window_xwindow = gtk_widget_get_window (video_window);
-  embed_xid = GDK_WINDOW_XID (video_window_xwindow);
-  gst_video_overlay_set_window_handle (GST_VIDEO_OVERLAY (sink), embed_xid);
+  for (i = 0; i < cameras->len; i++) {
+    video_window_xwindow = gtk_widget_get_window (video_windows[i]);
+    embed_xid = GDK_WINDOW_XID (video_window_xwindow);
+    camera_set_window_handle (g_ptr_array_index (cameras, i), embed_xid);
+  }
+  g_free (video_windows);
+}
+
+//#gst-launch-1.0 rtspsrc location=rtsp://10.100.100.100:8554/test latency=200 ! decodebin ! videoconvert ! faceblur ! videoconvert ! ximagesink
+int main(int argc, char *argv[])
+{
+  GstStateChangeReturn sret;
+  GstBus *bus;
+  GOptionContext *context;
+  GError *error = NULL;
+  guint cpu_budget;
+  int status = 0;
+
+  gst_init (&argc, &argv);
+
+  /* GTK's options are accepted in either mode, but GTK only connects to the display in
+   * the viewer mode */
+  context = g_option_context_new ("[FILE...] - privacy protecting CCTV viewer");
+  g_option_context_add_main_entries (context, option_entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (FALSE));
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("Option parsing failed: %s\n", error->message);
+    g_clear_error (&error);
+    return -1;
+  }
+  g_option_context_free (context);
+  if (opt_output && !opt_headless) {
+    g_printerr ("--output needs --headless\n");
+    return -1;
+  }
+  if (opt_batch && (argc < 2 || opt_jobs < 0 || opt_cpu_budget < 0)) {
+    g_printerr ("--batch needs the recordings to redact, and a --jobs and --cpu-budget "
+        "that are not negative\n");
+    return -1;
+  }
+  if (!opt_headless && !opt_batch && !gtk_init_check (&argc, &argv)) {
+    g_printerr ("Could not open the display, use --headless to run without one\n");
+    return -1;
+  }
+
+  gst_element_register (NULL, "privacyredact", GST_RANK_NONE, GST_TYPE_PRIVACY_REDACT);
+  if (opt_queue_size < 1) {
+    g_printerr ("--queue-size must be at least 1\n");
+    return -1;
+  }
+  if (opt_detect_scale < 1 || opt_detect_scale > 8) {
+    g_printerr ("--detect-scale must be between 1 and 8\n");
+    return -1;
+  }
+  if (opt_detect_interval < 1 || opt_detect_interval > 300) {
+    g_printerr ("--detect-interval must be between 1 and 300\n");
+    return -1;
+  }
+  if (opt_detect_threads < 0 || opt_detect_threads > 256) {
+    g_printerr ("--detect-threads must be between 0 and 256\n");
+    return -1;
+  }
+  if (opt_roi_margin < 0 || opt_roi_hold < 0) {
+    g_printerr ("--roi-margin and --roi-hold must not be negative\n");
+    return -1;
+  }
+  if (opt_restream_port < 0 || opt_restream_port > 65535) {
+    g_printerr ("--restream-port must be between 0 and 65535\n");
+    return -1;
+  }
+  if (opt_restream_bitrate < 16 || opt_restream_client_queue < 16) {
+    g_printerr ("--restream-bitrate and --restream-client-queue must be at least 16\n");
+    return -1;
+  }
+  if (opt_latency_min > 0 && opt_latency_max == 0)
+    opt_latency_max = MAX (opt_latency_min, 1000);
+  if (opt_latency_min < 0 || opt_latency_max < opt_latency_min ||
+      (opt_latency_max > 0 && opt_latency_min == 0)) {
+    g_printerr ("--latency-max needs a --latency-min of 1 or more, and no smaller\n");
+    return -1;
+  }
+  RedactMode redact_mode = REDACT_PIXELATE;
+  if (g_strcmp0 (opt_redact_mode, "blur") == 0) {
+    redact_mode = REDACT_BLUR;
+  } else if (g_strcmp0 (opt_redact_mode, "integral-blur") == 0) {
+    redact_mode = REDACT_INTEGRAL_BLUR;
+  } else if (g_strcmp0 (opt_redact_mode, "fill") == 0) {
+    redact_mode = REDACT_FILL;
+  } else if (opt_redact_mode && g_strcmp0 (opt_redact_mode, "pixelate") != 0) {
+    g_printerr ("--redact-mode must be pixelate, blur, integral-blur or fill\n");
+    return -1;
+  }
+
+  PipelineConfig config = { opt_pipelined, opt_queue_size, opt_async_detect,
+      opt_roi_margin / 100.0, opt_roi_hold * GST_MSECOND, opt_detect_scale,
+      opt_detect_interval, opt_motion_gate, opt_detect_threads > 0, redact_mode, opt_headless,
+      opt_output, NULL, opt_restream_passthrough, opt_glass_to_glass, opt_low_latency };
+
+  /* Every camera gets its own branch in the one pipeline. The detectors all run their
+   * cascades on OpenCV's process-wide worker pool, instead of one pool per process when
+   * every camera ran in its own player. With --detect-threads they share our own pool
+   * instead, and OpenCV must not start threads of its own inside the pool's workers. */
+  cpu_budget = opt_cpu_budget > 0 ? (guint) opt_cpu_budget : g_get_num_processors ();
+  if (opt_detect_threads > 0) {
+    /* A batch must not detect on more cores than it was given */
+    work_pool_set_shared_size (opt_batch ? MIN ((guint) opt_detect_threads, cpu_budget) :
+        (guint) opt_detect_threads);
+    detector_set_num_threads (0);
+  }
+
+  if (opt_batch)
+    return batch_run (argv + 1, opt_batch, &config, cpu_budget, opt_jobs,
+        opt_summary) ? 0 : -1;
+
+  if (opt_config) {
+    cameras = camera_load_config (opt_config, &error);
+    if (!cameras) {
+      g_printerr ("Could not load %s: %s\n", opt_config, error->message);
+      g_clear_error (&error);
+      return -1;
+    }
+  } else {
+    cameras = g_ptr_array_new_with_free_func ((GDestroyNotify) camera_free);
+    g_ptr_array_add (cameras, camera_new ("cctv", CAMERA_DEFAULT_LOCATION, CAMERA_DEFAULT_LATENCY));
+  }
+
+  GstElement *pipeline;
+  MetricsServer *metrics = NULL;
+  guint i;
+
+  /* The adaptive mode starts each camera from its configured latency, within the bounds */
+  for (i = 0; opt_latency_min > 0 && i < cameras->len; i++) {
+    Camera *camera = g_ptr_array_index (cameras, i);
+
+    camera->latency = CLAMP (camera->latency, (guint) opt_latency_min, (guint) opt_latency_max);
+  }
+
+  if (opt_restream_port > 0) {
+    restream = restream_new (opt_restream_port, opt_restream_bitrate,
+        opt_restream_client_queue * 1024, opt_restream_passthrough, &error);
+    if (!restream) {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return -1;
+    }
+    config.restream = restream;
+  }
+  pipeline = gst_pipeline_new ("cctv player");
+  for (i = 0; i < cameras->len; i++) {
+    if (!camera_build (g_ptr_array_index (cameras, i), GST_BIN (pipeline), &config)) {
+      gst_object_unref (pipeline);
+      return -1;
+    }
+  }
+
+  if (opt_metrics) {
+    metrics = metrics_server_new (opt_metrics, cameras, &error);
+    if (!metrics) {
+      g_printerr ("Could not serve the metrics on %s: %s\n", opt_metrics, error->message);
+      g_clear_error (&error);
+      gst_object_unref (pipeline);
+      return -1;
+    }
+  }
+
+  if ((opt_stats_interval > 0 || metrics) && (opt_pipelined || opt_async_detect))
+    g_timeout_add (QUEUE_SAMPLE_PERIOD_MS, sample_queue_stats, NULL);
+  if (opt_stats_interval > 0)
+    g_timeout_add_seconds (opt_stats_interval, report_stats, NULL);
+  if (opt_latency_min > 0)
+    g_timeout_add_seconds (LATENCY_ADAPT_PERIOD_S, adapt_latency, NULL);
+  g_timeout_add_seconds (STALL_CHECK_PERIOD_S, check_stalls, NULL);
+
+  if (!opt_headless)
+    create_viewer (pipeline);
 
   /* Instruct the bus to emit signals for each received message, and connect to the interesting signals */
   bus = gst_element_get_bus (pipeline);
   gst_bus_add_signal_watch (bus);
-  //g_signal_connect (G_OBJECT (bus), "message::error", (GCallback)error_cb, &data);
-  g_signal_connect (G_OBJECT (bus), "message::eos", (GCallback)eos_cb, &pipeline);
-  //g_signal_connect (G_OBJECT (bus), "message::state-changed", (GCallback)state_changed_cb, &data);
-  //g_signal_connect (G_OBJECT (bus), "message::application", (GCallback)application_cb, &data);
+  g_signal_connect (G_OBJECT (bus), "message::latency", (GCallback) latency_cb, pipeline);
+  if (opt_headless) {
+    headless_loop = g_main_loop_new (NULL, FALSE);
+    g_signal_connect (G_OBJECT (bus), "message::error", (GCallback) headless_error_cb, NULL);
+    g_signal_connect (G_OBJECT (bus), "message::eos", (GCallback) headless_eos_cb, NULL);
+    g_unix_signal_add (SIGINT, headless_quit_cb, NULL);
+    g_unix_signal_add (SIGTERM, headless_quit_cb, NULL);
+  } else {
+    g_signal_connect (G_OBJECT (bus), "message::error", (GCallback) viewer_error_cb, NULL);
+    g_signal_connect (G_OBJECT (bus), "message::eos", (GCallback)eos_cb, &pipeline);
+    //g_signal_connect (G_OBJECT (bus), "message::state-changed", (GCallback)state_changed_cb, &data);
+    //g_signal_connect (G_OBJECT (bus), "message::application", (GCallback)application_cb, &data);
+  }
   gst_object_unref (bus);
   
   /* run the pipeline */
   sret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
-  if (sret == GST_STATE_CHANGE_FAILURE)
-    gst_element_set_state (pipeline, GST_STATE_NULL);
-  else
+  if (sret == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("Unable to set the pipeline to the playing state.\n");
+    status = -1;
+  } else if (opt_headless) {
+    g_main_loop_run (headless_loop);
+    status = headless_status;
+  } else
     gtk_main ();
 
+  /* Send EOS first so a headless output can finish its file */
+  if (opt_headless && opt_output && sret != GST_STATE_CHANGE_FAILURE && status == 0) {
+    GstMessage *msg;
+
+    for (i = 0; i < cameras->len; i++)
+      camera_finish (g_ptr_array_index (cameras, i));
+    gst_element_send_event (pipeline, gst_event_new_eos ());
+    bus = gst_element_get_bus (pipeline);
+    msg = gst_bus_timed_pop_filtered (bus, 5 * GST_SECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (msg)
+      gst_message_unref (msg);
+    gst_object_unref (bus);
+  }
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  /* Before the cameras it reads go away */
+  if (metrics)
+    metrics_server_free (metrics);
+  if (headless_loop)
+    g_main_loop_unref (headless_loop);
   gst_object_unref (pipeline);
+  if (restream)
+    restream_free (restream);
+  g_ptr_array_unref (cameras);
 
 
-return 0;
+return status;
 }
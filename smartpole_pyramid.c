@@ -0,0 +1,81 @@
+#include <string.h>
+
+#include "smartpole_kernels.h"
+#include "smartpole_pyramid.h"
+
+struct _LumaPyramid {
+  LumaPlane levels[PYRAMID_MAX_SCALE];  /* Indexed by scale - 1 */
+  gboolean valid[PYRAMID_MAX_SCALE];    /* Level computed for the current frame */
+  guint8 *buffers[PYRAMID_MAX_SCALE];
+  gsize sizes[PYRAMID_MAX_SCALE];
+};
+
+/* Describe the full resolution plane at @gray */
+void luma_plane_init (LumaPlane *plane, const guint8 *gray, gint width, gint height,
+    gint stride)
+{
+  plane->data = gray;
+  plane->width = width;
+  plane->height = height;
+  plane->stride = stride;
+  plane->scale = 1;
+  plane->frame_width = width;
+  plane->frame_height = height;
+}
+
+LumaPyramid *luma_pyramid_new (void)
+{
+  return g_new0 (LumaPyramid, 1);
+}
+
+void luma_pyramid_free (LumaPyramid *pyramid)
+{
+  guint i;
+
+  for (i = 0; i < PYRAMID_MAX_SCALE; i++)
+    g_free (pyramid->buffers[i]);
+  g_free (pyramid);
+}
+
+/* Start a new frame. @gray must stay valid until the next call. */
+void luma_pyramid_set_frame (LumaPyramid *pyramid, const guint8 *gray, gint width,
+    gint height, gint stride)
+{
+  luma_plane_init (&pyramid->levels[0], gray, width, height, stride);
+  pyramid->valid[0] = TRUE;
+  memset (pyramid->valid + 1, 0, sizeof (pyramid->valid) - sizeof (pyramid->valid[0]));
+}
+
+/* Get the plane of the current frame downscaled by @scale, from 1 to PYRAMID_MAX_SCALE */
+const LumaPlane *luma_pyramid_get (LumaPyramid *pyramid, guint scale)
+{
+  const LumaPlane *base = &pyramid->levels[0];
+  LumaPlane *level;
+  gsize size;
+
+  g_return_val_if_fail (scale >= 1 && scale <= PYRAMID_MAX_SCALE, base);
+
+  level = &pyramid->levels[scale - 1];
+  if (pyramid->valid[scale - 1])
+    return level;
+
+  level->width = base->width / scale;
+  level->height = base->height / scale;
+  level->stride = level->width;
+  level->scale = scale;
+  level->frame_width = base->width;
+  level->frame_height = base->height;
+
+  size = (gsize) level->width * level->height;
+  if (pyramid->sizes[scale - 1] < size) {
+    g_free (pyramid->buffers[scale - 1]);
+    pyramid->buffers[scale - 1] = g_malloc (size);
+    pyramid->sizes[scale - 1] = size;
+  }
+  kernel_downscale_luma (base->data, base->stride, base->width, base->height, scale,
+      pyramid->buffers[scale - 1], level->stride);
+  level->data = pyramid->buffers[scale - 1];
+  pyramid->valid[scale - 1] = TRUE;
+
+  return level;
+}
@@ -0,0 +1,38 @@
+#ifndef __SMARTPOLE_PYRAMID_H__
+#define __SMARTPOLE_PYRAMID_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define PYRAMID_MAX_SCALE 8
+
+/* A luma plane of a frame, possibly downscaled by an integer factor */
+typedef struct _LumaPlane {
+  const guint8 *data;
+  gint width;
+  gint height;
+  gint stride;
+  guint scale;              /* Frame pixels per plane pixel along each axis */
+  gint frame_width;         /* Size of the frame the plane was made from */
+  gint frame_height;
+} LumaPlane;
+
+/* The luma plane of the current frame and the downscaled copies of it the detectors ask
+ * for. Each copy is made once per frame on first use, so face and plate detection
+ * working at the same scale share it. */
+typedef struct _LumaPyramid LumaPyramid;
+
+LumaPyramid *luma_pyramid_new (void);
+void luma_pyramid_free (LumaPyramid *pyramid);
+
+void luma_pyramid_set_frame (LumaPyramid *pyramid, const guint8 *gray, gint width,
+    gint height, gint stride);
+const LumaPlane *luma_pyramid_get (LumaPyramid *pyramid, guint scale);
+
+void luma_plane_init (LumaPlane *plane, const guint8 *gray, gint width, gint height,
+    gint stride);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_PYRAMID_H__ */
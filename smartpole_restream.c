@@ -0,0 +1,590 @@
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/rtsp-server/rtsp-server.h>
+#include <gst/video/video.h>
+
+#include "smartpole_restream.h"
+
+/* Frames between two keyframes when no client asks for one */
+#define RESTREAM_KEY_INT_MAX 60
+/* Shortest time between two keyframes requested by joining or lagging clients, in us */
+#define RESTREAM_KEYFRAME_PERIOD (500 * G_TIME_SPAN_MILLISECOND)
+/* Frames held by the passthrough mode on either side before it gives up on a GOP */
+#define RESTREAM_MAX_HELD_FRAMES 600
+
+/* The RTSP media of one client: it payloads the frames pushed to its appsrc */
+#define RESTREAM_LAUNCH "( appsrc name=src ! rtph264pay name=pay0 pt=96 config-interval=-1 )"
+/* What the clients get, from the encoder or straight from the camera. The parameter sets
+ * travel in-band, so the stream may switch between the two at any keyframe. */
+#define RESTREAM_CAPS "video/x-h264, stream-format=byte-stream, alignment=au"
+
+typedef struct _RestreamFeed RestreamFeed;
+
+/* One connected client of a feed */
+typedef struct _RestreamClient {
+  RestreamFeed *feed;
+  GstElement *src;          /* appsrc of the client's media */
+  gboolean need_keyframe;   /* Drop frames until the next keyframe */
+  GstClockTimeDiff offset;  /* Camera timestamp to client running time, once known */
+  gboolean have_offset;
+  guint64 dropped;          /* Frames dropped since the last report */
+} RestreamClient;
+
+/* A GOP of the passthrough mode waiting for its turn to go out. A passed through GOP
+ * holds its access units, a re-encoded one waits for the encoder to return the frame
+ * with @last_pts. */
+typedef struct _RestreamGop {
+  gboolean encode;
+  GQueue units;             /* GstBuffer, the camera's access units */
+  GstClockTime last_pts;
+} RestreamGop;
+
+/* The encoded stream of one camera */
+struct _RestreamFeed {
+  Restream *restream;
+  gchar *name;
+  GstElement *valve;        /* Drops the frames in front of the encoder while nobody watches */
+  GstElement *encode_src;   /* appsrc feeding the encoder in passthrough mode */
+  GstElement *sink;         /* appsink at the end of the encoder */
+
+  GMutex lock;
+  GPtrArray *clients;       /* RestreamClient, under @lock */
+  gint64 keyframe_time;     /* Monotonic time of the last keyframe request, under @lock */
+  guint64 frames;           /* Frames encoded since the last report, under @lock */
+  guint64 passed;           /* Frames passed through since the last report, under @lock */
+  guint64 dropped;          /* Frames dropped by clients that went away, under @lock */
+
+  /* Passthrough mode, under @lock */
+  GQueue units;             /* GstBuffer, access units of the GOPs not decided yet */
+  GQueue frames_in;         /* GstBuffer, redacted frames of those GOPs */
+  GstClockTime raw_pts;     /* Latest PTS seen on the redacted frames */
+  GstCaps *raw_caps;        /* Caps of @frames_in, as set on @encode_src */
+  GQueue gops;              /* RestreamGop decided but not sent yet, oldest first */
+};
+
+struct _Restream {
+  GstRTSPServer *server;
+  guint source_id;
+  guint bitrate;            /* Encoder bitrate, in kbit/s */
+  guint client_queue;       /* Bytes a client may lag behind before it drops frames */
+  gboolean passthrough;     /* Forward the camera's GOPs that need no redaction */
+  GPtrArray *feeds;         /* RestreamFeed */
+};
+
+static void restream_gop_free (RestreamGop *gop)
+{
+  g_queue_clear_full (&gop->units, (GDestroyNotify) gst_buffer_unref);
+  g_free (gop);
+}
+
+/* Forget the GOPs of the passthrough mode, called with the feed lock */
+static void restream_feed_reset (RestreamFeed *feed)
+{
+  g_queue_clear_full (&feed->units, (GDestroyNotify) gst_buffer_unref);
+  g_queue_clear_full (&feed->frames_in, (GDestroyNotify) gst_buffer_unref);
+  g_queue_clear_full (&feed->gops, (GDestroyNotify) restream_gop_free);
+  feed->raw_pts = GST_CLOCK_TIME_NONE;
+}
+
+static void restream_feed_free (RestreamFeed *feed)
+{
+  restream_feed_reset (feed);
+  gst_clear_caps (&feed->raw_caps);
+  g_ptr_array_unref (feed->clients);
+  g_mutex_clear (&feed->lock);
+  g_free (feed->name);
+  g_free (feed);
+}
+
+/* Start the RTSP server on @port of every interface, on the default main context. The
+ * cameras are encoded at @bitrate kbit/s and a client more than @client_queue bytes
+ * behind drops frames up to the next keyframe. With @passthrough the GOPs of the camera
+ * without anything to redact are forwarded as they are instead of being re-encoded. */
+Restream *restream_new (guint port, guint bitrate, guint client_queue, gboolean passthrough,
+    GError **error)
+{
+  Restream *restream = g_new0 (Restream, 1);
+  gchar *service = g_strdup_printf ("%u", port);
+
+  restream->server = gst_rtsp_server_new ();
+  gst_rtsp_server_set_service (restream->server, service);
+  g_free (service);
+  restream->bitrate = bitrate;
+  restream->client_queue = client_queue;
+  restream->passthrough = passthrough;
+  restream->feeds = g_ptr_array_new_with_free_func ((GDestroyNotify) restream_feed_free);
+
+  restream->source_id = gst_rtsp_server_attach (restream->server, NULL);
+  if (restream->source_id == 0) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+        "Could not start the RTSP server on port %u", port);
+    restream_free (restream);
+    return NULL;
+  }
+
+  return restream;
+}
+
+static GstRTSPFilterResult remove_client (GstRTSPServer *server, GstRTSPClient *client,
+    gpointer user_data)
+{
+  return GST_RTSP_FILTER_REMOVE;
+}
+
+/* Disconnect every client and stop the server. The camera pipeline must be stopped
+ * first. */
+void restream_free (Restream *restream)
+{
+  if (restream->source_id)
+    g_source_remove (restream->source_id);
+  gst_rtsp_server_client_filter (restream->server, remove_client, NULL);
+  g_object_unref (restream->server);
+  g_ptr_array_unref (restream->feeds);
+  g_free (restream);
+}
+
+/* Ask the encoder for a keyframe, at most once per RESTREAM_KEYFRAME_PERIOD. Called
+ * with the feed lock. */
+static void request_keyframe (RestreamFeed *feed)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  if (now - feed->keyframe_time < RESTREAM_KEYFRAME_PERIOD)
+    return;
+  feed->keyframe_time = now;
+  gst_element_send_event (feed->sink,
+      gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE, TRUE, 0));
+}
+
+/* Push @buffer to @client, moved from the camera's timeline to the running time of the
+ * client's own pipeline. The first frame is due right away, the later ones keep their
+ * spacing. */
+static void client_push (RestreamClient *client, GstBuffer *buffer)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+
+  if (!client->have_offset && GST_CLOCK_TIME_IS_VALID (pts)) {
+    GstClock *clock = gst_element_get_clock (client->src);
+    GstClockTime now = 0;
+
+    if (clock) {
+      now = gst_clock_get_time (clock) - gst_element_get_base_time (client->src);
+      gst_object_unref (clock);
+    }
+    client->offset = GST_CLOCK_DIFF (pts, now);
+    client->have_offset = TRUE;
+  }
+
+  buffer = gst_buffer_copy (buffer);
+  if (GST_CLOCK_TIME_IS_VALID (pts))
+    GST_BUFFER_PTS (buffer) = MAX (0, (GstClockTimeDiff) pts + client->offset);
+  if (GST_BUFFER_DTS_IS_VALID (buffer))
+    GST_BUFFER_DTS (buffer) = MAX (0, (GstClockTimeDiff) GST_BUFFER_DTS (buffer) + client->offset);
+  gst_app_src_push_buffer (GST_APP_SRC (client->src), buffer);
+}
+
+/* Hand an access unit to every client of the feed, called with the feed lock. This
+ * never blocks: a client whose queue is full loses frames up to the next keyframe, so
+ * its decoder restarts cleanly and the others are not held up. */
+static void feed_push (RestreamFeed *feed, GstBuffer *buffer, gboolean encoded)
+{
+  Restream *restream = feed->restream;
+  gboolean keyframe = !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  guint i;
+
+  if (encoded)
+    feed->frames++;
+  else
+    feed->passed++;
+  for (i = 0; i < feed->clients->len; i++) {
+    RestreamClient *client = g_ptr_array_index (feed->clients, i);
+
+    if (gst_app_src_get_current_level_bytes (GST_APP_SRC (client->src)) >
+        restream->client_queue) {
+      client->need_keyframe = TRUE;
+      client->dropped++;
+      continue;
+    }
+    if (client->need_keyframe) {
+      if (!keyframe) {
+        client->dropped++;
+        if (encoded)
+          request_keyframe (feed);
+        continue;
+      }
+      client->need_keyframe = FALSE;
+    }
+    client_push (client, buffer);
+  }
+}
+
+/* Send the passed through GOPs at the head of the queue, up to the first one still
+ * being re-encoded. Called with the feed lock. */
+static void flush_gops (RestreamFeed *feed)
+{
+  RestreamGop *gop;
+
+  while ((gop = g_queue_peek_head (&feed->gops)) && !gop->encode) {
+    GstBuffer *unit;
+
+    while ((unit = g_queue_pop_head (&gop->units))) {
+      feed_push (feed, unit, FALSE);
+      gst_buffer_unref (unit);
+    }
+    restream_gop_free (g_queue_pop_head (&feed->gops));
+  }
+}
+
+static gboolean has_roi_meta (GstBuffer *buffer)
+{
+  gpointer state = NULL;
+
+  return gst_buffer_iterate_meta_filtered (buffer, &state,
+      GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE) != NULL;
+}
+
+/* Decide the oldest GOP once both its access units and its redacted frames are in.
+ * The GOP is complete when the next keyframe arrived, its frames when a frame at least
+ * as late as its last one was redacted. A GOP where no frame carries a face or plate
+ * ROI goes out as the camera sent it, any other one is re-encoded from the redacted
+ * frames. Called with the feed lock. */
+static void decide_gops (RestreamFeed *feed)
+{
+  for (;;) {
+    GstClockTime first_pts = GST_CLOCK_TIME_NONE, last_pts = 0;
+    RestreamGop *gop;
+    GstBuffer *unit, *frame;
+    guint n_units = 0, n_frames = 0;
+    GList *l;
+
+    /* Drop what precedes the first keyframe, nothing can be decoded from it */
+    while ((unit = g_queue_peek_head (&feed->units)) &&
+        GST_BUFFER_FLAG_IS_SET (unit, GST_BUFFER_FLAG_DELTA_UNIT))
+      gst_buffer_unref (g_queue_pop_head (&feed->units));
+    if (!unit)
+      return;
+
+    for (l = feed->units.head; l; l = l->next) {
+      GstClockTime pts = GST_BUFFER_PTS (l->data);
+
+      if (n_units > 0 && !GST_BUFFER_FLAG_IS_SET (l->data, GST_BUFFER_FLAG_DELTA_UNIT))
+        break;
+      n_units++;
+      if (GST_CLOCK_TIME_IS_VALID (pts)) {
+        first_pts = MIN (first_pts, pts);
+        last_pts = MAX (last_pts, pts);
+      }
+    }
+    if (!l || !GST_CLOCK_TIME_IS_VALID (feed->raw_pts) || feed->raw_pts < last_pts) {
+      /* A stalled decoder must not make the GOPs pile up */
+      if (feed->units.length > RESTREAM_MAX_HELD_FRAMES) {
+        while (n_units--)
+          gst_buffer_unref (g_queue_pop_head (&feed->units));
+        continue;
+      }
+      return;
+    }
+
+    gop = g_new0 (RestreamGop, 1);
+    while (n_units--)
+      g_queue_push_tail (&gop->units, g_queue_pop_head (&feed->units));
+    for (l = feed->frames_in.head; l; l = l->next) {
+      GstClockTime pts = GST_BUFFER_PTS (l->data);
+
+      if (pts > last_pts)
+        break;
+      if (pts >= first_pts) {
+        n_frames++;
+        if (has_roi_meta (l->data))
+          gop->encode = TRUE;
+      }
+    }
+    /* Without a single redacted frame nothing says the GOP is safe to pass */
+    if (n_frames == 0) {
+      restream_gop_free (gop);
+      continue;
+    }
+
+    /* The frames before the GOP belong to an earlier one that was given up on. The
+     * encoder starts over from a keyframe with the first frame of the GOP, and the GOP
+     * is done with the last frame it is given. */
+    gop->last_pts = GST_CLOCK_TIME_NONE;
+    while ((frame = g_queue_peek_head (&feed->frames_in)) && GST_BUFFER_PTS (frame) <= last_pts) {
+      frame = g_queue_pop_head (&feed->frames_in);
+      if (gop->encode && GST_BUFFER_PTS (frame) >= first_pts) {
+        if (!GST_CLOCK_TIME_IS_VALID (gop->last_pts))
+          gst_element_send_event (feed->encode_src,
+              gst_video_event_new_downstream_force_key_unit (GST_BUFFER_PTS (frame),
+                  GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE, TRUE, 0));
+        gop->last_pts = GST_BUFFER_PTS (frame);
+        gst_app_src_push_buffer (GST_APP_SRC (feed->encode_src), frame);
+      } else
+        gst_buffer_unref (frame);
+    }
+    if (gop->encode) {
+      /* The camera's own access units of a GOP with something to redact never go out */
+      g_queue_clear_full (&gop->units, (GDestroyNotify) gst_buffer_unref);
+      if (!GST_CLOCK_TIME_IS_VALID (gop->last_pts)) {
+        restream_gop_free (gop);
+        continue;
+      }
+    }
+    g_queue_push_tail (&feed->gops, gop);
+    flush_gops (feed);
+  }
+}
+
+/* An access unit of the camera, straight from its h264parse */
+static GstFlowReturn unit_sample_cb (GstAppSink *sink, gpointer user_data)
+{
+  RestreamFeed *feed = user_data;
+  GstSample *sample = gst_app_sink_pull_sample (sink);
+
+  if (!sample)
+    return GST_FLOW_EOS;
+  g_mutex_lock (&feed->lock);
+  if (feed->clients->len > 0) {
+    g_queue_push_tail (&feed->units, gst_buffer_ref (gst_sample_get_buffer (sample)));
+    decide_gops (feed);
+  }
+  g_mutex_unlock (&feed->lock);
+  gst_sample_unref (sample);
+
+  return GST_FLOW_OK;
+}
+
+/* A redacted frame of the camera, held until the GOP it belongs to is decided */
+static GstFlowReturn frame_sample_cb (GstAppSink *sink, gpointer user_data)
+{
+  RestreamFeed *feed = user_data;
+  GstSample *sample = gst_app_sink_pull_sample (sink);
+  GstBuffer *buffer;
+  GstCaps *caps;
+
+  if (!sample)
+    return GST_FLOW_EOS;
+  buffer = gst_sample_get_buffer (sample);
+  caps = gst_sample_get_caps (sample);
+
+  g_mutex_lock (&feed->lock);
+  if (feed->clients->len > 0 && GST_BUFFER_PTS_IS_VALID (buffer)) {
+    if (caps && !(feed->raw_caps && gst_caps_is_equal (caps, feed->raw_caps))) {
+      gst_caps_replace (&feed->raw_caps, caps);
+      gst_app_src_set_caps (GST_APP_SRC (feed->encode_src), caps);
+    }
+    g_queue_push_tail (&feed->frames_in, gst_buffer_ref (buffer));
+    if (feed->frames_in.length > RESTREAM_MAX_HELD_FRAMES)
+      gst_buffer_unref (g_queue_pop_head (&feed->frames_in));
+    feed->raw_pts = GST_BUFFER_PTS (buffer);
+    decide_gops (feed);
+  }
+  g_mutex_unlock (&feed->lock);
+  gst_sample_unref (sample);
+
+  return GST_FLOW_OK;
+}
+
+/* An access unit out of the encoder. In passthrough mode it belongs to the oldest GOP
+ * still queued, which is done with the frame of its last timestamp. */
+static GstFlowReturn encoded_sample_cb (GstAppSink *sink, gpointer user_data)
+{
+  RestreamFeed *feed = user_data;
+  GstSample *sample = gst_app_sink_pull_sample (sink);
+  GstBuffer *buffer;
+  RestreamGop *gop;
+
+  if (!sample)
+    return GST_FLOW_EOS;
+  buffer = gst_sample_get_buffer (sample);
+
+  g_mutex_lock (&feed->lock);
+  if (!feed->encode_src) {
+    feed_push (feed, buffer, TRUE);
+  } else if ((gop = g_queue_peek_head (&feed->gops)) && gop->encode) {
+    feed_push (feed, buffer, TRUE);
+    if (GST_BUFFER_PTS (buffer) >= gop->last_pts) {
+      restream_gop_free (g_queue_pop_head (&feed->gops));
+      flush_gops (feed);
+    }
+  }
+  g_mutex_unlock (&feed->lock);
+  gst_sample_unref (sample);
+
+  return GST_FLOW_OK;
+}
+
+static void media_unprepared_cb (GstRTSPMedia *media, RestreamClient *client)
+{
+  RestreamFeed *feed = client->feed;
+
+  g_mutex_lock (&feed->lock);
+  g_ptr_array_remove_fast (feed->clients, client);
+  feed->dropped += client->dropped;
+  if (feed->clients->len == 0) {
+    if (feed->valve)
+      g_object_set (G_OBJECT (feed->valve), "drop", TRUE, NULL);
+    restream_feed_reset (feed);
+  }
+  g_mutex_unlock (&feed->lock);
+
+  gst_object_unref (client->src);
+  g_free (client);
+}
+
+/* A client connected: hook the appsrc of its media to the feed. It starts at the next
+ * keyframe, which is requested right away. */
+static void media_configure_cb (GstRTSPMediaFactory *factory, GstRTSPMedia *media,
+    RestreamFeed *feed)
+{
+  GstElement *element = gst_rtsp_media_get_element (media);
+  RestreamClient *client = g_new0 (RestreamClient, 1);
+  GstCaps *caps = gst_caps_from_string (RESTREAM_CAPS);
+
+  client->feed = feed;
+  client->src = gst_bin_get_by_name_recurse_up (GST_BIN (element), "src");
+  client->need_keyframe = TRUE;
+  gst_object_unref (element);
+  /* The queue is bounded by feed_push(), appsrc itself must never block the encoder */
+  g_object_set (G_OBJECT (client->src), "format", GST_FORMAT_TIME, "is-live", TRUE,
+      "caps", caps, "block", FALSE, "max-bytes", (guint64) 0, NULL);
+  gst_caps_unref (caps);
+
+  g_mutex_lock (&feed->lock);
+  g_ptr_array_add (feed->clients, client);
+  if (feed->valve)
+    g_object_set (G_OBJECT (feed->valve), "drop", FALSE, NULL);
+  request_keyframe (feed);
+  g_mutex_unlock (&feed->lock);
+
+  g_signal_connect (media, "unprepared", G_CALLBACK (media_unprepared_cb), client);
+}
+
+/* Make an appsink calling @func for every sample. Most of the time nothing reaches it,
+ * it must not hold up preroll. */
+static GstElement *make_app_sink (const gchar *caps_string,
+    GstFlowReturn (*func) (GstAppSink *, gpointer), RestreamFeed *feed)
+{
+  GstElement *sink = gst_element_factory_make ("appsink", NULL);
+  GstAppSinkCallbacks callbacks = { NULL, NULL, func };
+  GstCaps *caps = gst_caps_from_string (caps_string);
+
+  g_assert (sink);
+  g_object_set (G_OBJECT (sink), "caps", caps, "sync", FALSE, "async", FALSE, NULL);
+  gst_caps_unref (caps);
+  gst_app_sink_set_callbacks (GST_APP_SINK (sink), &callbacks, feed, NULL);
+
+  return sink;
+}
+
+/* A queue decoupling a branch of the feed from the camera, dropping the oldest frames
+ * rather than ever blocking it */
+static GstElement *make_leaky_queue (guint max_buffers)
+{
+  GstElement *queue = gst_element_factory_make ("queue", NULL);
+
+  g_assert (queue);
+  g_object_set (G_OBJECT (queue), "max-size-buffers", max_buffers, "max-size-bytes", (guint) 0,
+      "max-size-time", (guint64) 0, "leaky", 2, NULL);
+  return queue;
+}
+
+/* Add the branches of camera @name to @bin and mount its stream at /@name. Returns the
+ * first element of the branch to be linked to the camera's redacted I420 frames. In
+ * passthrough mode @units is set to the first element of a second branch, to be linked
+ * to the access units out of the camera's h264parse, and NULL otherwise. The branches
+ * sit behind leaky queues and never slow the camera down, and they only encode while a
+ * client is connected. */
+GstElement *restream_add_camera (Restream *restream, const gchar *name, GstBin *bin,
+    GstElement **units)
+{
+  RestreamFeed *feed = g_new0 (RestreamFeed, 1);
+  GstElement *queue, *encoder, *frame_sink, *unit_queue, *unit_sink;
+  GstRTSPMountPoints *mounts;
+  GstRTSPMediaFactory *factory;
+  gchar *path;
+
+  feed->restream = restream;
+  feed->name = g_strdup (name);
+  feed->clients = g_ptr_array_new ();
+  feed->raw_pts = GST_CLOCK_TIME_NONE;
+  g_mutex_init (&feed->lock);
+  g_ptr_array_add (restream->feeds, feed);
+  *units = NULL;
+
+  encoder = gst_element_factory_make ("x264enc", NULL); g_assert (encoder);
+  gst_util_set_object_arg (G_OBJECT (encoder), "tune", "zerolatency");
+  gst_util_set_object_arg (G_OBJECT (encoder), "speed-preset", "veryfast");
+  g_object_set (G_OBJECT (encoder), "bitrate", restream->bitrate, "key-int-max",
+      RESTREAM_KEY_INT_MAX, "byte-stream", TRUE, NULL);
+  feed->sink = make_app_sink (RESTREAM_CAPS, encoded_sample_cb, feed);
+
+  if (!restream->passthrough) {
+    /* Every redacted frame goes through the encoder */
+    queue = make_leaky_queue (2);
+    feed->valve = gst_element_factory_make ("valve", NULL); g_assert (feed->valve);
+    g_object_set (G_OBJECT (feed->valve), "drop", TRUE, NULL);
+    gst_bin_add_many (bin, queue, feed->valve, encoder, feed->sink, NULL);
+    if (!gst_element_link_many (queue, feed->valve, encoder, feed->sink, NULL))
+      return NULL;
+  } else {
+    /* The redacted frames and the camera's access units are held side by side for one
+     * GOP, then either the access units or the re-encoded frames go out. The queues
+     * hold a little more than a GOP, since the frames lag behind the access units by
+     * the decode and detection time. */
+    queue = make_leaky_queue (RESTREAM_MAX_HELD_FRAMES);
+    frame_sink = make_app_sink ("video/x-raw", frame_sample_cb, feed);
+    unit_queue = make_leaky_queue (RESTREAM_MAX_HELD_FRAMES);
+    unit_sink = make_app_sink (RESTREAM_CAPS, unit_sample_cb, feed);
+    feed->encode_src = gst_element_factory_make ("appsrc", NULL); g_assert (feed->encode_src);
+    g_object_set (G_OBJECT (feed->encode_src), "format", GST_FORMAT_TIME, "block", FALSE,
+        "max-bytes", (guint64) 0, NULL);
+    gst_bin_add_many (bin, queue, frame_sink, unit_queue, unit_sink, feed->encode_src, encoder,
+        feed->sink, NULL);
+    if (!gst_element_link (queue, frame_sink) || !gst_element_link (unit_queue, unit_sink) ||
+        !gst_element_link_many (feed->encode_src, encoder, feed->sink, NULL))
+      return NULL;
+    *units = unit_queue;
+  }
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_launch (factory, RESTREAM_LAUNCH);
+  gst_rtsp_media_factory_set_shared (factory, FALSE);
+  g_signal_connect (factory, "media-configure", G_CALLBACK (media_configure_cb), feed);
+  mounts = gst_rtsp_server_get_mount_points (restream->server);
+  path = g_strdup_printf ("/%s", name);
+  gst_rtsp_mount_points_add_factory (mounts, path, factory);
+  g_print ("%s: re-streamed at rtsp://127.0.0.1:%d%s\n", name,
+      gst_rtsp_server_get_bound_port (restream->server), path);
+  g_free (path);
+  g_object_unref (mounts);
+
+  return queue;
+}
+
+/* Print and reset the number of clients of every feed, the frames they got encoded and
+ * passed through, and the frames they dropped */
+void restream_report_stats (Restream *restream)
+{
+  guint i, j;
+
+  for (i = 0; i < restream->feeds->len; i++) {
+    RestreamFeed *feed = g_ptr_array_index (restream->feeds, i);
+    guint64 dropped;
+
+    g_mutex_lock (&feed->lock);
+    dropped = feed->dropped;
+    feed->dropped = 0;
+    for (j = 0; j < feed->clients->len; j++) {
+      RestreamClient *client = g_ptr_array_index (feed->clients, j);
+
+      dropped += client->dropped;
+      client->dropped = 0;
+    }
+    g_print ("restream %s: %u clients, %" G_GUINT64_FORMAT " frames encoded, %"
+        G_GUINT64_FORMAT " passed through, %" G_GUINT64_FORMAT " dropped by lagging clients\n",
+        feed->name, feed->clients->len, feed->frames, feed->passed, dropped);
+    feed->frames = 0;
+    feed->passed = 0;
+    g_mutex_unlock (&feed->lock);
+  }
+}
@@ -0,0 +1,25 @@
+#ifndef __SMARTPOLE_RESTREAM_H__
+#define __SMARTPOLE_RESTREAM_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* An RTSP server re-streaming the redacted video of every camera at
+ * rtsp://HOST:PORT/NAME. Each camera is encoded once, whatever the number of clients,
+ * and every client gets the same encoded frames through a queue of its own. In
+ * passthrough mode only the GOPs with something to redact are encoded, the others go
+ * out as the camera sent them. */
+typedef struct _Restream Restream;
+
+Restream *restream_new (guint port, guint bitrate, guint client_queue, gboolean passthrough,
+    GError **error);
+void restream_free (Restream *restream);
+
+GstElement *restream_add_camera (Restream *restream, const gchar *name, GstBin *bin,
+    GstElement **units);
+void restream_report_stats (Restream *restream);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_RESTREAM_H__ */
@@ -0,0 +1,235 @@
+#include <string.h>
+
+#include "smartpole_kernels.h"
+#include "smartpole_roi.h"
+
+void roi_store_init (RoiStore *store, gdouble margin, GstClockTime hold)
+{
+  guint i;
+
+  g_mutex_init (&store->lock);
+  for (i = 0; i < ROI_STORE_DEPTH; i++) {
+    store->entries[i].pts = GST_CLOCK_TIME_NONE;
+    store->entries[i].rects = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  }
+  store->next = 0;
+  store->margin = margin;
+  store->hold = hold;
+}
+
+void roi_store_clear (RoiStore *store)
+{
+  guint i;
+
+  for (i = 0; i < ROI_STORE_DEPTH; i++)
+    g_array_free (store->entries[i].rects, TRUE);
+  g_mutex_clear (&store->lock);
+}
+
+/* Record the regions detected in the frame with timestamp @pts, replacing the oldest
+ * detection */
+void roi_store_push (RoiStore *store, GstClockTime pts, const GstVideoRectangle *rects, guint n_rects)
+{
+  RoiEntry *entry;
+
+  g_mutex_lock (&store->lock);
+  entry = &store->entries[store->next];
+  store->next = (store->next + 1) % ROI_STORE_DEPTH;
+  entry->pts = pts;
+  g_array_set_size (entry->rects, 0);
+  g_array_append_vals (entry->rects, rects, n_rects);
+  g_mutex_unlock (&store->lock);
+}
+
+/* Fill @rects with the regions to redact in the frame with timestamp @pts: the union of
+ * every detection made less than the hold-over time before or after it, each box widened
+ * by the safety margin to cover what moved in between. Returns the number of regions. */
+guint roi_store_lookup (RoiStore *store, GstClockTime pts, GArray *rects)
+{
+  guint i, j;
+
+  g_array_set_size (rects, 0);
+  if (!GST_CLOCK_TIME_IS_VALID (pts))
+    return 0;
+
+  g_mutex_lock (&store->lock);
+  for (i = 0; i < ROI_STORE_DEPTH; i++) {
+    RoiEntry *entry = &store->entries[i];
+    GstClockTime age;
+
+    if (!GST_CLOCK_TIME_IS_VALID (entry->pts))
+      continue;
+    age = pts > entry->pts ? pts - entry->pts : entry->pts - pts;
+    if (age > store->hold)
+      continue;
+
+    for (j = 0; j < entry->rects->len; j++) {
+      GstVideoRectangle rect = g_array_index (entry->rects, GstVideoRectangle, j);
+      gint dx = (gint) (rect.w * store->margin);
+      gint dy = (gint) (rect.h * store->margin);
+
+      rect.x -= dx;
+      rect.y -= dy;
+      rect.w += 2 * dx;
+      rect.h += 2 * dy;
+      g_array_append_val (rects, rect);
+    }
+  }
+  g_mutex_unlock (&store->lock);
+
+  return rects->len;
+}
+
+/* Value a masked pixel gets on each component: black */
+static const guint8 fill_yuv[] = { 16, 128, 128, 255 };
+static const guint8 fill_rgb[] = { 0, 0, 0, 255 };
+
+/* Clip @rect, in luma pixels, to the plane of component @comp of @frame. The start is
+ * rounded down and the end up so subsampled chroma covers the region. Returns FALSE if
+ * nothing of @rect is inside the frame. */
+static gboolean roi_comp_region (GstVideoFrame *frame, guint comp,
+    const GstVideoRectangle *rect, gint *x0, gint *y0, gint *x1, gint *y1)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  /* Regions may come from upstream metas, whose ends can overflow a gint */
+  gint right = (gint) CLAMP ((gint64) rect->x + rect->w, 0, GST_VIDEO_FRAME_WIDTH (frame));
+  gint bottom = (gint) CLAMP ((gint64) rect->y + rect->h, 0, GST_VIDEO_FRAME_HEIGHT (frame));
+
+  *x0 = MAX (0, rect->x) >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, comp);
+  *y0 = MAX (0, rect->y) >> GST_VIDEO_FORMAT_INFO_H_SUB (finfo, comp);
+  *x1 = MIN (GST_VIDEO_FRAME_COMP_WIDTH (frame, comp),
+      GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, comp, right));
+  *y1 = MIN (GST_VIDEO_FRAME_COMP_HEIGHT (frame, comp),
+      GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, comp, bottom));
+
+  return *x1 > *x0 && *y1 > *y0;
+}
+
+/* Redact the regions of an 8 bit per component frame in place, plane by plane, with the
+ * components interleaved in a plane handled together. Chroma is processed at its own,
+ * subsampled resolution. @strength is the pixelation block size or the blur radius, in
+ * luma pixels, and is unused by REDACT_FILL. The blur radius of a region is raised to
+ * @relative times its smaller side, so that faces close to the camera get a blur as
+ * strong as distant ones. */
+void roi_redact_frame (GstVideoFrame *frame, const GstVideoRectangle *rects, guint n_rects,
+    RedactMode mode, guint strength, gdouble relative)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  const guint8 *fill = GST_VIDEO_FORMAT_INFO_IS_YUV (finfo) ? fill_yuv : fill_rgb;
+  gboolean sized[GST_VIDEO_MAX_PLANES] = { FALSE, };
+  gboolean done[GST_VIDEO_MAX_PLANES] = { FALSE, };
+  guint n_comps = GST_VIDEO_FRAME_N_COMPONENTS (frame);
+  guint comp, other, r;
+  gsize scratch_size = 0;
+  guint8 *scratch = NULL;
+  gint x0, y0, x1, y1;
+
+  if (GST_VIDEO_FORMAT_INFO_DEPTH (finfo, 0) != 8 || n_rects == 0)
+    return;
+
+  /* The scratch buffer must hold the largest clipped region of any plane, with its
+   * interleaved components */
+  for (comp = 0; comp < n_comps && mode != REDACT_FILL; comp++) {
+    guint plane = GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp);
+    gint channels = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, comp);
+
+    if (sized[plane])
+      continue;
+    sized[plane] = TRUE;
+    for (r = 0; r < n_rects; r++)
+      if (roi_comp_region (frame, comp, &rects[r], &x0, &y0, &x1, &y1))
+        scratch_size = MAX (scratch_size, kernel_redact_scratch_size (x1 - x0, y1 - y0,
+                channels));
+  }
+  if (scratch_size > 0)
+    scratch = g_malloc (scratch_size);
+
+  for (comp = 0; comp < n_comps; comp++) {
+    guint plane = GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp);
+    guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, plane);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, plane);
+    gint channels = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, comp);
+    gint block_w = MAX (1, GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, comp, strength));
+    gint block_h = MAX (1, GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, comp, strength));
+    guint8 pixel[8] = { 0, };
+
+    if (done[plane] || channels > (gint) sizeof (pixel))
+      continue;
+    done[plane] = TRUE;
+    for (other = comp; other < n_comps; other++)
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, other) == plane)
+        pixel[GST_VIDEO_FORMAT_INFO_POFFSET (finfo, other)] = fill[MIN (other, 3)];
+
+    for (r = 0; r < n_rects; r++) {
+      guint8 *region;
+      gint radius = block_w;
+
+      if (!roi_comp_region (frame, comp, &rects[r], &x0, &y0, &x1, &y1))
+        continue;
+      region = data + y0 * stride + x0 * channels;
+      if (mode == REDACT_BLUR || mode == REDACT_INTEGRAL_BLUR)
+        radius = MAX (radius, (gint) (relative * MIN (x1 - x0, y1 - y0)));
+
+      switch (mode) {
+        case REDACT_PIXELATE:
+          kernel_pixelate (region, stride, channels, x1 - x0, y1 - y0, block_w, block_h,
+              scratch);
+          break;
+        case REDACT_BLUR:
+          kernel_box_blur (region, stride, channels, x1 - x0, y1 - y0, radius, scratch);
+          break;
+        case REDACT_INTEGRAL_BLUR:
+          kernel_integral_blur (region, stride, channels, x1 - x0, y1 - y0, radius, scratch);
+          break;
+        case REDACT_FILL:
+          kernel_fill (region, stride, channels, x1 - x0, y1 - y0, pixel);
+          break;
+      }
+    }
+  }
+
+  g_free (scratch);
+}
+
+/* Draw a green @thickness pixels wide border around each region, like facedetect's
+ * display mode does */
+void roi_outline_frame (GstVideoFrame *frame, const GstVideoRectangle *rects, guint n_rects,
+    guint thickness)
+{
+  static const guint8 green_rgb[] = { 0, 255, 0, 255 };
+  static const guint8 green_yuv[] = { 149, 43, 21, 255 };
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  const guint8 *color = GST_VIDEO_FORMAT_INFO_IS_YUV (finfo) ? green_yuv : green_rgb;
+  guint comp, r;
+  gint x, y;
+
+  if (GST_VIDEO_FORMAT_INFO_DEPTH (finfo, 0) != 8)
+    return;
+
+  for (comp = 0; comp < MIN (GST_VIDEO_FRAME_N_COMPONENTS (frame), 4); comp++) {
+    guint8 *data = GST_VIDEO_FRAME_COMP_DATA (frame, comp);
+    gint stride = GST_VIDEO_FRAME_COMP_STRIDE (frame, comp);
+    gint pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, comp);
+    gint width = GST_VIDEO_FRAME_COMP_WIDTH (frame, comp);
+    gint height = GST_VIDEO_FRAME_COMP_HEIGHT (frame, comp);
+    gint t = MAX (1, GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, comp, thickness));
+
+    for (r = 0; r < n_rects; r++) {
+      gint x0 = MAX (0, rects[r].x) >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, comp);
+      gint y0 = MAX (0, rects[r].y) >> GST_VIDEO_FORMAT_INFO_H_SUB (finfo, comp);
+      gint x1 = MIN (width, GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, comp,
+          MAX (0, rects[r].x + rects[r].w)));
+      gint y1 = MIN (height, GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, comp,
+          MAX (0, rects[r].y + rects[r].h)));
+
+      for (y = y0; y < y1; y++) {
+        gboolean edge_row = y < y0 + t || y >= y1 - t;
+
+        for (x = x0; x < x1; x++) {
+          if (edge_row || x < x0 + t || x >= x1 - t)
+            data[y * stride + x * pstride] = color[comp];
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef __SMARTPOLE_ROI_H__
+#define __SMARTPOLE_ROI_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+#define ROI_STORE_DEPTH 16
+
+/* How a region is made unrecognizable */
+typedef enum {
+  REDACT_PIXELATE,          /* Average of square blocks */
+  REDACT_BLUR,              /* Separable box blur, radius up to KERNEL_MAX_BLUR_RADIUS */
+  REDACT_INTEGRAL_BLUR,     /* Box blur from a summed-area table, any radius at one cost */
+  REDACT_FILL               /* Solid black */
+} RedactMode;
+
+/* The regions found in one detected frame */
+typedef struct _RoiEntry {
+  GstClockTime pts;         /* Timestamp of the detected frame, GST_CLOCK_TIME_NONE if unused */
+  GArray *rects;            /* GstVideoRectangle, in frame coordinates */
+} RoiEntry;
+
+/* The most recent detections of a camera, written by the detection thread and read by
+ * the thread that redacts the displayed frames */
+typedef struct _RoiStore {
+  GMutex lock;
+  RoiEntry entries[ROI_STORE_DEPTH];
+  guint next;               /* Entry overwritten by the next push */
+  gdouble margin;           /* Fraction of the box size added on every side */
+  GstClockTime hold;        /* How long a detection stays valid around its timestamp */
+} RoiStore;
+
+void roi_store_init (RoiStore *store, gdouble margin, GstClockTime hold);
+void roi_store_clear (RoiStore *store);
+
+void roi_store_push (RoiStore *store, GstClockTime pts, const GstVideoRectangle *rects, guint n_rects);
+guint roi_store_lookup (RoiStore *store, GstClockTime pts, GArray *rects);
+
+void roi_redact_frame (GstVideoFrame *frame, const GstVideoRectangle *rects, guint n_rects,
+    RedactMode mode, guint strength, gdouble relative);
+void roi_outline_frame (GstVideoFrame *frame, const GstVideoRectangle *rects, guint n_rects,
+    guint thickness);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_ROI_H__ */
@@ -0,0 +1,73 @@
+#include "smartpole_stamp.h"
+
+#define STAMP_TIME_BITS 48
+#define STAMP_TIME_MASK ((G_GUINT64_CONSTANT (1) << STAMP_TIME_BITS) - 1)
+
+/* Tells a stamp from a frame that happens to have blocks in its corner */
+static guint16 stamp_check (guint64 time)
+{
+  return (guint16) (time ^ (time >> 16) ^ (time >> 32) ^ 0x5a5a);
+}
+
+/* The luma component of a frame large enough for a stamp, whatever its layout. The
+ * blocks are grey, so the first component of an RGB frame will do as well. */
+static gboolean stamp_luma (const GstVideoFrame *frame, guint8 **data, gint *stride,
+    gint *pstride)
+{
+  if (GST_VIDEO_FRAME_COMP_DEPTH (frame, 0) != 8 ||
+      GST_VIDEO_FRAME_COMP_WIDTH (frame, 0) < STAMP_COLUMNS * STAMP_BLOCK ||
+      GST_VIDEO_FRAME_COMP_HEIGHT (frame, 0) < STAMP_ROWS * STAMP_BLOCK)
+    return FALSE;
+  *data = GST_VIDEO_FRAME_COMP_DATA (frame, 0);
+  *stride = GST_VIDEO_FRAME_COMP_STRIDE (frame, 0);
+  *pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, 0);
+  return TRUE;
+}
+
+void stamp_write (GstVideoFrame *frame, gint64 time)
+{
+  guint64 bits = ((guint64) time & STAMP_TIME_MASK) << 16 | stamp_check (time & STAMP_TIME_MASK);
+  guint8 *data;
+  gint stride, pstride, bit, x, y;
+
+  if (!stamp_luma (frame, &data, &stride, &pstride))
+    return;
+  for (bit = 0; bit < STAMP_COLUMNS * STAMP_ROWS; bit++) {
+    guint8 value = (bits >> (63 - bit)) & 1 ? 235 : 16;
+    guint8 *block = data + (bit / STAMP_COLUMNS) * STAMP_BLOCK * stride +
+        (bit % STAMP_COLUMNS) * STAMP_BLOCK * pstride;
+
+    for (y = 0; y < STAMP_BLOCK; y++)
+      for (x = 0; x < STAMP_BLOCK; x++)
+        block[y * stride + x * pstride] = value;
+  }
+}
+
+/* Read the stamp of @frame into @time, the last wall clock time before @now that has
+ * its low 48 bits. Returns FALSE when the frame has no valid stamp. */
+gboolean stamp_read (const GstVideoFrame *frame, gint64 now, gint64 *time)
+{
+  guint64 bits = 0, stamped;
+  guint8 *data;
+  gint stride, pstride, bit, x, y;
+
+  if (!stamp_luma (frame, &data, &stride, &pstride))
+    return FALSE;
+  /* The middle of each block, away from the ringing of its edges */
+  for (bit = 0; bit < STAMP_COLUMNS * STAMP_ROWS; bit++) {
+    const guint8 *block = data + (bit / STAMP_COLUMNS) * STAMP_BLOCK * stride +
+        (bit % STAMP_COLUMNS) * STAMP_BLOCK * pstride;
+    guint sum = 0;
+
+    for (y = STAMP_BLOCK / 4; y < STAMP_BLOCK * 3 / 4; y++)
+      for (x = STAMP_BLOCK / 4; x < STAMP_BLOCK * 3 / 4; x++)
+        sum += block[y * stride + x * pstride];
+    bits = bits << 1 | (sum > 128 * (STAMP_BLOCK / 2) * (STAMP_BLOCK / 2));
+  }
+
+  stamped = bits >> 16;
+  if ((guint16) bits != stamp_check (stamped))
+    return FALSE;
+  *time = now - (gint64) (((guint64) now - stamped) & STAMP_TIME_MASK);
+  return TRUE;
+}
@@ -0,0 +1,21 @@
+#ifndef __SMARTPOLE_STAMP_H__
+#define __SMARTPOLE_STAMP_H__
+
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/* A wall clock time drawn into the top left corner of the luma plane as black and white
+ * blocks large enough to survive the encoder: 48 bits of microseconds and a 16 bit
+ * check, on 4 rows of 16 blocks of STAMP_BLOCK pixels. The test source stamps each
+ * frame when it is made, the sink reads the stamp back after redaction. */
+#define STAMP_BLOCK 16
+#define STAMP_COLUMNS 16
+#define STAMP_ROWS 4
+
+void stamp_write (GstVideoFrame *frame, gint64 time);
+gboolean stamp_read (const GstVideoFrame *frame, gint64 now, gint64 *time);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_STAMP_H__ */
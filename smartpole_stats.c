@@ -0,0 +1,292 @@
+#include <math.h>
+#include <string.h>
+
+#include "smartpole_stats.h"
+
+/* Frames a timer can see enter a stage before it gives up on the oldest one */
+#define STAGE_PENDING 64
+
+void latency_histogram_reset (LatencyHistogram *histogram)
+{
+  memset (histogram, 0, sizeof (*histogram));
+}
+
+void latency_histogram_add (LatencyHistogram *histogram, GstClockTime latency)
+{
+  gdouble us = (gdouble) latency / GST_USECOND;
+  gint bucket = us < 1.0 ? 0 : (gint) (log2 (us) * LATENCY_BUCKETS_PER_OCTAVE);
+
+  histogram->counts[CLAMP (bucket, 0, LATENCY_N_BUCKETS - 1)]++;
+  histogram->total++;
+  histogram->max = MAX (histogram->max, latency);
+}
+
+/* The latency below which @percent of the samples fall, the geometric middle of its
+ * bucket, or 0 without samples */
+GstClockTime latency_histogram_percentile (const LatencyHistogram *histogram, gdouble percent)
+{
+  guint64 rank, seen = 0;
+  gint i;
+
+  if (histogram->total == 0)
+    return 0;
+  rank = (guint64) ceil (histogram->total * percent / 100.0);
+  for (i = 0; i < LATENCY_N_BUCKETS - 1; i++) {
+    seen += histogram->counts[i];
+    if (seen >= rank)
+      break;
+  }
+
+  return MIN (histogram->max,
+      (GstClockTime) (exp2 ((i + 0.5) / LATENCY_BUCKETS_PER_OCTAVE) * GST_USECOND));
+}
+
+struct _StageTimer {
+  gchar *name;
+  GstElement *element;
+  GstPad *sink_pad;
+  GstPad *src_pad;          /* NULL for a capture timer */
+  gulong sink_probe;
+  gulong src_probe;
+
+  GMutex lock;
+  GstClockTime pending_pts[STAGE_PENDING]; /* Frames in the stage, GST_CLOCK_TIME_NONE if free */
+  GstClockTime pending_time[STAGE_PENDING]; /* Monotonic time they entered, in ns */
+  guint next;               /* Slot the next frame entering takes */
+  GstSegment segment;       /* Segment on the pad of a capture timer */
+  LatencyHistogram histogram;
+  guint64 frames;
+  guint64 dropped;
+
+  /* Totals since the start for the metrics endpoint, atomic so it reads them lock free */
+  gsize total_frames;
+  gsize total_dropped;
+  gsize total_ns;
+};
+
+/* Account one frame out of the stage, with the lock held */
+static void stage_timer_add (StageTimer *timer, GstClockTime latency)
+{
+  latency_histogram_add (&timer->histogram, latency);
+  timer->frames++;
+  g_atomic_pointer_add (&timer->total_frames, 1);
+  g_atomic_pointer_add (&timer->total_ns, latency);
+}
+
+static GstPadProbeReturn stage_sink_probe_cb (GstPad *pad, GstPadProbeInfo *info,
+    StageTimer *timer)
+{
+  GstClockTime pts = GST_BUFFER_PTS (GST_PAD_PROBE_INFO_BUFFER (info));
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts))
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&timer->lock);
+  if (GST_CLOCK_TIME_IS_VALID (timer->pending_pts[timer->next])) {
+    timer->dropped++;
+    g_atomic_pointer_add (&timer->total_dropped, 1);
+  }
+  timer->pending_pts[timer->next] = pts;
+  timer->pending_time[timer->next] = g_get_monotonic_time () * GST_USECOND;
+  timer->next = (timer->next + 1) % STAGE_PENDING;
+  g_mutex_unlock (&timer->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn stage_src_probe_cb (GstPad *pad, GstPadProbeInfo *info,
+    StageTimer *timer)
+{
+  GstClockTime pts = GST_BUFFER_PTS (GST_PAD_PROBE_INFO_BUFFER (info));
+  GstClockTime now = g_get_monotonic_time () * GST_USECOND;
+  guint i;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts))
+    return GST_PAD_PROBE_OK;
+
+  /* Newest first, an element passes its frames on in about the order they came in */
+  g_mutex_lock (&timer->lock);
+  for (i = 1; i <= STAGE_PENDING; i++) {
+    guint slot = (timer->next + STAGE_PENDING - i) % STAGE_PENDING;
+
+    if (timer->pending_pts[slot] == pts) {
+      stage_timer_add (timer, now - timer->pending_time[slot]);
+      timer->pending_pts[slot] = GST_CLOCK_TIME_NONE;
+      break;
+    }
+  }
+  g_mutex_unlock (&timer->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* The running time of a live buffer is its capture time on the pipeline clock */
+static GstPadProbeReturn stage_capture_probe_cb (GstPad *pad, GstPadProbeInfo *info,
+    StageTimer *timer)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT) {
+      g_mutex_lock (&timer->lock);
+      gst_event_copy_segment (event, &timer->segment);
+      g_mutex_unlock (&timer->lock);
+    }
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+    GstClock *clock = gst_element_get_clock (timer->element);
+    GstClockTime running_time;
+
+    if (!clock)
+      return GST_PAD_PROBE_OK;
+    g_mutex_lock (&timer->lock);
+    running_time = gst_segment_to_running_time (&timer->segment, GST_FORMAT_TIME,
+        GST_BUFFER_PTS (buffer));
+    if (GST_CLOCK_TIME_IS_VALID (running_time)) {
+      GstClockTimeDiff latency = GST_CLOCK_DIFF (gst_element_get_base_time (timer->element) +
+          running_time, gst_clock_get_time (clock));
+
+      stage_timer_add (timer, MAX (0, latency));
+    }
+    g_mutex_unlock (&timer->lock);
+    gst_object_unref (clock);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static StageTimer *stage_timer_alloc (const gchar *name, GstElement *element)
+{
+  StageTimer *timer = g_new0 (StageTimer, 1);
+  guint i;
+
+  timer->name = g_strdup (name);
+  timer->element = element ? gst_object_ref (element) : NULL;
+  g_mutex_init (&timer->lock);
+  for (i = 0; i < STAGE_PENDING; i++)
+    timer->pending_pts[i] = GST_CLOCK_TIME_NONE;
+  gst_segment_init (&timer->segment, GST_FORMAT_TIME);
+
+  return timer;
+}
+
+/* Time the frames from the "sink" to the "src" pad of @element */
+StageTimer *stage_timer_new (const gchar *name, GstElement *element)
+{
+  StageTimer *timer = stage_timer_alloc (name, element);
+
+  timer->sink_pad = gst_element_get_static_pad (element, "sink");
+  timer->src_pad = gst_element_get_static_pad (element, "src");
+  g_assert (timer->sink_pad && timer->src_pad);
+  timer->sink_probe = gst_pad_add_probe (timer->sink_pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) stage_sink_probe_cb, timer, NULL);
+  timer->src_probe = gst_pad_add_probe (timer->src_pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) stage_src_probe_cb, timer, NULL);
+
+  return timer;
+}
+
+/* Time the frames from their capture to the @pad_name pad of @element */
+StageTimer *stage_timer_new_capture (const gchar *name, GstElement *element,
+    const gchar *pad_name)
+{
+  StageTimer *timer = stage_timer_alloc (name, element);
+
+  timer->sink_pad = gst_element_get_static_pad (element, pad_name);
+  g_assert (timer->sink_pad);
+  timer->sink_probe = gst_pad_add_probe (timer->sink_pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) stage_capture_probe_cb, timer, NULL);
+
+  return timer;
+}
+
+/* Move a capture timer to the @pad_name pad of @element, which replaced its element.
+ * The totals carry on, the frames of the old element still in flight are forgotten. */
+void stage_timer_retarget (StageTimer *timer, GstElement *element, const gchar *pad_name)
+{
+  GstPad *pad = gst_element_get_static_pad (element, pad_name);
+
+  g_assert (pad && !timer->src_pad);
+  gst_pad_remove_probe (timer->sink_pad, timer->sink_probe);
+  gst_object_unref (timer->sink_pad);
+  gst_object_replace ((GstObject **) &timer->element, GST_OBJECT (element));
+
+  g_mutex_lock (&timer->lock);
+  gst_segment_init (&timer->segment, GST_FORMAT_TIME);
+  g_mutex_unlock (&timer->lock);
+  timer->sink_pad = pad;
+  timer->sink_probe = gst_pad_add_probe (timer->sink_pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) stage_capture_probe_cb, timer, NULL);
+}
+
+/* A timer fed by stage_timer_record(), for work done outside of any element */
+StageTimer *stage_timer_new_manual (const gchar *name)
+{
+  return stage_timer_alloc (name, NULL);
+}
+
+void stage_timer_free (StageTimer *timer)
+{
+  if (timer->sink_pad) {
+    gst_pad_remove_probe (timer->sink_pad, timer->sink_probe);
+    gst_object_unref (timer->sink_pad);
+  }
+  if (timer->src_pad) {
+    gst_pad_remove_probe (timer->src_pad, timer->src_probe);
+    gst_object_unref (timer->src_pad);
+  }
+  if (timer->element)
+    gst_object_unref (timer->element);
+  g_mutex_clear (&timer->lock);
+  g_free (timer->name);
+  g_free (timer);
+}
+
+void stage_timer_record (StageTimer *timer, GstClockTime latency)
+{
+  g_mutex_lock (&timer->lock);
+  stage_timer_add (timer, latency);
+  g_mutex_unlock (&timer->lock);
+}
+
+const gchar *stage_timer_get_name (StageTimer *timer)
+{
+  return timer->name;
+}
+
+/* Read the totals since the start without taking the lock of the streaming threads */
+void stage_timer_get_totals (StageTimer *timer, guint64 *frames, guint64 *dropped,
+    GstClockTime *time)
+{
+  *frames = (gsize) g_atomic_pointer_get (&timer->total_frames);
+  *dropped = (gsize) g_atomic_pointer_get (&timer->total_dropped);
+  *time = (gsize) g_atomic_pointer_get (&timer->total_ns);
+}
+
+/* Fill @stats with what the stage did since the previous snapshot and start over */
+void stage_timer_snapshot (StageTimer *timer, StageStats *stats)
+{
+  g_mutex_lock (&timer->lock);
+  stats->name = timer->name;
+  stats->frames = timer->frames;
+  stats->dropped = timer->dropped;
+  stats->p50 = latency_histogram_percentile (&timer->histogram, 50.0);
+  stats->p95 = latency_histogram_percentile (&timer->histogram, 95.0);
+  stats->p99 = latency_histogram_percentile (&timer->histogram, 99.0);
+  stats->max = timer->histogram.max;
+  latency_histogram_reset (&timer->histogram);
+  timer->frames = 0;
+  timer->dropped = 0;
+  g_mutex_unlock (&timer->lock);
+}
+
+void stage_stats_append_json (const StageStats *stats, GString *json)
+{
+  g_string_append_printf (json, "{\"stage\": \"%s\", \"frames\": %" G_GUINT64_FORMAT
+      ", \"dropped\": %" G_GUINT64_FORMAT ", \"p50_ms\": %.3f, \"p95_ms\": %.3f, "
+      "\"p99_ms\": %.3f, \"max_ms\": %.3f}", stats->name, stats->frames, stats->dropped,
+      (gdouble) stats->p50 / GST_MSECOND, (gdouble) stats->p95 / GST_MSECOND,
+      (gdouble) stats->p99 / GST_MSECOND, (gdouble) stats->max / GST_MSECOND);
+}
@@ -0,0 +1,54 @@
+#ifndef __SMARTPOLE_STATS_H__
+#define __SMARTPOLE_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Latencies from 1 us to 2^24 us (16.8 s) in quarter octaves, longer ones in the last
+ * bucket. Percentiles are within 19% of the exact value. */
+#define LATENCY_BUCKETS_PER_OCTAVE 4
+#define LATENCY_N_BUCKETS (24 * LATENCY_BUCKETS_PER_OCTAVE + 1)
+
+typedef struct _LatencyHistogram {
+  guint64 counts[LATENCY_N_BUCKETS];
+  guint64 total;
+  GstClockTime max;
+} LatencyHistogram;
+
+void latency_histogram_reset (LatencyHistogram *histogram);
+void latency_histogram_add (LatencyHistogram *histogram, GstClockTime latency);
+GstClockTime latency_histogram_percentile (const LatencyHistogram *histogram, gdouble percent);
+
+/* What a stage did since the previous snapshot */
+typedef struct _StageStats {
+  const gchar *name;
+  guint64 frames;           /* Frames out of the stage */
+  guint64 dropped;          /* Frames into the stage that never came out */
+  GstClockTime p50, p95, p99, max;
+} StageStats;
+
+/* Times the frames through one element from pad probes on its sink and src pads, matching
+ * them by timestamp. A capture timer instead times the frames from their capture, from
+ * the running time of each buffer on a single pad, and a manual one is given the time
+ * of each frame. Besides the windows of stage_timer_snapshot(), a timer keeps totals
+ * since the start, which are only exact where a gsize holds 64 bits. */
+typedef struct _StageTimer StageTimer;
+
+StageTimer *stage_timer_new (const gchar *name, GstElement *element);
+StageTimer *stage_timer_new_capture (const gchar *name, GstElement *element,
+    const gchar *pad_name);
+StageTimer *stage_timer_new_manual (const gchar *name);
+void stage_timer_retarget (StageTimer *timer, GstElement *element, const gchar *pad_name);
+void stage_timer_free (StageTimer *timer);
+void stage_timer_record (StageTimer *timer, GstClockTime latency);
+const gchar *stage_timer_get_name (StageTimer *timer);
+void stage_timer_get_totals (StageTimer *timer, guint64 *frames, guint64 *dropped,
+    GstClockTime *time);
+void stage_timer_snapshot (StageTimer *timer, StageStats *stats);
+
+void stage_stats_append_json (const StageStats *stats, GString *json);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_STATS_H__ */
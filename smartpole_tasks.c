@@ -0,0 +1,208 @@
+#include "smartpole_bands.h"
+#include "smartpole_kernels.h"
+#include "smartpole_tasks.h"
+
+/* Append the tasks searching @region of the frame. Every band of @bands only searches its
+ * own range of face sizes, on the rows a face centered in the band can cover, so the
+ * small scales are not evaluated at the bottom of the frame nor the large ones at the
+ * top. Without @bands a single task searches the whole region with @params. */
+void detect_tasks_add (GArray *tasks, GArray *bands, gint frame_height,
+    const GstVideoRectangle *region, const DetectorParams *params)
+{
+  guint b, n_bands = bands ? bands->len : 1;
+
+  for (b = 0; b < n_bands; b++) {
+    DetectTask task = { *region, *params, 0, frame_height, NULL };
+
+    if (bands) {
+      SizeBand *band = &g_array_index (bands, SizeBand, b);
+      gint top = region->y, bottom = region->y + region->h;
+      gint min_height = MAX (1, params->min_height);
+      gint reach;
+
+      task.first = band->top * frame_height;
+      if (b + 1 < bands->len)
+        task.last = g_array_index (bands, SizeBand, b + 1).top * frame_height;
+      task.params.min_height = band->min_size;
+      task.params.min_width = MAX (1, band->min_size * params->min_width / min_height);
+      task.params.max_height = band->max_size;
+      task.params.max_width = band->max_size * params->min_width / min_height;
+
+      /* A face centered in the band reaches half its height past the band edges */
+      reach = band->max_size ? (band->max_size + 1) / 2 : frame_height;
+      top = MAX (top, task.first - reach);
+      bottom = MIN (bottom, task.last + reach);
+      if (bottom - top < band->min_size)
+        continue;
+      task.area.y = top;
+      task.area.h = bottom - top;
+    }
+
+    g_array_append_val (tasks, task);
+  }
+}
+
+/* Number of tiles of @tile pixels overlapping by @overlap needed to cover @length */
+static gint tile_count (gint length, gint tile, gint overlap)
+{
+  if (length <= tile)
+    return 1;
+  return (length - overlap + tile - overlap - 1) / (tile - overlap);
+}
+
+/* Split every task into ranges of face sizes doubling from the smallest one, and the
+ * small ranges further into tiles of about @tile_size pixels. Neighbouring tiles overlap
+ * by the largest face of their range, so every face lies whole in at least one tile, and
+ * neighbouring ranges by a scale step. The duplicates this gives are for
+ * detect_merge_overlaps(). */
+void detect_tasks_split (GArray *tasks, gint tile_size)
+{
+  guint n = tasks->len, t;
+
+  for (t = 0; t < n; t++) {
+    DetectTask task = g_array_index (tasks, DetectTask, t);
+    gint largest = task.params.max_height ? task.params.max_height : task.area.h;
+    /* A minimum height of 0 searches from 1 pixel up, and keeps the aspect ratio of 1 */
+    gint min_height = MAX (1, task.params.min_height);
+    gint lo = min_height, hi;
+
+    for (; lo <= largest; lo = hi) {
+      DetectTask range = task;
+      gint reach, tile, nx, ny, ix, iy;
+
+      hi = 2 * lo;
+      if (hi * 3 / 2 >= largest)
+        hi = largest;
+      range.params.min_height = lo;
+      range.params.min_width = MAX (1, lo * task.params.min_width / min_height);
+      if (hi < largest) {
+        range.params.max_height = hi * 5 / 4;
+        range.params.max_width = range.params.max_height * task.params.min_width / min_height;
+      }
+
+      reach = range.params.max_height ? range.params.max_height : largest;
+      tile = MAX (tile_size, 4 * reach);
+      nx = tile_count (task.area.w, tile, reach);
+      ny = tile_count (task.area.h, tile, reach);
+      for (iy = 0; iy < ny; iy++) {
+        for (ix = 0; ix < nx; ix++) {
+          DetectTask part = range;
+
+          if (nx > 1) {
+            part.area.x = task.area.x + ix * (task.area.w - tile) / (nx - 1);
+            part.area.w = tile;
+          }
+          if (ny > 1) {
+            part.area.y = task.area.y + iy * (task.area.h - tile) / (ny - 1);
+            part.area.h = tile;
+          }
+          g_array_append_val (tasks, part);
+        }
+      }
+
+      if (hi == largest)
+        break;
+    }
+  }
+
+  g_array_remove_range (tasks, 0, n);
+}
+
+/* Run @task on @plane and replace the content of @found with the faces it keeps, in
+ * frame coordinates */
+void detect_task_run (const DetectTask *task, Detector *detector, const LumaPlane *plane,
+    gdouble padding, GArray *found)
+{
+  guint i, kept = 0;
+
+  detector_detect_plane (detector, plane, &task->area, padding, &task->params, found);
+  for (i = 0; i < found->len; i++) {
+    GstVideoRectangle face = g_array_index (found, GstVideoRectangle, i);
+    gint center = face.y + face.h / 2;
+
+    if (center >= task->first && center < task->last)
+      g_array_index (found, GstVideoRectangle, kept++) = face;
+  }
+  g_array_set_size (found, kept);
+}
+
+/* Run every task of @tasks one after the other and append the faces to @rects */
+void detect_tasks_run (GArray *tasks, Detector *detector, const LumaPlane *plane,
+    gdouble padding, GArray *scratch, GArray *rects)
+{
+  guint t;
+
+  for (t = 0; t < tasks->len; t++) {
+    detect_task_run (&g_array_index (tasks, DetectTask, t), detector, plane, padding,
+        scratch);
+    g_array_append_vals (rects, scratch->data, scratch->len);
+  }
+}
+
+static gint compare_area (gconstpointer a, gconstpointer b)
+{
+  const GstVideoRectangle *ra = a, *rb = b;
+  gint64 area_a = (gint64) ra->w * ra->h, area_b = (gint64) rb->w * rb->h;
+
+  return area_a < area_b ? 1 : area_a > area_b ? -1 : 0;
+}
+
+/* Merge the boxes found twice: a box whose intersection with a larger box covers more
+ * than @overlap of its own area is dropped and the larger box grown to their union, so
+ * that a face found by two tiles or two size ranges is redacted once and whole. */
+void detect_merge_overlaps (GArray *rects, gdouble overlap)
+{
+  guint n = rects->len, i, j, kept = 0;
+  gfloat *x0, *y0, *x1, *y1, *area, *inter;
+  guint8 *dropped;
+
+  if (n < 2)
+    return;
+
+  g_array_sort (rects, compare_area);
+  x0 = g_new (gfloat, 6 * n);
+  y0 = x0 + n;
+  x1 = y0 + n;
+  y1 = x1 + n;
+  area = y1 + n;
+  inter = area + n;
+  dropped = g_new0 (guint8, n);
+  for (i = 0; i < n; i++) {
+    GstVideoRectangle *r = &g_array_index (rects, GstVideoRectangle, i);
+
+    x0[i] = r->x;
+    y0[i] = r->y;
+    x1[i] = r->x + r->w;
+    y1[i] = r->y + r->h;
+    area[i] = (gfloat) r->w * r->h;
+  }
+
+  for (i = 0; i < n; i++) {
+    GstVideoRectangle *r = &g_array_index (rects, GstVideoRectangle, i);
+    gint rx1, ry1;
+
+    if (dropped[i])
+      continue;
+
+    kernel_box_intersections (x0 + i + 1, y0 + i + 1, x1 + i + 1, y1 + i + 1, n - i - 1,
+        x0[i], y0[i], x1[i], y1[i], inter);
+    rx1 = r->x + r->w;
+    ry1 = r->y + r->h;
+    for (j = i + 1; j < n; j++) {
+      if (dropped[j] || inter[j - i - 1] <= overlap * area[j])
+        continue;
+      dropped[j] = TRUE;
+      r->x = MIN (r->x, (gint) x0[j]);
+      r->y = MIN (r->y, (gint) y0[j]);
+      rx1 = MAX (rx1, (gint) x1[j]);
+      ry1 = MAX (ry1, (gint) y1[j]);
+    }
+    r->w = rx1 - r->x;
+    r->h = ry1 - r->y;
+    g_array_index (rects, GstVideoRectangle, kept++) = *r;
+  }
+  g_array_set_size (rects, kept);
+
+  g_free (x0);
+  g_free (dropped);
+}
@@ -0,0 +1,32 @@
+#ifndef __SMARTPOLE_TASKS_H__
+#define __SMARTPOLE_TASKS_H__
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+#include "smartpole_detector.h"
+
+G_BEGIN_DECLS
+
+/* One cascade run over part of a frame and a range of face sizes */
+typedef struct _DetectTask {
+  GstVideoRectangle area;   /* Pixels searched */
+  DetectorParams params;    /* Face sizes searched for, in frame pixels */
+  gint first, last;         /* Rows the center of a kept face lies in */
+  GArray *found;            /* GstVideoRectangle results when run on a WorkPool */
+} DetectTask;
+
+void detect_tasks_add (GArray *tasks, GArray *bands, gint frame_height,
+    const GstVideoRectangle *region, const DetectorParams *params);
+void detect_tasks_split (GArray *tasks, gint tile_size);
+
+void detect_task_run (const DetectTask *task, Detector *detector, const LumaPlane *plane,
+    gdouble padding, GArray *found);
+void detect_tasks_run (GArray *tasks, Detector *detector, const LumaPlane *plane,
+    gdouble padding, GArray *scratch, GArray *rects);
+
+void detect_merge_overlaps (GArray *rects, gdouble overlap);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_TASKS_H__ */
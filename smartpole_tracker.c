@@ -0,0 +1,162 @@
+#include "smartpole_kernels.h"
+#include "smartpole_tracker.h"
+
+/* Block matching runs on the luma plane downscaled by this factor */
+#define TRACKER_SCALE 4
+/* Largest displacement searched around the predicted position, in downscaled pixels */
+#define TRACKER_SEARCH_RADIUS 4
+/* Smallest tmpl matched, in downscaled pixels, smaller boxes are only predicted */
+#define TRACKER_MIN_TEMPLATE 4
+
+typedef struct _TrackedObject {
+  GstVideoRectangle box;    /* Last position, in frame pixels */
+  gint vx, vy;              /* Last displacement, in frame pixels per frame */
+} TrackedObject;
+
+struct _Tracker {
+  guint8 *prev;             /* Downscaled luma of the previous frame */
+  guint8 *cur;              /* Downscaled luma of the frame being tracked */
+  gint width, height;       /* Size of the downscaled planes */
+  gint frame_width, frame_height;
+  GArray *objects;          /* TrackedObject */
+  gboolean valid;           /* A detection has been recorded for this frame size */
+};
+
+Tracker *tracker_new (void)
+{
+  Tracker *tracker = g_new0 (Tracker, 1);
+
+  tracker->objects = g_array_new (FALSE, FALSE, sizeof (TrackedObject));
+  return tracker;
+}
+
+void tracker_free (Tracker *tracker)
+{
+  g_free (tracker->prev);
+  g_free (tracker->cur);
+  g_array_free (tracker->objects, TRUE);
+  g_free (tracker);
+}
+
+/* Forget the tracked objects, the next frame needs a detection pass */
+void tracker_clear (Tracker *tracker)
+{
+  tracker->valid = FALSE;
+  g_array_set_size (tracker->objects, 0);
+}
+
+/* Start tracking the boxes of @rects, detected in the @width x @height luma plane @gray */
+void tracker_reset (Tracker *tracker, const guint8 *gray, gint width, gint height, gint stride,
+    GArray *rects)
+{
+  guint i;
+
+  if (width != tracker->frame_width || height != tracker->frame_height) {
+    tracker->frame_width = width;
+    tracker->frame_height = height;
+    tracker->width = width / TRACKER_SCALE;
+    tracker->height = height / TRACKER_SCALE;
+    g_free (tracker->prev);
+    g_free (tracker->cur);
+    tracker->prev = g_malloc ((gsize) tracker->width * tracker->height);
+    tracker->cur = g_malloc ((gsize) tracker->width * tracker->height);
+  }
+  kernel_downscale_luma (gray, stride, width, height, TRACKER_SCALE, tracker->prev,
+      tracker->width);
+
+  g_array_set_size (tracker->objects, 0);
+  for (i = 0; i < rects->len; i++) {
+    TrackedObject object = { g_array_index (rects, GstVideoRectangle, i), 0, 0 };
+
+    g_array_append_val (tracker->objects, object);
+  }
+  tracker->valid = TRUE;
+}
+
+/* Find where the downscaled tmpl of @object moved to in the current plane, searching
+ * around the constant-velocity prediction */
+static void tracker_match (Tracker *tracker, TrackedObject *object)
+{
+  gint tx = MAX (0, object->box.x / TRACKER_SCALE);
+  gint ty = MAX (0, object->box.y / TRACKER_SCALE);
+  gint tw = MIN (tracker->width, (object->box.x + object->box.w) / TRACKER_SCALE) - tx;
+  gint th = MIN (tracker->height, (object->box.y + object->box.h) / TRACKER_SCALE) - ty;
+  gint px = object->vx / TRACKER_SCALE, py = object->vy / TRACKER_SCALE;
+  gint best_dx = px, best_dy = py, dx, dy;
+  guint best_sad = G_MAXUINT;
+
+  if (tw >= TRACKER_MIN_TEMPLATE && th >= TRACKER_MIN_TEMPLATE) {
+    const guint8 *tmpl = tracker->prev + ty * tracker->width + tx;
+
+    for (dy = py - TRACKER_SEARCH_RADIUS; dy <= py + TRACKER_SEARCH_RADIUS; dy++) {
+      if (ty + dy < 0 || ty + dy + th > tracker->height)
+        continue;
+      for (dx = px - TRACKER_SEARCH_RADIUS; dx <= px + TRACKER_SEARCH_RADIUS; dx++) {
+        guint sad;
+
+        if (tx + dx < 0 || tx + dx + tw > tracker->width)
+          continue;
+        sad = kernel_sad (tmpl, tracker->width,
+            tracker->cur + (ty + dy) * tracker->width + tx + dx, tracker->width, tw, th);
+        /* Prefer the smaller motion on ties, flat regions match everywhere */
+        if (sad < best_sad || (sad == best_sad &&
+                ABS (dx) + ABS (dy) < ABS (best_dx) + ABS (best_dy))) {
+          best_sad = sad;
+          best_dx = dx;
+          best_dy = dy;
+        }
+      }
+    }
+  }
+
+  object->vx = best_dx * TRACKER_SCALE;
+  object->vy = best_dy * TRACKER_SCALE;
+  object->box.x += object->vx;
+  object->box.y += object->vy;
+}
+
+/* Move the tracked boxes to the @width x @height luma plane @gray of the next frame and
+ * replace the content of @rects with them, each widened by its last displacement plus the
+ * matching precision so that fast motion is still covered. Returns FALSE if there is
+ * nothing to track from, the frame then needs a detection pass. */
+gboolean tracker_update (Tracker *tracker, const guint8 *gray, gint width, gint height,
+    gint stride, GArray *rects)
+{
+  guint8 *tmp;
+  guint i;
+
+  g_array_set_size (rects, 0);
+  if (!tracker->valid || width != tracker->frame_width || height != tracker->frame_height)
+    return FALSE;
+
+  kernel_downscale_luma (gray, stride, width, height, TRACKER_SCALE, tracker->cur,
+      tracker->width);
+
+  for (i = 0; i < tracker->objects->len; i++) {
+    TrackedObject *object = &g_array_index (tracker->objects, TrackedObject, i);
+    gint margin_x, margin_y, x0, y0, x1, y1;
+    GstVideoRectangle rect;
+
+    tracker_match (tracker, object);
+
+    margin_x = ABS (object->vx) + TRACKER_SCALE;
+    margin_y = ABS (object->vy) + TRACKER_SCALE;
+    x0 = MAX (0, object->box.x - margin_x);
+    y0 = MAX (0, object->box.y - margin_y);
+    x1 = MIN (width, object->box.x + object->box.w + margin_x);
+    y1 = MIN (height, object->box.y + object->box.h + margin_y);
+    if (x1 <= x0 || y1 <= y0)
+      continue;
+
+    rect.x = x0;
+    rect.y = y0;
+    rect.w = x1 - x0;
+    rect.h = y1 - y0;
+    g_array_append_val (rects, rect);
+  }
+
+  tmp = tracker->prev;
+  tracker->prev = tracker->cur;
+  tracker->cur = tmp;
+  return TRUE;
+}
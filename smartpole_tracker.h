@@ -0,0 +1,24 @@
+#ifndef __SMARTPOLE_TRACKER_H__
+#define __SMARTPOLE_TRACKER_H__
+
+#include <glib.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/* Carries detected boxes from one frame to the next by block matching on a downscaled
+ * copy of the luma plane, for the frames between two detection passes */
+typedef struct _Tracker Tracker;
+
+Tracker *tracker_new (void);
+void tracker_free (Tracker *tracker);
+
+void tracker_reset (Tracker *tracker, const guint8 *gray, gint width, gint height, gint stride,
+    GArray *rects);
+gboolean tracker_update (Tracker *tracker, const guint8 *gray, gint width, gint height,
+    gint stride, GArray *rects);
+void tracker_clear (Tracker *tracker);
+
+G_END_DECLS
+
+#endif /* __SMARTPOLE_TRACKER_H__ */